@@ -0,0 +1,767 @@
+#include "bytecode.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <unordered_map>
+#include "output.hpp"
+
+namespace bytecode {
+
+    static Op offset(Op first, Condition condition) {
+        return Op(uint8_t(first) + uint8_t(condition));
+    }
+
+    static bool isCompare(Op op) {
+        return Op::EQ <= op && op <= Op::GEI;
+    }
+
+    static bool isJump(Op op) {
+        return Op::JMP <= op && op <= Op::JGEI;
+    }
+
+    // The condition that holds exactly when the given one does not
+    static Condition negate(Condition condition) {
+        static const Condition negated[] = {Condition::NE, Condition::EQ, Condition::GE,
+                                            Condition::GT, Condition::LE, Condition::LT};
+        return negated[uint8_t(condition)];
+    }
+
+    // The condition of the same comparison with its operands swapped
+    static Condition mirror(Condition condition) {
+        static const Condition mirrored[] = {Condition::EQ, Condition::NE, Condition::GT,
+                                             Condition::GE, Condition::LT, Condition::LE};
+        return mirrored[uint8_t(condition)];
+    }
+
+    static Condition conditionOf(ast::RelOpType op) {
+        switch (op) {
+            case ast::RelOpType::EQ:
+                return Condition::EQ;
+            case ast::RelOpType::NE:
+                return Condition::NE;
+            case ast::RelOpType::LT:
+                return Condition::LT;
+            case ast::RelOpType::GT:
+                return Condition::GT;
+            case ast::RelOpType::LE:
+                return Condition::LE;
+            default:
+                return Condition::GE;
+        }
+    }
+
+    // The value of a literal, as the type of its node holds it
+    static bool constantOf(ast::Exp &exp, int &value) {
+        if (auto num = dynamic_cast<ast::Num *>(&exp)) {
+            value = num->value;
+        } else if (auto numB = dynamic_cast<ast::NumB *>(&exp)) {
+            value = numB->value;
+        } else if (auto boolean = dynamic_cast<ast::Bool *>(&exp)) {
+            value = boolean->value;
+        } else {
+            return false;
+        }
+        if (exp.type == ast::BuiltInType::BYTE) {
+            value &= 0xff;
+        }
+        return true;
+    }
+
+    /* Compiles function bodies into the code of a Program. Expressions are compiled with
+     * compile(exp, dst), which returns the register holding the value: dst if it is not -1,
+     * otherwise a fresh temporary or the register of a variable. Temporaries live above the
+     * variables and are released at the end of every statement */
+    class Compiler : public Visitor {
+    public:
+        explicit Compiler(ast::Funcs &program) {
+            for (const auto &func : program.funcs) {
+                functionIndex.emplace(func->id->value, this->program.functions.size());
+                returnTypes.push_back(func->return_type->type);
+                this->program.functions.push_back({func->id->value});
+            }
+            this->program.main = functionIndex.at("main");
+        }
+
+        Program finish() {
+            for (auto &inst : program.code) {
+                if (isJump(inst.op)) {
+                    inst.a = labels[inst.a];
+                }
+            }
+            return std::move(program);
+        }
+
+        void visit(ast::Num &node) override {
+            resultType = ast::BuiltInType::INT;
+            result = destination();
+            emit(Op::LOADI, result, node.value);
+        }
+
+        void visit(ast::NumB &node) override {
+            resultType = ast::BuiltInType::BYTE;
+            result = destination();
+            emit(Op::LOADI, result, node.value);
+        }
+
+        void visit(ast::String &) override {
+            // Strings only appear as the argument of print
+        }
+
+        void visit(ast::Bool &node) override {
+            resultType = ast::BuiltInType::BOOL;
+            result = destination();
+            emit(Op::LOADI, result, node.value ? 1 : 0);
+        }
+
+        void visit(ast::ID &node) override {
+            const Variable &variable = lookup(node.value);
+            resultType = variable.type;
+            result = variable.reg;
+            if (target >= 0 && target != result) {
+                emit(Op::MOVE, target, result);
+                result = target;
+            }
+        }
+
+        void visit(ast::BinOp &node) override {
+            static const Op registerOps[] = {Op::ADD, Op::SUB, Op::MUL, Op::DIV};
+            static const Op immediateOps[] = {Op::ADDI, Op::SUBI, Op::MULI, Op::DIVI};
+            // Both operands have the type of the operation once the narrower one is widened
+            ast::BuiltInType type = node.left->type;
+            int dst = target;
+            int saved = top;
+            ast::Exp *left = node.left.get();
+            ast::Exp *right = node.right.get();
+            int constant;
+            bool commutative = node.op == ast::BinOpType::ADD || node.op == ast::BinOpType::MUL;
+            if (commutative && constantOf(*left, constant) && !constantOf(*right, constant)) {
+                std::swap(left, right);
+            }
+            int lhs = compile(*left, -1);
+            if (constantOf(*right, constant)) {
+                top = saved;
+                result = destination(dst);
+                emit(immediateOps[node.op], result, lhs, constant);
+            } else {
+                int rhs = compile(*right, -1);
+                top = saved;
+                result = destination(dst);
+                emit(registerOps[node.op], result, lhs, rhs);
+            }
+            if (type == ast::BuiltInType::BYTE) {
+                emit(Op::TRUNC, result, result);
+            }
+            resultType = type;
+        }
+
+        void visit(ast::RelOp &node) override {
+            int dst = target;
+            int saved = top;
+            bool immediate;
+            Condition condition;
+            int lhs, rhs;
+            compare(node, condition, lhs, rhs, immediate);
+            top = saved;
+            result = destination(dst);
+            emit(offset(immediate ? Op::EQI : Op::EQ, condition), result, lhs, rhs);
+            resultType = ast::BuiltInType::BOOL;
+        }
+
+        void visit(ast::Not &node) override {
+            int dst = target;
+            int saved = top;
+            int operand = compile(*node.exp, -1);
+            top = saved;
+            result = destination(dst);
+            emit(Op::NOT, result, operand);
+            resultType = ast::BuiltInType::BOOL;
+        }
+
+        void visit(ast::And &node) override {
+            logical(node);
+        }
+
+        void visit(ast::Or &node) override {
+            logical(node);
+        }
+
+        void visit(ast::Type &) override {
+        }
+
+        void visit(ast::Cast &node) override {
+            int dst = target;
+            ast::BuiltInType to = node.target_type->type;
+            result = compile(*node.exp, dst);
+            if (to == ast::BuiltInType::BYTE && node.exp->type == ast::BuiltInType::INT) {
+                int converted = dst >= 0 || result >= locals ? result : allocate();
+                emit(Op::TRUNC, converted, result);
+                result = converted;
+            }
+            resultType = to;
+        }
+
+        void visit(ast::ExpList &) override {
+        }
+
+        void visit(ast::Call &node) override {
+            const std::string &name = node.func_id->value;
+            const auto &args = node.args->exps;
+            int dst = target;
+            resultType = ast::BuiltInType::VOID;
+            result = -1;
+            if (name == "print") {
+                // The only string expressions are literals
+                auto &literal = static_cast<ast::String &>(*args[0]);
+                auto found = stringIndex.find(literal.value);
+                if (found == stringIndex.end()) {
+                    found = stringIndex.emplace(literal.value, program.strings.size()).first;
+                    program.strings.push_back(output::decodeString(literal.value) + '\n');
+                }
+                emit(Op::PRINT, found->second);
+                return;
+            }
+            if (name == "printi") {
+                emit(Op::PRINTI, compile(*args[0], -1));
+                return;
+            }
+
+            // The arguments go to consecutive registers, where the frame of the callee starts
+            int base = top;
+            for (const auto &arg : args) {
+                int slot = allocate();
+                compile(*arg, slot);
+                top = slot + 1;
+            }
+            size_t index = functionIndex.at(name);
+            emit(Op::CALL, index, base);
+            top = base;
+            resultType = returnTypes[index];
+            if (dst >= 0) {
+                emit(Op::MOVE, dst, base);
+                result = dst;
+            } else {
+                result = allocate();
+            }
+        }
+
+        void visit(ast::Statements &node) override {
+            Scope scope = openScope();
+            for (auto &statement : node.statements) {
+                compileStatement(*statement);
+            }
+            closeScope(scope);
+        }
+
+        void visit(ast::Break &) override {
+            emit(Op::JMP, loops.back().second);
+        }
+
+        void visit(ast::Continue &) override {
+            emit(Op::JMP, loops.back().first);
+        }
+
+        void visit(ast::Return &node) override {
+            if (node.exp) {
+                emit(Op::RET, compile(*node.exp, -1));
+            } else {
+                emit(Op::RETV);
+            }
+        }
+
+        void visit(ast::If &node) override {
+            int end = newLabel();
+            if (node.otherwise) {
+                int otherwise = newLabel();
+                branch(*node.condition, false, otherwise);
+                compileScoped(*node.then);
+                emit(Op::JMP, end);
+                bind(otherwise);
+                compileScoped(*node.otherwise);
+            } else {
+                branch(*node.condition, false, end);
+                compileScoped(*node.then);
+            }
+            bind(end);
+        }
+
+        void visit(ast::While &node) override {
+            // The condition is compiled after the body, so that every iteration takes one branch
+            int condition = newLabel();
+            int body = newLabel();
+            int end = newLabel();
+            emit(Op::JMP, condition);
+            bind(body);
+            loops.emplace_back(condition, end);
+            compileScoped(*node.body);
+            loops.pop_back();
+            bind(condition);
+            branch(*node.condition, true, body);
+            bind(end);
+        }
+
+        void visit(ast::VarDecl &node) override {
+            // The initial value is computed straight into the register of the variable, which is
+            // only named once it is initialized
+            int reg = locals++;
+            top = locals;
+            frameSize = std::max(frameSize, top);
+            if (node.init_exp) {
+                compile(*node.init_exp, reg);
+            } else {
+                emit(Op::LOADI, reg, 0);
+            }
+            variables.push_back({&node.id->value, reg, node.type->type});
+        }
+
+        void visit(ast::Assign &node) override {
+            compile(*node.exp, lookup(node.id->value).reg);
+        }
+
+        void visit(ast::Formal &) override {
+        }
+
+        void visit(ast::Formals &) override {
+        }
+
+        void visit(ast::FuncDecl &node) override {
+            Function &function = program.functions[functionIndex.at(node.id->value)];
+            function.entry = program.code.size();
+            variables.clear();
+            const auto &formals = node.formals->formals;
+            for (size_t i = 0; i < formals.size(); ++i) {
+                variables.push_back({&formals[i]->id->value, int(i), formals[i]->type->type});
+            }
+            locals = top = frameSize = formals.size();
+
+            for (auto &statement : node.body->statements) {
+                compileStatement(*statement);
+            }
+            // Falling off the end returns 0, like the generated code
+            if (node.return_type->type == ast::BuiltInType::VOID) {
+                emit(Op::RETV);
+            } else {
+                int zero = allocate();
+                emit(Op::LOADI, zero, 0);
+                emit(Op::RET, zero);
+            }
+            function.frameSize = frameSize;
+        }
+
+        void visit(ast::Funcs &node) override {
+            for (const auto &func : node.funcs) {
+                func->accept(*this);
+            }
+        }
+
+    private:
+        struct Variable {
+            const std::string *name;
+            int reg;
+            ast::BuiltInType type;
+        };
+
+        struct Scope {
+            size_t variables;
+            int locals;
+        };
+
+        Program program;
+        std::unordered_map<std::string, size_t> functionIndex;
+        std::vector<ast::BuiltInType> returnTypes;
+        std::unordered_map<std::string, int> stringIndex;
+
+        // Variables in scope in the function, innermost last
+        std::vector<Variable> variables;
+        // Registers held by variables; the temporaries start here
+        int locals = 0;
+        // First free register
+        int top = 0;
+        int frameSize = 0;
+        // Condition and end labels of the enclosing loops
+        std::vector<std::pair<int, int>> loops;
+        // Position of each label in the code, -1 until bound
+        std::vector<int> labels;
+        // Position of the last label bound; the instructions before it cannot be fused with the
+        // ones after it, which may be reached by a jump
+        size_t lastBound = 0;
+
+        // Parameter and results of the expression visits (see compile())
+        int target = -1;
+        int result = -1;
+        ast::BuiltInType resultType = ast::BuiltInType::VOID;
+
+        void emit(Op op, int a = 0, int b = 0, int c = 0) {
+            Instruction inst;
+            inst.op = op;
+            inst.a = a;
+            inst.b = b;
+            inst.c = c;
+            program.code.push_back(inst);
+        }
+
+        int newLabel() {
+            labels.push_back(-1);
+            return labels.size() - 1;
+        }
+
+        void bind(int label) {
+            labels[label] = program.code.size();
+            lastBound = program.code.size();
+        }
+
+        int allocate() {
+            frameSize = std::max(frameSize, top + 1);
+            return top++;
+        }
+
+        // The register an expression visit writes its value to
+        int destination(int dst) {
+            return dst >= 0 ? dst : allocate();
+        }
+
+        int destination() {
+            return destination(target);
+        }
+
+        const Variable &lookup(const std::string &name) const {
+            for (size_t i = variables.size(); i-- > 0;) {
+                if (*variables[i].name == name) {
+                    return variables[i];
+                }
+            }
+            throw std::runtime_error("Undefined variable " + name);
+        }
+
+        Scope openScope() const {
+            return {variables.size(), locals};
+        }
+
+        void closeScope(const Scope &scope) {
+            variables.resize(scope.variables);
+            locals = top = scope.locals;
+        }
+
+        int compile(ast::Exp &exp, int dst) {
+            int saved = target;
+            target = dst;
+            exp.accept(*this);
+            target = saved;
+            // Values used as bytes are truncated; bytes widen to ints as they are
+            if (exp.type == ast::BuiltInType::BYTE && resultType == ast::BuiltInType::INT) {
+                int converted = dst >= 0 || result >= locals ? result : allocate();
+                emit(Op::TRUNC, converted, result);
+                result = converted;
+            }
+            return result;
+        }
+
+        void compileStatement(ast::Statement &statement) {
+            int saved = target;
+            target = -1;
+            statement.accept(*this);
+            target = saved;
+            top = locals;
+        }
+
+        // The body of an if or a while has a scope of its own, even without braces
+        void compileScoped(ast::Statement &statement) {
+            Scope scope = openScope();
+            compileStatement(statement);
+            closeScope(scope);
+        }
+
+        // Compiles the operands of a comparison: rhs is a register, or an immediate if immediate
+        // is set. Bytes are compared as signed i8, as the generated code does
+        void compare(ast::RelOp &node, Condition &condition, int &lhs, int &rhs, bool &immediate) {
+            condition = conditionOf(node.op);
+            bool bytes = node.left->type == ast::BuiltInType::BYTE && condition != Condition::EQ
+                         && condition != Condition::NE;
+            ast::Exp *left = node.left.get();
+            ast::Exp *right = node.right.get();
+            int constant;
+            if (constantOf(*left, constant) && !constantOf(*right, constant)) {
+                std::swap(left, right);
+                condition = mirror(condition);
+            }
+            lhs = compile(*left, -1);
+            if (bytes) {
+                lhs = signExtend(lhs);
+            }
+            immediate = constantOf(*right, rhs);
+            if (immediate) {
+                rhs = bytes ? int8_t(rhs) : rhs;
+            } else {
+                rhs = compile(*right, -1);
+                if (bytes) {
+                    rhs = signExtend(rhs);
+                }
+            }
+        }
+
+        int signExtend(int reg) {
+            int extended = reg >= locals ? reg : allocate();
+            emit(Op::SEXT8, extended, reg);
+            return extended;
+        }
+
+        // Value of && and ||: the jumping code of branch() setting the result to 1 or 0
+        void logical(ast::Exp &node) {
+            int dst = destination();
+            int otherwise = newLabel();
+            int end = newLabel();
+            branch(node, false, otherwise);
+            emit(Op::LOADI, dst, 1);
+            emit(Op::JMP, end);
+            bind(otherwise);
+            emit(Op::LOADI, dst, 0);
+            bind(end);
+            result = dst;
+            resultType = ast::BuiltInType::BOOL;
+        }
+
+        // Jumps to label if the boolean expression evaluates to when, and falls through otherwise.
+        // &&, || and ! become jumps without computing their value
+        void branch(ast::Exp &exp, bool when, int label) {
+            if (auto boolean = dynamic_cast<ast::Bool *>(&exp)) {
+                if (boolean->value == when) {
+                    emit(Op::JMP, label);
+                }
+                return;
+            }
+            if (auto negation = dynamic_cast<ast::Not *>(&exp)) {
+                branch(*negation->exp, !when, label);
+                return;
+            }
+            auto conjunction = dynamic_cast<ast::And *>(&exp);
+            auto disjunction = dynamic_cast<ast::Or *>(&exp);
+            if (conjunction || disjunction) {
+                ast::Exp &left = conjunction ? *conjunction->left : *disjunction->left;
+                ast::Exp &right = conjunction ? *conjunction->right : *disjunction->right;
+                // The left operand alone decides the result if it is false for && and true for ||
+                bool decisive = !conjunction;
+                if (decisive == when) {
+                    branch(left, when, label);
+                    branch(right, when, label);
+                } else {
+                    int skip = newLabel();
+                    branch(left, decisive, skip);
+                    branch(right, when, label);
+                    bind(skip);
+                }
+                return;
+            }
+            int saved = top;
+            int reg = compile(exp, -1);
+            top = saved;
+            emitBranch(reg, when, label, saved);
+        }
+
+        // Emits a jump on the value of reg. If reg is a temporary (at or above firstTemporary)
+        // just computed by a compare, the two are fused into a jump on the compare
+        void emitBranch(int reg, bool when, int label, int firstTemporary) {
+            auto &code = program.code;
+            if (!code.empty() && lastBound != code.size() && isCompare(code.back().op)
+                && code.back().a == reg && reg >= firstTemporary) {
+                Instruction &last = code.back();
+                bool immediate = last.op >= Op::EQI;
+                Condition condition = Condition(uint8_t(last.op) - uint8_t(immediate ? Op::EQI : Op::EQ));
+                last.op = offset(immediate ? Op::JEQI : Op::JEQ, when ? condition : negate(condition));
+                last.a = label;
+                return;
+            }
+            emit(when ? Op::JNZ : Op::JZ, label, reg);
+        }
+    };
+
+    Program compile(ast::Funcs &program) {
+        Compiler compiler(program);
+        program.accept(compiler);
+        return compiler.finish();
+    }
+
+    [[noreturn]] static void divisionByZero() {
+        std::fputs("Error division by zero\n", stdout);
+        std::exit(1);
+    }
+
+    static int divide(int dividend, int divisor) {
+        if (divisor == 0) {
+            divisionByZero();
+        }
+        // The smallest int divided by -1 overflows (the generated sdiv traps); take the wrapped result
+        if (divisor == -1) {
+            return int(0u - uint32_t(dividend));
+        }
+        return dividend / divisor;
+    }
+
+    static int wrap(uint32_t value) {
+        return int(value);
+    }
+
+    void execute(const Program &program) {
+        // Threaded dispatch: every handler jumps straight to the handler of the next instruction
+        // through this table (computed goto, a GNU extension supported by g++ and clang). The
+        // handlers are in the order of Op
+        static const void *const handlers[] = {
+                &&LOADI, &&MOVE, &&ADD, &&SUB, &&MUL, &&DIV, &&ADDI, &&SUBI, &&MULI, &&DIVI, &&TRUNC,
+                &&SEXT8, &&NOT, &&EQ, &&NE, &&LT, &&LE, &&GT, &&GE, &&EQI, &&NEI, &&LTI, &&LEI, &&GTI,
+                &&GEI, &&JMP, &&JZ, &&JNZ, &&JEQ, &&JNE, &&JLT, &&JLE, &&JGT, &&JGE, &&JEQI, &&JNEI,
+                &&JLTI, &&JLEI, &&JGTI, &&JGEI, &&CALL, &&RET, &&RETV, &&PRINT, &&PRINTI};
+        static_assert(sizeof(handlers) / sizeof(*handlers) == size_t(Op::PRINTI) + 1, "a handler for every Op");
+
+        /* A call in progress: where its caller continues */
+        struct Frame {
+            const Instruction *returnTo;
+            size_t base;
+        };
+
+        const Instruction *code = program.code.data();
+        const Function &main = program.functions[program.main];
+        // Registers of all the active calls; the frame of a callee starts at the arguments
+        std::vector<int> stack(std::max<size_t>(64 * 1024, main.frameSize));
+        std::vector<Frame> calls;
+        size_t base = 0;
+        int *r = stack.data();
+        const Instruction *pc = code + main.entry;
+
+#define DISPATCH() goto *handlers[size_t(pc->op)]
+#define NEXT() do { ++pc; DISPATCH(); } while (0)
+#define COMPARE(cond) do { r[pc->a] = r[pc->b] cond r[pc->c]; NEXT(); } while (0)
+#define COMPARE_IMMEDIATE(cond) do { r[pc->a] = r[pc->b] cond pc->c; NEXT(); } while (0)
+#define JUMP_IF(test) do { pc = (test) ? code + pc->a : pc + 1; DISPATCH(); } while (0)
+
+        DISPATCH();
+    LOADI:
+        r[pc->a] = pc->b;
+        NEXT();
+    MOVE:
+        r[pc->a] = r[pc->b];
+        NEXT();
+    ADD:
+        r[pc->a] = wrap(uint32_t(r[pc->b]) + uint32_t(r[pc->c]));
+        NEXT();
+    SUB:
+        r[pc->a] = wrap(uint32_t(r[pc->b]) - uint32_t(r[pc->c]));
+        NEXT();
+    MUL:
+        r[pc->a] = wrap(uint32_t(r[pc->b]) * uint32_t(r[pc->c]));
+        NEXT();
+    DIV:
+        r[pc->a] = divide(r[pc->b], r[pc->c]);
+        NEXT();
+    ADDI:
+        r[pc->a] = wrap(uint32_t(r[pc->b]) + uint32_t(pc->c));
+        NEXT();
+    SUBI:
+        r[pc->a] = wrap(uint32_t(r[pc->b]) - uint32_t(pc->c));
+        NEXT();
+    MULI:
+        r[pc->a] = wrap(uint32_t(r[pc->b]) * uint32_t(pc->c));
+        NEXT();
+    DIVI:
+        r[pc->a] = divide(r[pc->b], pc->c);
+        NEXT();
+    TRUNC:
+        r[pc->a] = r[pc->b] & 0xff;
+        NEXT();
+    SEXT8:
+        r[pc->a] = int8_t(r[pc->b]);
+        NEXT();
+    NOT:
+        r[pc->a] = !r[pc->b];
+        NEXT();
+    EQ:
+        COMPARE(==);
+    NE:
+        COMPARE(!=);
+    LT:
+        COMPARE(<);
+    LE:
+        COMPARE(<=);
+    GT:
+        COMPARE(>);
+    GE:
+        COMPARE(>=);
+    EQI:
+        COMPARE_IMMEDIATE(==);
+    NEI:
+        COMPARE_IMMEDIATE(!=);
+    LTI:
+        COMPARE_IMMEDIATE(<);
+    LEI:
+        COMPARE_IMMEDIATE(<=);
+    GTI:
+        COMPARE_IMMEDIATE(>);
+    GEI:
+        COMPARE_IMMEDIATE(>=);
+    JMP:
+        pc = code + pc->a;
+        DISPATCH();
+    JZ:
+        JUMP_IF(r[pc->b] == 0);
+    JNZ:
+        JUMP_IF(r[pc->b] != 0);
+    JEQ:
+        JUMP_IF(r[pc->b] == r[pc->c]);
+    JNE:
+        JUMP_IF(r[pc->b] != r[pc->c]);
+    JLT:
+        JUMP_IF(r[pc->b] < r[pc->c]);
+    JLE:
+        JUMP_IF(r[pc->b] <= r[pc->c]);
+    JGT:
+        JUMP_IF(r[pc->b] > r[pc->c]);
+    JGE:
+        JUMP_IF(r[pc->b] >= r[pc->c]);
+    JEQI:
+        JUMP_IF(r[pc->b] == pc->c);
+    JNEI:
+        JUMP_IF(r[pc->b] != pc->c);
+    JLTI:
+        JUMP_IF(r[pc->b] < pc->c);
+    JLEI:
+        JUMP_IF(r[pc->b] <= pc->c);
+    JGTI:
+        JUMP_IF(r[pc->b] > pc->c);
+    JGEI:
+        JUMP_IF(r[pc->b] >= pc->c);
+    CALL: {
+        const Function &callee = program.functions[pc->a];
+        calls.push_back({pc + 1, base});
+        base += pc->b;
+        if (base + callee.frameSize > stack.size()) {
+            stack.resize(std::max(2 * stack.size(), base + callee.frameSize));
+        }
+        r = stack.data() + base;
+        pc = code + callee.entry;
+        DISPATCH();
+    }
+    RET:
+        // The first register of the callee is the one of the caller that takes the result
+        r[0] = r[pc->a];
+    RETV:
+        if (calls.empty()) {
+            std::fflush(stdout);
+            return;
+        }
+        pc = calls.back().returnTo;
+        base = calls.back().base;
+        calls.pop_back();
+        r = stack.data() + base;
+        DISPATCH();
+    PRINT:
+        std::fputs(program.strings[pc->a].c_str(), stdout);
+        NEXT();
+    PRINTI:
+        std::printf("%d\n", r[pc->a]);
+        NEXT();
+
+#undef DISPATCH
+#undef NEXT
+#undef COMPARE
+#undef COMPARE_IMMEDIATE
+#undef JUMP_IF
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "nodes.hpp"
+
+namespace bytecode {
+
+    /* Instruction set of a register machine. Every call has a frame of int registers: the
+     * parameters come first, then the variables and temporaries of the function, allocated like a
+     * stack as scopes and expressions open and close. In the comments r[x] is register x of the
+     * running frame and k an immediate.
+     *
+     * The compare, compare-immediate, jump-on-compare and jump-on-compare-immediate groups each
+     * list the conditions in the order of Condition, so that the opcode is the first one of the
+     * group plus the condition. The jumps on a compare are superinstructions: a compare into a
+     * temporary immediately followed by a jump on that temporary is fused into one of them */
+    enum class Op : uint8_t {
+        LOADI,  // r[a] = k(b)
+        MOVE,   // r[a] = r[b]
+        ADD,    // r[a] = r[b] + r[c]
+        SUB,    // r[a] = r[b] - r[c]
+        MUL,    // r[a] = r[b] * r[c]
+        DIV,    // r[a] = r[b] / r[c], or the division by zero error
+        ADDI,   // r[a] = r[b] + k(c)
+        SUBI,   // r[a] = r[b] - k(c)
+        MULI,   // r[a] = r[b] * k(c)
+        DIVI,   // r[a] = r[b] / k(c), or the division by zero error
+        TRUNC,  // r[a] = r[b] as a byte
+        SEXT8,  // r[a] = r[b] as a signed i8 (bytes are compared as such)
+        NOT,    // r[a] = !r[b]
+        EQ, NE, LT, LE, GT, GE,         // r[a] = r[b] cond r[c]
+        EQI, NEI, LTI, LEI, GTI, GEI,   // r[a] = r[b] cond k(c)
+        JMP,    // jump to a
+        JZ,     // if r[b] == 0 jump to a
+        JNZ,    // if r[b] != 0 jump to a
+        JEQ, JNE, JLT, JLE, JGT, JGE,         // if r[b] cond r[c] jump to a
+        JEQI, JNEI, JLTI, JLEI, JGTI, JGEI,   // if r[b] cond k(c) jump to a
+        CALL,   // calls function a with its frame starting at r[b] (where the arguments are); the
+                // result is left in r[b]
+        RET,    // returns r[a]
+        RETV,   // returns nothing
+        PRINT,  // prints string a
+        PRINTI  // prints r[a]
+    };
+
+    enum class Condition : uint8_t {
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE
+    };
+
+    struct Instruction {
+        Op op;
+        int32_t a = 0;
+        int32_t b = 0;
+        int32_t c = 0;
+    };
+
+    struct Function {
+        std::string name;
+        // Index of the first instruction in Program::code
+        size_t entry = 0;
+        // Number of registers of a frame
+        int frameSize = 0;
+    };
+
+    struct Program {
+        std::vector<Instruction> code;
+        std::vector<Function> functions;
+        // Bytes printed by each PRINT, newline included
+        std::vector<std::string> strings;
+        size_t main = 0;
+    };
+
+    // Compiles a program checked by SemanticVisitor (see interpreter::check), with the types it
+    // left on the nodes
+    Program compile(ast::Funcs &program);
+
+    // Runs main. Values behave as in the generated code (see interpreter::Interpreter)
+    void execute(const Program &program);
+}
+
+#endif //BYTECODE_HPP
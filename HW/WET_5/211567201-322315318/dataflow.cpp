@@ -0,0 +1,226 @@
+#include "dataflow.hpp"
+#include <algorithm>
+
+namespace dataflow {
+
+    using output::Value;
+
+    CFG::CFG(const ir::Function &function) {
+        size_t n = function.blocks.size();
+        successors.resize(n);
+        predecessors.resize(n);
+
+        std::unordered_map<int, size_t> blockOf;
+        for (size_t i = 0; i < n; ++i) {
+            blockOf[function.blocks[i].label.id] = i;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const ir::BasicBlock &block = function.blocks[i];
+            if (!block.terminated()) {
+                continue;
+            }
+            const ir::Instruction &branch = block.instructions.back();
+            for (output::Label target : {branch.target, branch.otherTarget}) {
+                if (target.id < 0) {
+                    continue;
+                }
+                size_t successor = blockOf.at(target.id);
+                // Both arms of a conditional branch may go to the same block
+                if (std::find(successors[i].begin(), successors[i].end(), successor) == successors[i].end()) {
+                    successors[i].push_back(successor);
+                    predecessors[successor].push_back(i);
+                }
+            }
+        }
+
+        // Iterative depth-first search from the entry block, recording the postorder. Successors are
+        // explored last to first: the exit of a loop (the false target of its condition) is then
+        // finished before the body, which puts the body right after the header in reverse postorder
+        // instead of after all the code following the loop
+        std::vector<bool> visited(n, false);
+        std::vector<std::pair<size_t, size_t>> stack = {{0, 0}};
+        visited[0] = true;
+        while (!stack.empty()) {
+            auto &top = stack.back();
+            const auto &successorsOfTop = successors[top.first];
+            if (top.second < successorsOfTop.size()) {
+                size_t next = successorsOfTop[successorsOfTop.size() - 1 - top.second++];
+                if (!visited[next]) {
+                    visited[next] = true;
+                    stack.emplace_back(next, 0);
+                }
+            } else {
+                order.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+        std::reverse(order.begin(), order.end());
+    }
+
+    /* Dominators, by the iterative algorithm of Cooper, Harvey and Kennedy */
+
+    DominatorTree::DominatorTree(const CFG &cfg) {
+        size_t n = cfg.size();
+        idom.assign(n, SIZE_MAX);
+        children.resize(n);
+        frontier.resize(n);
+        if (cfg.order.empty()) {
+            return;
+        }
+        std::vector<size_t> rank(n, SIZE_MAX);
+        for (size_t i = 0; i < cfg.order.size(); ++i) {
+            rank[cfg.order[i]] = i;
+        }
+        // Walks up from both blocks to their nearest common dominator
+        auto intersect = [&](size_t a, size_t b) {
+            while (a != b) {
+                while (rank[a] > rank[b]) {
+                    a = idom[a];
+                }
+                while (rank[b] > rank[a]) {
+                    b = idom[b];
+                }
+            }
+            return a;
+        };
+
+        size_t entry = cfg.order.front();
+        idom[entry] = entry;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = 1; i < cfg.order.size(); ++i) {
+                size_t block = cfg.order[i];
+                size_t dominator = SIZE_MAX;
+                for (size_t predecessor : cfg.predecessors[block]) {
+                    if (idom[predecessor] == SIZE_MAX) {
+                        continue;
+                    }
+                    dominator = dominator == SIZE_MAX ? predecessor : intersect(predecessor, dominator);
+                }
+                if (idom[block] != dominator) {
+                    idom[block] = dominator;
+                    changed = true;
+                }
+            }
+        }
+
+        for (size_t block : cfg.order) {
+            if (block != entry) {
+                children[idom[block]].push_back(block);
+            }
+            if (cfg.predecessors[block].size() < 2) {
+                continue;
+            }
+            for (size_t predecessor : cfg.predecessors[block]) {
+                for (size_t runner = predecessor; idom[runner] != SIZE_MAX && runner != idom[block]; runner = idom[runner]) {
+                    if (frontier[runner].empty() || frontier[runner].back() != block) {
+                        frontier[runner].push_back(block);
+                    }
+                }
+            }
+        }
+    }
+
+    bool DominatorTree::dominates(size_t a, size_t b) const {
+        if (idom[b] == SIZE_MAX) {
+            return false;
+        }
+        while (b != a && idom[b] != b) {
+            b = idom[b];
+        }
+        return b == a;
+    }
+
+    size_t BitSet::count() const {
+        size_t total = 0;
+        for (uint64_t word : words) {
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+
+    /* Liveness */
+
+    Liveness::Liveness(const ir::Function &function) {
+        std::unordered_map<int, size_t> definedIn;
+        for (size_t b = 0; b < function.blocks.size(); ++b) {
+            for (const auto &inst : function.blocks[b].instructions) {
+                if (inst.dst.kind == Value::Kind::TEMP) {
+                    definedIn.emplace(inst.dst.id, b);
+                }
+            }
+        }
+        for (size_t b = 0; b < function.blocks.size(); ++b) {
+            for (const auto &inst : function.blocks[b].instructions) {
+                ir::forEachUse(inst, [&](const Value &value) {
+                    if (value.kind != Value::Kind::TEMP || numbering.count(value.id)) {
+                        return;
+                    }
+                    auto found = definedIn.find(value.id);
+                    if (found != definedIn.end() && found->second != b) {
+                        numbering.emplace(value.id, registers.size());
+                        registers.push_back(value);
+                    }
+                });
+            }
+        }
+
+        uses.assign(function.blocks.size(), bottom());
+        defs.assign(function.blocks.size(), bottom());
+        for (size_t b = 0; b < function.blocks.size(); ++b) {
+            // Walk backwards, so that a use is only upward exposed if no definition precedes it
+            const auto &insts = function.blocks[b].instructions;
+            for (auto inst = insts.rbegin(); inst != insts.rend(); ++inst) {
+                int defined = index(inst->dst);
+                if (defined >= 0 && (inst->opcode != ir::Opcode::CALL || inst->type != ast::BuiltInType::VOID)) {
+                    defs[b].set(defined);
+                    uses[b].reset(defined);
+                }
+                ir::forEachUse(*inst, [&](const Value &value) {
+                    int used = index(value);
+                    if (used >= 0) {
+                        uses[b].set(used);
+                    }
+                });
+            }
+        }
+    }
+
+    int Liveness::index(Value value) const {
+        if (value.kind != Value::Kind::TEMP) {
+            return -1;
+        }
+        auto found = numbering.find(value.id);
+        return found == numbering.end() ? -1 : (int) found->second;
+    }
+
+    /* Reaching definitions */
+
+    ReachingDefinitions::ReachingDefinitions(const ir::Function &function) {
+        std::unordered_map<int, std::vector<size_t>> definitionsOf;
+        for (size_t b = 0; b < function.blocks.size(); ++b) {
+            const auto &insts = function.blocks[b].instructions;
+            for (size_t i = 0; i < insts.size(); ++i) {
+                if (insts[i].opcode == ir::Opcode::STORE) {
+                    definitionsOf[insts[i].rhs.id].push_back(definitions.size());
+                    definitions.push_back({b, i, insts[i].rhs.id});
+                }
+            }
+        }
+
+        gens.assign(function.blocks.size(), bottom());
+        kills.assign(function.blocks.size(), bottom());
+        for (size_t d = 0; d < definitions.size(); ++d) {
+            const Definition &definition = definitions[d];
+            // Stores later in the block replace earlier ones: the last store to a slot wins
+            for (size_t other : definitionsOf[definition.slot]) {
+                if (definitions[other].block == definition.block) {
+                    gens[definition.block].reset(other);
+                }
+                kills[definition.block].set(other);
+            }
+            gens[definition.block].set(d);
+        }
+    }
+}
@@ -0,0 +1,329 @@
+#ifndef DATAFLOW_HPP
+#define DATAFLOW_HPP
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+#include "ir.hpp"
+
+namespace dataflow {
+
+    /* Control flow graph of an ir::Function. Block i of the graph is function.blocks[i] */
+    struct CFG {
+        std::vector<std::vector<size_t>> successors;
+        std::vector<std::vector<size_t>> predecessors;
+        // Blocks reachable from the entry block, in reverse postorder
+        std::vector<size_t> order;
+
+        explicit CFG(const ir::Function &function);
+
+        size_t size() const {
+            return successors.size();
+        }
+    };
+
+    /* Dominator tree of the reachable blocks: a block dominates another if every path from the
+     * entry block to the other goes through it */
+    struct DominatorTree {
+        // Immediate dominator of each block (the entry block's is itself); SIZE_MAX if unreachable
+        std::vector<size_t> idom;
+        std::vector<std::vector<size_t>> children;
+        // Dominance frontier: the blocks where the dominance of each block ends
+        std::vector<std::vector<size_t>> frontier;
+
+        explicit DominatorTree(const CFG &cfg);
+
+        bool dominates(size_t a, size_t b) const;
+    };
+
+    /* Fixed-size set of small integers, the facts of the bit-vector analyses */
+    class BitSet {
+    public:
+        BitSet() = default;
+
+        explicit BitSet(size_t size) : words((size + 63) / 64, 0) {}
+
+        void set(size_t i) {
+            words[i / 64] |= uint64_t(1) << (i % 64);
+        }
+
+        void reset(size_t i) {
+            words[i / 64] &= ~(uint64_t(1) << (i % 64));
+        }
+
+        bool test(size_t i) const {
+            return (words[i / 64] >> (i % 64)) & 1;
+        }
+
+        // this |= other; returns whether this changed
+        bool unite(const BitSet &other) {
+            bool changed = false;
+            for (size_t i = 0; i < words.size(); ++i) {
+                uint64_t united = words[i] | other.words[i];
+                changed |= united != words[i];
+                words[i] = united;
+            }
+            return changed;
+        }
+
+        // this = gen | (this & ~kill)
+        void apply(const BitSet &gen, const BitSet &kill) {
+            for (size_t i = 0; i < words.size(); ++i) {
+                words[i] = gen.words[i] | (words[i] & ~kill.words[i]);
+            }
+        }
+
+        size_t count() const;
+
+        bool operator==(const BitSet &other) const {
+            return words == other.words;
+        }
+
+        bool operator!=(const BitSet &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        std::vector<uint64_t> words;
+    };
+
+    enum class Direction {
+        FORWARD,
+        BACKWARD
+    };
+
+    /* Facts at the start (in) and at the end (out) of every block, in program order */
+    template<typename Fact>
+    struct Solution {
+        std::vector<Fact> in;
+        std::vector<Fact> out;
+        // Number of times a transfer function was applied
+        size_t visits = 0;
+    };
+
+    // Detects the optional members of an analysis (see solve())
+    template<typename Analysis, typename = void>
+    struct HasEdge : std::false_type {};
+
+    template<typename Analysis>
+    struct HasEdge<Analysis, std::void_t<decltype(std::declval<const Analysis &>().edge(
+            size_t(), size_t(), std::declval<typename Analysis::Fact &>()))>> : std::true_type {};
+
+    template<typename Analysis, typename = void>
+    struct HasWiden : std::false_type {};
+
+    template<typename Analysis>
+    struct HasWiden<Analysis, std::void_t<decltype(std::declval<const Analysis &>().widen(
+            size_t(), std::declval<const typename Analysis::Fact &>(), std::declval<typename Analysis::Fact &>()))>> : std::true_type {};
+
+    /* Solves a dataflow problem by chaotic iteration with a worklist. The worklist always hands out
+     * the pending block that comes first in reverse postorder (postorder for backward problems), so
+     * that acyclic regions settle in a single pass and loops are iterated inside out.
+     *
+     * An Analysis provides:
+     *      using Fact = ...;                              // a lattice element, comparable with !=
+     *      static const Direction direction;
+     *      Fact bottom() const;                           // the least element
+     *      Fact boundary() const;                         // fact entering the entry block (forward)
+     *                                                     // or leaving the exit blocks (backward)
+     *      bool join(Fact &into, const Fact &from) const; // into = into |_| from; returns whether it changed
+     *      void transfer(size_t block, Fact &fact) const; // applies the block, in the analysis direction
+     * Transfer functions must be monotone and the lattice of finite height for the iteration to stop.
+     *
+     * Optionally, for lattices of infinite (or very large) height and path-sensitive facts:
+     *      void edge(size_t from, size_t to, Fact &fact) const;
+     *          // refines the fact flowing along the CFG edge from -> to (e.g. by the branch condition)
+     *      void widen(size_t block, const Fact &previous, Fact &next) const;
+     *          // extrapolates next from the previous fact at the head of a loop, so that every
+     *          // ascending chain stops; the widened solution is then improved by
+     *      static const int NARROWING_PASSES;
+     *          // rounds of plain (decreasing) iteration
+     */
+    template<typename Analysis>
+    Solution<typename Analysis::Fact> solve(const CFG &cfg, const Analysis &analysis) {
+        using Fact = typename Analysis::Fact;
+        const bool forward = Analysis::direction == Direction::FORWARD;
+        size_t n = cfg.size();
+
+        Solution<Fact> solution;
+        solution.in.assign(n, analysis.bottom());
+        solution.out.assign(n, analysis.bottom());
+        // Facts flowing into a block in the analysis direction, and out of it
+        std::vector<Fact> &before = forward ? solution.in : solution.out;
+        std::vector<Fact> &after = forward ? solution.out : solution.in;
+        const auto &sources = forward ? cfg.predecessors : cfg.successors;
+        const auto &targets = forward ? cfg.successors : cfg.predecessors;
+
+        // Priority of each reachable block; unreachable blocks keep bottom
+        std::vector<size_t> rank(n, SIZE_MAX);
+        for (size_t i = 0; i < cfg.order.size(); ++i) {
+            rank[cfg.order[i]] = forward ? i : cfg.order.size() - 1 - i;
+        }
+        std::vector<size_t> byRank(cfg.order.size());
+        for (size_t block : cfg.order) {
+            byRank[rank[block]] = block;
+        }
+
+        std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> worklist;
+        std::vector<bool> queued(n, false);
+        for (size_t i = 0; i < byRank.size(); ++i) {
+            worklist.push(i);
+            queued[byRank[i]] = true;
+        }
+
+        // Fact flowing into the block: the join over the incoming edges
+        auto incoming = [&](size_t block) {
+            Fact fact = analysis.bottom();
+            if (forward ? block == cfg.order.front() : cfg.successors[block].empty()) {
+                analysis.join(fact, analysis.boundary());
+            }
+            for (size_t source : sources[block]) {
+                if (rank[source] == SIZE_MAX) {
+                    continue;
+                }
+                if constexpr (HasEdge<Analysis>::value) {
+                    Fact flowing = after[source];
+                    analysis.edge(forward ? source : block, forward ? block : source, flowing);
+                    analysis.join(fact, flowing);
+                } else {
+                    analysis.join(fact, after[source]);
+                }
+            }
+            return fact;
+        };
+
+        while (!worklist.empty()) {
+            size_t block = byRank[worklist.top()];
+            worklist.pop();
+            queued[block] = false;
+
+            Fact fact = incoming(block);
+            if constexpr (HasWiden<Analysis>::value) {
+                // Loop heads are the blocks reached by an edge from a block of a later (or the same) rank
+                bool loopHead = false;
+                for (size_t source : sources[block]) {
+                    loopHead |= rank[source] != SIZE_MAX && rank[source] >= rank[block];
+                }
+                if (loopHead) {
+                    analysis.widen(block, before[block], fact);
+                }
+            }
+            before[block] = fact;
+            analysis.transfer(block, fact);
+            ++solution.visits;
+            if (fact != after[block]) {
+                after[block] = std::move(fact);
+                for (size_t target : targets[block]) {
+                    if (rank[target] != SIZE_MAX && !queued[target]) {
+                        queued[target] = true;
+                        worklist.push(rank[target]);
+                    }
+                }
+            }
+        }
+
+        if constexpr (HasWiden<Analysis>::value) {
+            for (int pass = 0; pass < Analysis::NARROWING_PASSES; ++pass) {
+                for (size_t block : byRank) {
+                    Fact fact = incoming(block);
+                    before[block] = fact;
+                    analysis.transfer(block, fact);
+                    ++solution.visits;
+                    after[block] = std::move(fact);
+                }
+            }
+        }
+        return solution;
+    }
+
+    /* Live registers: a register is live at a point if some path from it reads the register before
+     * it is defined again. Only registers read outside the block that defines them are tracked (the
+     * others are never live across a block boundary), numbered densely, see index() */
+    class Liveness {
+    public:
+        using Fact = BitSet;
+        static const Direction direction = Direction::BACKWARD;
+
+        explicit Liveness(const ir::Function &function);
+
+        Fact bottom() const {
+            return BitSet(registers.size());
+        }
+
+        Fact boundary() const {
+            return bottom();
+        }
+
+        bool join(Fact &into, const Fact &from) const {
+            return into.unite(from);
+        }
+
+        void transfer(size_t block, Fact &fact) const {
+            fact.apply(uses[block], defs[block]);
+        }
+
+        // Dense number of a register, or -1 if it is not tracked
+        int index(output::Value value) const;
+
+        // The register with the given dense number
+        output::Value value(size_t index) const {
+            return registers[index];
+        }
+
+    private:
+        std::unordered_map<int, size_t> numbering;
+        std::vector<output::Value> registers;
+        // Registers read before any definition in the block, and registers defined in it
+        std::vector<BitSet> uses;
+        std::vector<BitSet> defs;
+    };
+
+    /* Reaching definitions of variables: the definitions are the stores to allocas, and a store
+     * reaches a point if some path from it gets there without another store to the same alloca */
+    class ReachingDefinitions {
+    public:
+        using Fact = BitSet;
+        static const Direction direction = Direction::FORWARD;
+
+        /* A store: instruction index within its block */
+        struct Definition {
+            size_t block;
+            size_t index;
+            // The alloca stored to
+            int slot;
+        };
+
+        explicit ReachingDefinitions(const ir::Function &function);
+
+        Fact bottom() const {
+            return BitSet(definitions.size());
+        }
+
+        Fact boundary() const {
+            return bottom();
+        }
+
+        bool join(Fact &into, const Fact &from) const {
+            return into.unite(from);
+        }
+
+        void transfer(size_t block, Fact &fact) const {
+            fact.apply(gens[block], kills[block]);
+        }
+
+        const std::vector<Definition> &getDefinitions() const {
+            return definitions;
+        }
+
+    private:
+        std::vector<Definition> definitions;
+        std::vector<BitSet> gens;
+        std::vector<BitSet> kills;
+    };
+}
+
+#endif //DATAFLOW_HPP
@@ -0,0 +1,332 @@
+#include "interpreter.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+
+namespace interpreter {
+
+    // Stack of the thread running the program. Every FanC call takes a few visits deep, so deep
+    // recursion needs much more than the default 8 MB; the pages are only touched when used
+    static const size_t STACK_SIZE = size_t(1) << 30;
+    // Part of the stack kept for the visits of the deepest call and for reporting the overflow
+    static const size_t STACK_RESERVE = size_t(1) << 20;
+
+    // The value as the given type holds it
+    static int convert(int value, ast::BuiltInType type) {
+        return type == ast::BuiltInType::BYTE ? value & 0xff : value;
+    }
+
+    Interpreter::Interpreter(ast::Funcs &program) {
+        for (const auto &func : program.funcs) {
+            functions.emplace(func->id->value, func.get());
+        }
+    }
+
+    void Interpreter::run() {
+        // The stack grows down from the end of the thread's stack area
+        pthread_attr_t attributes;
+        if (pthread_getattr_np(pthread_self(), &attributes) == 0) {
+            void *stack;
+            size_t size;
+            if (pthread_attr_getstack(&attributes, &stack, &size) == 0 && size > STACK_RESERVE) {
+                stackLimit = uintptr_t(stack) + STACK_RESERVE;
+            }
+            pthread_attr_destroy(&attributes);
+        }
+        ast::FuncDecl &main = *functions.at("main");
+        frame = variables.size();
+        main.accept(*this);
+        std::fflush(stdout);
+    }
+
+    int Interpreter::evaluate(ast::Exp &exp) {
+        exp.accept(*this);
+        return convert(value, exp.type);
+    }
+
+    int &Interpreter::variable(const ast::ID &id) {
+        return variables[ptrdiff_t(frame) + id.offset];
+    }
+
+    void Interpreter::stackOverflow(const ast::Call &call) {
+        std::fflush(stdout);
+        std::fprintf(stderr, "line %d: calls nested too deeply to interpret\n", call.line);
+        std::exit(1);
+    }
+
+    void Interpreter::divisionByZero() {
+        std::fputs("Error division by zero\n", stdout);
+        std::exit(1);
+    }
+
+    void Interpreter::visit(ast::Num &node) {
+        value = node.value;
+    }
+
+    void Interpreter::visit(ast::NumB &node) {
+        value = node.value;
+    }
+
+    void Interpreter::visit(ast::String &) {
+        // Strings only appear as the argument of print, which reads them itself
+    }
+
+    void Interpreter::visit(ast::Bool &node) {
+        value = node.value ? 1 : 0;
+    }
+
+    void Interpreter::visit(ast::ID &node) {
+        value = variable(node);
+    }
+
+    void Interpreter::visit(ast::BinOp &node) {
+        // Both operands have the type of the operation once the narrower one is widened
+        uint32_t left = evaluate(*node.left);
+        uint32_t right = evaluate(*node.right);
+        switch (node.op) {
+            case ast::BinOpType::ADD:
+                value = int(left + right);
+                break;
+            case ast::BinOpType::SUB:
+                value = int(left - right);
+                break;
+            case ast::BinOpType::MUL:
+                value = int(left * right);
+                break;
+            case ast::BinOpType::DIV:
+                if (right == 0) {
+                    divisionByZero();
+                }
+                if (node.left->type == ast::BuiltInType::BYTE) {
+                    value = int(left / right);
+                } else if (int(left) == INT32_MIN && int(right) == -1) {
+                    // Overflows (the generated sdiv traps); take the wrapped result
+                    value = INT32_MIN;
+                } else {
+                    value = int(left) / int(right);
+                }
+                break;
+        }
+        value = convert(value, node.left->type);
+    }
+
+    void Interpreter::visit(ast::RelOp &node) {
+        int left = evaluate(*node.left);
+        int right = evaluate(*node.right);
+        if (node.left->type == ast::BuiltInType::BYTE) {
+            // Bytes are compared with icmp on i8, which is signed
+            left = int8_t(left);
+            right = int8_t(right);
+        }
+        switch (node.op) {
+            case ast::RelOpType::EQ:
+                value = left == right;
+                break;
+            case ast::RelOpType::NE:
+                value = left != right;
+                break;
+            case ast::RelOpType::LT:
+                value = left < right;
+                break;
+            case ast::RelOpType::GT:
+                value = left > right;
+                break;
+            case ast::RelOpType::LE:
+                value = left <= right;
+                break;
+            case ast::RelOpType::GE:
+                value = left >= right;
+                break;
+        }
+    }
+
+    void Interpreter::visit(ast::Not &node) {
+        value = !evaluate(*node.exp);
+    }
+
+    void Interpreter::visit(ast::And &node) {
+        value = evaluate(*node.left) && evaluate(*node.right);
+    }
+
+    void Interpreter::visit(ast::Or &node) {
+        value = evaluate(*node.left) || evaluate(*node.right);
+    }
+
+    void Interpreter::visit(ast::Type &) {
+    }
+
+    void Interpreter::visit(ast::Cast &node) {
+        value = convert(evaluate(*node.exp), node.target_type->type);
+    }
+
+    void Interpreter::visit(ast::ExpList &node) {
+        for (auto &exp : node.exps) {
+            evaluate(*exp);
+        }
+    }
+
+    void Interpreter::visit(ast::Call &node) {
+        const std::string &name = node.func_id->value;
+        const auto &args = node.args->exps;
+        if (name == "print") {
+            // The only string expressions are literals
+            auto &literal = static_cast<ast::String &>(*args[0]);
+            auto found = strings.find(&literal);
+            if (found == strings.end()) {
+                found = strings.emplace(&literal, output::decodeString(literal.value) + '\n').first;
+            }
+            std::fputs(found->second.c_str(), stdout);
+            return;
+        }
+        if (name == "printi") {
+            std::printf("%d\n", evaluate(*args[0]));
+            return;
+        }
+
+        char here;
+        if (uintptr_t(&here) < stackLimit) {
+            stackOverflow(node);
+        }
+
+        // The arguments are evaluated in the caller's frame, before any parameter is bound. The
+        // calls among them leave nothing on top of the arguments before them
+        ast::FuncDecl &function = *functions.at(name);
+        size_t base = variables.size();
+        for (const auto &arg : args) {
+            int argument = evaluate(*arg);
+            variables.push_back(argument);
+        }
+        // The first parameter has offset -1, right below the locals
+        std::reverse(variables.begin() + base, variables.end());
+        size_t caller = frame;
+        frame = variables.size();
+
+        function.accept(*this);
+
+        variables.resize(base);
+        frame = caller;
+    }
+
+    void Interpreter::visit(ast::Statements &node) {
+        for (auto &statement : node.statements) {
+            statement->accept(*this);
+            if (flow != Flow::NEXT) {
+                break;
+            }
+        }
+    }
+
+    void Interpreter::visit(ast::Break &) {
+        flow = Flow::BREAK;
+    }
+
+    void Interpreter::visit(ast::Continue &) {
+        flow = Flow::CONTINUE;
+    }
+
+    void Interpreter::visit(ast::Return &node) {
+        returned = node.exp ? evaluate(*node.exp) : 0;
+        flow = Flow::RETURN;
+    }
+
+    void Interpreter::visit(ast::If &node) {
+        if (evaluate(*node.condition)) {
+            node.then->accept(*this);
+        } else if (node.otherwise) {
+            node.otherwise->accept(*this);
+        }
+    }
+
+    void Interpreter::visit(ast::While &node) {
+        while (evaluate(*node.condition)) {
+            node.body->accept(*this);
+            if (flow == Flow::BREAK) {
+                flow = Flow::NEXT;
+                break;
+            }
+            if (flow == Flow::CONTINUE) {
+                flow = Flow::NEXT;
+            } else if (flow == Flow::RETURN) {
+                break;
+            }
+        }
+    }
+
+    void Interpreter::visit(ast::VarDecl &node) {
+        int initial = node.init_exp ? evaluate(*node.init_exp) : 0;
+        size_t slot = frame + node.id->offset;
+        if (slot >= variables.size()) {
+            variables.resize(slot + 1);
+        }
+        variables[slot] = initial;
+    }
+
+    void Interpreter::visit(ast::Assign &node) {
+        // The checker converted the expression to the type of the variable
+        int assigned = evaluate(*node.exp);
+        variable(*node.id) = assigned;
+    }
+
+    void Interpreter::visit(ast::Formal &) {
+    }
+
+    void Interpreter::visit(ast::Formals &) {
+    }
+
+    void Interpreter::visit(ast::FuncDecl &node) {
+        // The parameters are already bound; the body shares their scope
+        for (auto &statement : node.body->statements) {
+            statement->accept(*this);
+            if (flow != Flow::NEXT) {
+                break;
+            }
+        }
+        // Falling off the end returns 0, like the generated code
+        value = flow == Flow::RETURN ? returned : 0;
+        flow = Flow::NEXT;
+    }
+
+    void Interpreter::visit(ast::Funcs &) {
+        run();
+    }
+
+    static void *runOnThread(void *interpreter) {
+        static_cast<Interpreter *>(interpreter)->run();
+        return nullptr;
+    }
+
+    void check(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer, ast::Funcs &program) {
+        for (const auto &func : program.funcs) {
+            std::vector<ast::BuiltInType> paramTypes;
+            for (const auto &formal : func->formals->formals) {
+                paramTypes.push_back(formal->type->type);
+            }
+            visitor.declareFunction(func->id->value, func->return_type->type, paramTypes, func->id->line);
+        }
+        if (!visitor.hasMain) {
+            output::errorMainMissing();
+        }
+        // Checking a function also generates its code, which is dropped
+        codeBuffer.setMuted(true);
+        for (const auto &func : program.funcs) {
+            func->accept(visitor);
+        }
+    }
+
+    void run(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer, ast::Funcs &program) {
+        check(visitor, codeBuffer, program);
+        Interpreter interpreter(program);
+        pthread_attr_t attributes;
+        pthread_t thread;
+        pthread_attr_init(&attributes);
+        pthread_attr_setstacksize(&attributes, STACK_SIZE);
+        if (pthread_create(&thread, &attributes, runOnThread, &interpreter) == 0) {
+            pthread_join(thread, nullptr);
+        } else {
+            interpreter.run();
+        }
+        pthread_attr_destroy(&attributes);
+    }
+}
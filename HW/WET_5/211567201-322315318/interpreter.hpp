@@ -0,0 +1,124 @@
+#ifndef INTERPRETER_HPP
+#define INTERPRETER_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nodes.hpp"
+#include "output.hpp"
+#include "semantic.hpp"
+
+namespace interpreter {
+
+    /* Executes a checked program by walking its AST. The types are the ones SemanticVisitor left
+     * on the nodes: the type of an expression is the type its value is used at, after the implicit
+     * byte to int widening (and the int to byte conversion of arguments), so every value is
+     * converted to the type of its node once it is computed. Values behave as in the generated
+     * code: ints wrap around at 32 bits, bytes at 8 bits, byte comparisons are the signed icmp of
+     * i8, and division by zero prints the error message and exits with status 1.
+     * Each call has a frame of variables, indexed by the offsets the checker gave them: the
+     * parameters have -1, -2, ... and the locals 0, 1, ..., reused by scopes that do not overlap */
+    class Interpreter : public Visitor {
+    public:
+        explicit Interpreter(ast::Funcs &program);
+
+        // Calls main
+        void run();
+
+        void visit(ast::Num &node) override;
+
+        void visit(ast::NumB &node) override;
+
+        void visit(ast::String &node) override;
+
+        void visit(ast::Bool &node) override;
+
+        void visit(ast::ID &node) override;
+
+        void visit(ast::BinOp &node) override;
+
+        void visit(ast::RelOp &node) override;
+
+        void visit(ast::Not &node) override;
+
+        void visit(ast::And &node) override;
+
+        void visit(ast::Or &node) override;
+
+        void visit(ast::Type &node) override;
+
+        void visit(ast::Cast &node) override;
+
+        void visit(ast::ExpList &node) override;
+
+        void visit(ast::Call &node) override;
+
+        void visit(ast::Statements &node) override;
+
+        void visit(ast::Break &node) override;
+
+        void visit(ast::Continue &node) override;
+
+        void visit(ast::Return &node) override;
+
+        void visit(ast::If &node) override;
+
+        void visit(ast::While &node) override;
+
+        void visit(ast::VarDecl &node) override;
+
+        void visit(ast::Assign &node) override;
+
+        void visit(ast::Formal &node) override;
+
+        void visit(ast::Formals &node) override;
+
+        void visit(ast::FuncDecl &node) override;
+
+        void visit(ast::Funcs &node) override;
+
+    private:
+        /* How the last statement ended */
+        enum class Flow {
+            NEXT,
+            BREAK,
+            CONTINUE,
+            RETURN
+        };
+
+        std::unordered_map<std::string, ast::FuncDecl *> functions;
+        // Bytes printed by each print call site
+        std::unordered_map<const ast::String *, std::string> strings;
+
+        // The frames of all active calls, innermost last. The locals of the running call start at
+        // frame, right after its parameters
+        std::vector<int> variables;
+        size_t frame = 0;
+        // Calls are refused once the stack gets below this address (0 when the stack is unknown)
+        uintptr_t stackLimit = 0;
+
+        // Value of the last expression visited (before the conversion to the type of its node)
+        int value = 0;
+        Flow flow = Flow::NEXT;
+        // Value of the last return statement with an expression
+        int returned = 0;
+
+        int evaluate(ast::Exp &exp);
+
+        int &variable(const ast::ID &id);
+
+        [[noreturn]] void stackOverflow(const ast::Call &call);
+
+        [[noreturn]] void divisionByZero();
+    };
+
+    // Checks the program like SemanticVisitor does when compiling it (reporting the same errors),
+    // without generating code. Leaves the types on the nodes for running the program
+    void check(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer, ast::Funcs &program);
+
+    // Checks the program and runs it
+    void run(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer, ast::Funcs &program);
+}
+
+#endif //INTERPRETER_HPP
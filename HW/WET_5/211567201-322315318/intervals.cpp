@@ -0,0 +1,454 @@
+#include "intervals.hpp"
+#include <algorithm>
+
+namespace dataflow {
+
+    using ir::BinaryOp;
+    using ir::Condition;
+    using ir::Instruction;
+    using ir::Opcode;
+    using output::Value;
+
+    /* Interval */
+
+    Interval Interval::full(ast::BuiltInType type) {
+        switch (type) {
+            case ast::BuiltInType::BOOL:
+                return of(0, 1);
+            case ast::BuiltInType::BYTE:
+                return of(0, 255);
+            default:
+                return of(INT32_MIN, INT32_MAX);
+        }
+    }
+
+    Interval Interval::join(const Interval &other) const {
+        if (empty()) {
+            return other;
+        }
+        if (other.empty()) {
+            return *this;
+        }
+        return of(std::min(lo, other.lo), std::max(hi, other.hi));
+    }
+
+    Interval Interval::meet(const Interval &other) const {
+        return of(std::max(lo, other.lo), std::min(hi, other.hi));
+    }
+
+    // The values as LLVM's signed operations see them (bytes above 127 and true are negative).
+    // Returns the full signed range if the interval wraps around
+    static Interval signedView(const Interval &interval, ast::BuiltInType type) {
+        if (interval.empty() || type == ast::BuiltInType::INT) {
+            return interval;
+        }
+        int64_t half = type == ast::BuiltInType::BYTE ? 128 : 1;
+        if (interval.hi < half) {
+            return interval;
+        }
+        if (interval.lo >= half) {
+            return Interval::of(interval.lo - 2 * half, interval.hi - 2 * half);
+        }
+        return Interval::of(-half, half - 1);
+    }
+
+    // The signed interval back in the representation of the type
+    static Interval unsignedView(const Interval &interval, ast::BuiltInType type) {
+        if (interval.empty() || type == ast::BuiltInType::INT) {
+            return interval;
+        }
+        int64_t half = type == ast::BuiltInType::BYTE ? 128 : 1;
+        if (interval.lo >= 0) {
+            return interval;
+        }
+        if (interval.hi < 0) {
+            return Interval::of(interval.lo + 2 * half, interval.hi + 2 * half);
+        }
+        return Interval::full(type);
+    }
+
+    // Smallest interval holding a / b for a in dividend and b in divisor, divisor not containing 0
+    static Interval divide(const Interval &dividend, const Interval &divisor) {
+        if (dividend.empty() || divisor.empty()) {
+            return Interval();
+        }
+        int64_t corners[] = {dividend.lo / divisor.lo, dividend.lo / divisor.hi,
+                             dividend.hi / divisor.lo, dividend.hi / divisor.hi};
+        return Interval::of(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+    }
+
+    // Exact (unwrapped) result of the operation
+    static Interval arithmetic(BinaryOp op, ast::BuiltInType type, const Interval &a, const Interval &b) {
+        if (a.empty() || b.empty()) {
+            return Interval();
+        }
+        switch (op) {
+            case BinaryOp::ADD:
+                return Interval::of(a.lo + b.lo, a.hi + b.hi);
+            case BinaryOp::SUB:
+                return Interval::of(a.lo - b.hi, a.hi - b.lo);
+            case BinaryOp::MUL: {
+                int64_t corners[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+                return Interval::of(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+            }
+            case BinaryOp::SDIV:
+                // Only ints are divided signed. The division only happens for a divisor other than 0
+                // (the check before it exits)
+                return divide(a, b.meet(Interval::of(b.lo, -1))).join(divide(a, b.meet(Interval::of(1, b.hi))));
+            case BinaryOp::UDIV:
+                return divide(a, b.meet(Interval::of(1, b.hi)));
+            default:
+                if (a.isConstant() && b.isConstant()) {
+                    int64_t value = op == BinaryOp::AND ? (a.lo & b.lo) : op == BinaryOp::OR ? (a.lo | b.lo) : (a.lo ^ b.lo);
+                    return Interval::of(value, value).meet(Interval::full(type));
+                }
+                return Interval::full(type);
+        }
+    }
+
+    // Interval of the i1 result of the compare
+    static Interval compare(Condition condition, ast::BuiltInType type, const Interval &lhs, const Interval &rhs) {
+        if (lhs.empty() || rhs.empty()) {
+            return Interval();
+        }
+        Interval a = signedView(lhs, type);
+        Interval b = signedView(rhs, type);
+        bool always;
+        bool never;
+        switch (condition) {
+            case Condition::EQ:
+                always = a.isConstant() && b.isConstant() && a.lo == b.lo;
+                never = a.meet(b).empty();
+                break;
+            case Condition::NE:
+                always = a.meet(b).empty();
+                never = a.isConstant() && b.isConstant() && a.lo == b.lo;
+                break;
+            case Condition::SLT:
+                always = a.hi < b.lo;
+                never = a.lo >= b.hi;
+                break;
+            case Condition::SLE:
+                always = a.hi <= b.lo;
+                never = a.lo > b.hi;
+                break;
+            case Condition::SGT:
+                always = a.lo > b.hi;
+                never = a.hi <= b.lo;
+                break;
+            default:
+                always = a.lo >= b.hi;
+                never = a.hi < b.lo;
+                break;
+        }
+        return Interval::of(always ? 1 : 0, never ? 0 : 1);
+    }
+
+    static Condition negate(Condition condition) {
+        switch (condition) {
+            case Condition::EQ:
+                return Condition::NE;
+            case Condition::NE:
+                return Condition::EQ;
+            case Condition::SLT:
+                return Condition::SGE;
+            case Condition::SLE:
+                return Condition::SGT;
+            case Condition::SGT:
+                return Condition::SLE;
+            default:
+                return Condition::SLT;
+        }
+    }
+
+    // Narrows the operands (in the signed view) to the values for which lhs condition rhs holds
+    static void refine(Condition condition, Interval &lhs, Interval &rhs) {
+        switch (condition) {
+            case Condition::EQ:
+                lhs = rhs = lhs.meet(rhs);
+                break;
+            case Condition::NE:
+                if (rhs.isConstant()) {
+                    lhs = Interval::of(lhs.lo + (lhs.lo == rhs.lo), lhs.hi - (lhs.hi == rhs.lo));
+                }
+                if (lhs.isConstant()) {
+                    rhs = Interval::of(rhs.lo + (rhs.lo == lhs.lo), rhs.hi - (rhs.hi == lhs.lo));
+                }
+                break;
+            case Condition::SLT:
+                lhs = lhs.meet(Interval::of(lhs.lo, rhs.hi - 1));
+                rhs = rhs.meet(Interval::of(lhs.lo + 1, rhs.hi));
+                break;
+            case Condition::SLE:
+                lhs = lhs.meet(Interval::of(lhs.lo, rhs.hi));
+                rhs = rhs.meet(Interval::of(lhs.lo, rhs.hi));
+                break;
+            case Condition::SGT:
+                refine(Condition::SLT, rhs, lhs);
+                break;
+            default:
+                refine(Condition::SLE, rhs, lhs);
+                break;
+        }
+    }
+
+    /* IntervalAnalysis */
+
+    IntervalAnalysis::IntervalAnalysis(const ir::Function &function, const CFG &cfg) : function(function) {
+        for (const auto &inst : function.blocks.front().instructions) {
+            if (inst.opcode == Opcode::ALLOCA) {
+                slotOf.emplace(inst.dst.id, slotTypes.size());
+                slotTypes.push_back(inst.type);
+            }
+        }
+
+        std::unordered_map<int, size_t> blockOf;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            blockOf[function.blocks[i].label.id] = i;
+        }
+        guards.resize(function.blocks.size());
+        for (size_t b = 0; b < function.blocks.size(); ++b) {
+            const auto &insts = function.blocks[b].instructions;
+            if (insts.empty() || insts.back().opcode != Opcode::COND_BR) {
+                continue;
+            }
+            const Instruction &branch = insts.back();
+            Guard &guard = guards[b];
+            guard.trueBlock = blockOf.at(branch.target.id);
+            guard.falseBlock = blockOf.at(branch.otherTarget.id);
+
+            // Registers of the block that hold a variable, up to the branch
+            std::unordered_map<int, int> loadedFrom;
+            const Instruction *compareInst = nullptr;
+            for (const auto &inst : insts) {
+                if (inst.opcode == Opcode::LOAD && slot(inst.lhs) >= 0) {
+                    loadedFrom[inst.dst.id] = slot(inst.lhs);
+                } else if (inst.opcode == Opcode::STORE) {
+                    for (auto loaded = loadedFrom.begin(); loaded != loadedFrom.end();) {
+                        loaded = loaded->second == slot(inst.rhs) ? loadedFrom.erase(loaded) : std::next(loaded);
+                    }
+                } else if (inst.opcode == Opcode::COMPARE && inst.dst == branch.lhs) {
+                    compareInst = &inst;
+                }
+            }
+            if (compareInst == nullptr) {
+                continue;
+            }
+            guard.present = true;
+            guard.condition = compareInst->condition;
+            guard.type = compareInst->type;
+            auto slotOfOperand = [&](Value operand) {
+                auto found = operand.kind == Value::Kind::TEMP ? loadedFrom.find(operand.id) : loadedFrom.end();
+                return found == loadedFrom.end() ? -1 : found->second;
+            };
+            guard.lhsSlot = slotOfOperand(compareInst->lhs);
+            guard.rhsSlot = slotOfOperand(compareInst->rhs);
+        }
+
+        // The loop closed by each back edge: the blocks that reach its source without going through the head
+        std::vector<size_t> rank(cfg.size(), SIZE_MAX);
+        for (size_t i = 0; i < cfg.order.size(); ++i) {
+            rank[cfg.order[i]] = i;
+        }
+        for (size_t head : cfg.order) {
+            for (size_t source : cfg.predecessors[head]) {
+                if (rank[source] == SIZE_MAX || rank[source] < rank[head]) {
+                    continue;
+                }
+                std::vector<bool> &stores = loopStores[head];
+                stores.resize(slotTypes.size(), false);
+                std::vector<bool> inLoop(cfg.size(), false);
+                std::vector<size_t> worklist = {source};
+                inLoop[head] = inLoop[source] = true;
+                while (!worklist.empty()) {
+                    size_t block = worklist.back();
+                    worklist.pop_back();
+                    for (const auto &inst : function.blocks[block].instructions) {
+                        if (inst.opcode == Opcode::STORE && slot(inst.rhs) >= 0) {
+                            stores[slot(inst.rhs)] = true;
+                        }
+                    }
+                    for (size_t predecessor : cfg.predecessors[block]) {
+                        if (!inLoop[predecessor] && rank[predecessor] != SIZE_MAX) {
+                            inLoop[predecessor] = true;
+                            worklist.push_back(predecessor);
+                        }
+                    }
+                }
+                for (const auto &inst : function.blocks[head].instructions) {
+                    if (inst.opcode == Opcode::STORE && slot(inst.rhs) >= 0) {
+                        stores[slot(inst.rhs)] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    int IntervalAnalysis::slot(Value pointer) const {
+        auto found = pointer.kind == Value::Kind::TEMP ? slotOf.find(pointer.id) : slotOf.end();
+        return found == slotOf.end() ? -1 : (int) found->second;
+    }
+
+    IntervalAnalysis::Fact IntervalAnalysis::bottom() const {
+        State state;
+        state.slots.resize(slotTypes.size());
+        return state;
+    }
+
+    IntervalAnalysis::Fact IntervalAnalysis::boundary() const {
+        State state;
+        state.reachable = true;
+        for (auto type : slotTypes) {
+            state.slots.push_back(Interval::full(type));
+        }
+        return state;
+    }
+
+    bool IntervalAnalysis::join(Fact &into, const Fact &from) const {
+        if (!from.reachable) {
+            return false;
+        }
+        if (!into.reachable) {
+            into = from;
+            return true;
+        }
+        bool changed = false;
+        for (size_t i = 0; i < into.slots.size(); ++i) {
+            Interval joined = into.slots[i].join(from.slots[i]);
+            changed |= joined != into.slots[i];
+            into.slots[i] = joined;
+        }
+        return changed;
+    }
+
+    void IntervalAnalysis::widen(size_t block, const Fact &previous, Fact &next) const {
+        // previous |_| next, with every bound that moved pushed to the bound of the type
+        if (!previous.reachable) {
+            return;
+        }
+        if (!next.reachable) {
+            next = previous;
+            return;
+        }
+        auto stores = loopStores.find(block);
+        for (size_t i = 0; i < next.slots.size(); ++i) {
+            const Interval &old = previous.slots[i];
+            Interval &current = next.slots[i];
+            if (stores != loopStores.end() && !stores->second[i]) {
+                continue;
+            }
+            if (old.empty() || current.empty()) {
+                current = current.join(old);
+                continue;
+            }
+            Interval bounds = Interval::full(slotTypes[i]);
+            current = Interval::of(current.lo < old.lo ? bounds.lo : old.lo, current.hi > old.hi ? bounds.hi : old.hi);
+        }
+    }
+
+    void IntervalAnalysis::edge(size_t from, size_t to, Fact &fact) const {
+        Interval condition = fact.condition;
+        Interval lhs = fact.guardLhs;
+        Interval rhs = fact.guardRhs;
+        fact.condition = fact.guardLhs = fact.guardRhs = Interval();
+
+        const Guard &guard = guards[from];
+        if (!fact.reachable || !guard.present || guard.trueBlock == guard.falseBlock) {
+            return;
+        }
+        bool taken = to == guard.trueBlock;
+        if (condition.empty() || !condition.contains(taken ? 1 : 0)) {
+            fact = bottom();
+            return;
+        }
+
+        Interval a = signedView(lhs, guard.type);
+        Interval b = signedView(rhs, guard.type);
+        refine(taken ? guard.condition : negate(guard.condition), a, b);
+        if (a.empty() || b.empty()) {
+            fact = bottom();
+            return;
+        }
+        if (guard.lhsSlot >= 0) {
+            fact.slots[guard.lhsSlot] = fact.slots[guard.lhsSlot].meet(unsignedView(a, guard.type));
+        }
+        if (guard.rhsSlot >= 0) {
+            fact.slots[guard.rhsSlot] = fact.slots[guard.rhsSlot].meet(unsignedView(b, guard.type));
+        }
+    }
+
+    void IntervalAnalysis::transfer(size_t block, Fact &fact) const {
+        run(block, fact, nullptr);
+    }
+
+    void IntervalAnalysis::evaluate(size_t block, const Fact &in, const Visitor &visit) const {
+        Fact fact = in;
+        run(block, fact, &visit);
+    }
+
+    void IntervalAnalysis::run(size_t block, Fact &fact, const Visitor *visit) const {
+        fact.condition = fact.guardLhs = fact.guardRhs = Interval();
+        if (!fact.reachable) {
+            return;
+        }
+        std::unordered_map<int, Interval> registers;
+        auto valueOf = [&](Value value, ast::BuiltInType type) {
+            if (value.isConst()) {
+                return Interval::of(value.id, value.id);
+            }
+            auto found = value.kind == Value::Kind::TEMP ? registers.find(value.id) : registers.end();
+            return found == registers.end() ? Interval::full(type) : found->second;
+        };
+
+        for (const auto &inst : function.blocks[block].instructions) {
+            Interval result;
+            bool overflows = false;
+            switch (inst.opcode) {
+                case Opcode::BINARY: {
+                    Interval exact = arithmetic(inst.binaryOp, inst.type, valueOf(inst.lhs, inst.type), valueOf(inst.rhs, inst.type));
+                    Interval range = Interval::full(inst.type);
+                    overflows = !exact.empty() && exact.meet(range).empty();
+                    result = exact.within(range) ? exact : range;
+                    break;
+                }
+                case Opcode::COMPARE:
+                    result = compare(inst.condition, inst.type, valueOf(inst.lhs, inst.type), valueOf(inst.rhs, inst.type));
+                    if (guards[block].present && inst.dst == function.blocks[block].instructions.back().lhs) {
+                        fact.condition = result;
+                        fact.guardLhs = valueOf(inst.lhs, inst.type);
+                        fact.guardRhs = valueOf(inst.rhs, inst.type);
+                    }
+                    break;
+                case Opcode::CAST: {
+                    Interval value = valueOf(inst.lhs, inst.type);
+                    if (inst.castOp == ir::CastOp::SEXT) {
+                        value = signedView(value, inst.type);
+                    }
+                    Interval range = Interval::full(inst.resultType);
+                    result = value.within(range) ? value : range;
+                    break;
+                }
+                case Opcode::LOAD:
+                    result = slot(inst.lhs) >= 0 ? fact.slots[slot(inst.lhs)] : Interval::full(inst.type);
+                    break;
+                case Opcode::STORE:
+                    if (slot(inst.rhs) >= 0) {
+                        fact.slots[slot(inst.rhs)] = valueOf(inst.lhs, inst.type);
+                    }
+                    break;
+                case Opcode::CALL:
+                case Opcode::PHI:
+                    result = Interval::full(inst.type);
+                    break;
+                default:
+                    break;
+            }
+            if (inst.dst.kind == Value::Kind::TEMP) {
+                registers[inst.dst.id] = result;
+            }
+            if (visit != nullptr) {
+                (*visit)(inst, result, overflows);
+            }
+        }
+    }
+}
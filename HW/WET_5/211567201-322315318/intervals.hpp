@@ -0,0 +1,142 @@
+#ifndef INTERVALS_HPP
+#define INTERVALS_HPP
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "dataflow.hpp"
+
+namespace dataflow {
+
+    /* The integer values [lo, hi]; empty when lo > hi. Values are kept the way constants are:
+     * ints signed, bytes 0..255 and booleans 0 or 1 */
+    struct Interval {
+        int64_t lo = 1;
+        int64_t hi = 0;
+
+        static Interval of(int64_t lo, int64_t hi) {
+            Interval interval;
+            interval.lo = lo;
+            interval.hi = hi;
+            return interval;
+        }
+
+        // Every value of the type
+        static Interval full(ast::BuiltInType type);
+
+        bool empty() const {
+            return lo > hi;
+        }
+
+        bool isConstant() const {
+            return lo == hi;
+        }
+
+        bool contains(int64_t value) const {
+            return lo <= value && value <= hi;
+        }
+
+        bool within(const Interval &other) const {
+            return empty() || (other.lo <= lo && hi <= other.hi);
+        }
+
+        Interval join(const Interval &other) const;
+
+        Interval meet(const Interval &other) const;
+
+        bool operator==(const Interval &other) const {
+            return (empty() && other.empty()) || (lo == other.lo && hi == other.hi);
+        }
+
+        bool operator!=(const Interval &other) const {
+            return !(*this == other);
+        }
+    };
+
+    /* Abstract interpretation of a function over intervals. The state tracks the value of every
+     * variable (alloca); registers are evaluated inside a block from the state at its start, and
+     * registers used outside their block are taken as unknown. Conditional branches on a compare of
+     * loaded variables refine the variables along each edge, and branches decided by the intervals
+     * make the other edge unreachable. Loops are widened at their head to the bounds of the type
+     * and then narrowed by NARROWING_PASSES plain iterations. Loops are found as in the solver: an
+     * edge to a block that does not come later in reverse postorder closes a loop.
+     */
+    class IntervalAnalysis {
+    public:
+        struct State {
+            // False for code that cannot be reached (the bottom element)
+            bool reachable = false;
+            // Value of each variable, by dense slot number
+            std::vector<Interval> slots;
+            // At the end of a block ending with a conditional branch: the branch condition and the
+            // operands of the compare computing it, used to refine the outgoing edges
+            Interval condition;
+            Interval guardLhs;
+            Interval guardRhs;
+
+            bool operator==(const State &other) const {
+                return reachable == other.reachable && slots == other.slots && condition == other.condition
+                       && guardLhs == other.guardLhs && guardRhs == other.guardRhs;
+            }
+
+            bool operator!=(const State &other) const {
+                return !(*this == other);
+            }
+        };
+
+        using Fact = State;
+        static const Direction direction = Direction::FORWARD;
+        static const int NARROWING_PASSES = 2;
+
+        IntervalAnalysis(const ir::Function &function, const CFG &cfg);
+
+        Fact bottom() const;
+
+        // Every variable may hold any value of its type on entry
+        Fact boundary() const;
+
+        bool join(Fact &into, const Fact &from) const;
+
+        void transfer(size_t block, Fact &fact) const;
+
+        void edge(size_t from, size_t to, Fact &fact) const;
+
+        // Only the variables the loop stores to are widened: the others change only when the code
+        // around the loop does, which keeps the bounds that loop established
+        void widen(size_t block, const Fact &previous, Fact &next) const;
+
+        // Called for each instruction with the interval of its result. overflows is set for
+        // arithmetic whose exact result is out of the range of its type for all inputs
+        using Visitor = std::function<void(const ir::Instruction &inst, const Interval &result, bool overflows)>;
+
+        // Replays the block from the state at its start
+        void evaluate(size_t block, const Fact &in, const Visitor &visit) const;
+
+    private:
+        /* A conditional branch on a compare of (possibly) loaded variables */
+        struct Guard {
+            bool present = false;
+            ir::Condition condition = ir::Condition::EQ;
+            ast::BuiltInType type = ast::BuiltInType::INT;
+            // Variable each operand was loaded from (and not stored to since), or -1
+            int lhsSlot = -1;
+            int rhsSlot = -1;
+            size_t trueBlock = 0;
+            size_t falseBlock = 0;
+        };
+
+        const ir::Function &function;
+        std::unordered_map<int, size_t> slotOf;
+        std::vector<ast::BuiltInType> slotTypes;
+        std::vector<Guard> guards;
+        // Variables stored to in the loop, by loop head
+        std::unordered_map<size_t, std::vector<bool>> loopStores;
+
+        int slot(output::Value pointer) const;
+
+        void run(size_t block, Fact &fact, const Visitor *visit) const;
+    };
+}
+
+#endif //INTERVALS_HPP
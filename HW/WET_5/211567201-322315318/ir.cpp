@@ -0,0 +1,200 @@
+#include "ir.hpp"
+#include "output.hpp"
+#include <deque>
+#include <unordered_map>
+
+namespace ir {
+
+    const char *mnemonic(BinaryOp op) {
+        switch (op) {
+            case BinaryOp::ADD:
+                return "add";
+            case BinaryOp::SUB:
+                return "sub";
+            case BinaryOp::MUL:
+                return "mul";
+            case BinaryOp::SDIV:
+                return "sdiv";
+            case BinaryOp::UDIV:
+                return "udiv";
+            case BinaryOp::AND:
+                return "and";
+            case BinaryOp::OR:
+                return "or";
+            default:
+                return "xor";
+        }
+    }
+
+    static const char *predicate(Condition cond) {
+        switch (cond) {
+            case Condition::EQ:
+                return "eq";
+            case Condition::NE:
+                return "ne";
+            case Condition::SLT:
+                return "slt";
+            case Condition::SLE:
+                return "sle";
+            case Condition::SGT:
+                return "sgt";
+            default:
+                return "sge";
+        }
+    }
+
+    static const char *opcode(CastOp op) {
+        switch (op) {
+            case CastOp::ZEXT:
+                return "zext";
+            case CastOp::SEXT:
+                return "sext";
+            default:
+                return "trunc";
+        }
+    }
+
+    // Names by id (a deque, so that the keys of functionIds keep pointing at them), and ids by name
+    static std::deque<std::string> functionNames;
+    static std::unordered_map<std::string_view, int> functionIds;
+
+    int functionId(std::string_view name) {
+        auto found = functionIds.find(name);
+        if (found != functionIds.end()) {
+            return found->second;
+        }
+        functionNames.emplace_back(name);
+        functionIds.emplace(functionNames.back(), int(functionNames.size()) - 1);
+        return int(functionNames.size()) - 1;
+    }
+
+    const std::string &functionName(int id) {
+        return functionNames[id];
+    }
+
+    void PassManager::add(const std::string &name, const Pass &pass) {
+        passes.emplace_back(name, pass);
+    }
+
+    void PassManager::addModulePass(const std::string &name, const ModulePass &pass) {
+        modulePasses.emplace_back(name, pass);
+    }
+
+    void PassManager::run(Function &function) const {
+        for (const auto &pass : passes) {
+            pass.second(function);
+        }
+    }
+
+    void PassManager::run(std::vector<Function> &functions) const {
+        for (const auto &pass : modulePasses) {
+            pass.second(functions);
+        }
+    }
+
+    static void print(const Instruction &inst, output::CodeBuffer &out, PrintLowering lowering) {
+        switch (inst.opcode) {
+            case Opcode::BINARY:
+                out << inst.dst << " = " << mnemonic(inst.binaryOp) << ' ' << inst.type << ' ' << inst.lhs << ", "
+                    << inst.rhs;
+                break;
+            case Opcode::COMPARE:
+                out << inst.dst << " = icmp " << predicate(inst.condition) << ' ' << inst.type << ' ' << inst.lhs
+                    << ", " << inst.rhs;
+                break;
+            case Opcode::CAST:
+                out << inst.dst << " = " << opcode(inst.castOp) << ' ' << inst.type << ' ' << inst.lhs << " to "
+                    << inst.resultType;
+                break;
+            case Opcode::PHI:
+                out << inst.dst << " = phi " << inst.type;
+                for (size_t i = 0; i < inst.args.size(); ++i) {
+                    out << (i != 0 ? ", [ " : " [ ") << inst.args[i].value << ", " << inst.incoming[i] << " ]";
+                }
+                break;
+            case Opcode::ALLOCA:
+                out << inst.dst << " = alloca " << inst.type;
+                break;
+            case Opcode::LOAD:
+                out << inst.dst << " = load " << inst.type << ", " << inst.type << "* " << inst.lhs;
+                break;
+            case Opcode::STORE:
+                out << "store " << inst.type << ' ' << inst.lhs << ", " << inst.type << "* " << inst.rhs;
+                break;
+            case Opcode::CALL:
+                if (inst.type != ast::BuiltInType::VOID) {
+                    out << inst.dst << " = ";
+                }
+                if (inst.tailCall == TailCall::TAIL) {
+                    out << "tail ";
+                } else if (inst.tailCall == TailCall::MUSTTAIL) {
+                    out << "musttail ";
+                }
+                out << "call " << inst.type << " @" << functionName(inst.callee) << '(';
+                for (size_t i = 0; i < inst.args.size(); ++i) {
+                    if (i != 0) {
+                        out << ", ";
+                    }
+                    out << inst.args[i].type << ' ' << inst.args[i].value;
+                }
+                out << ')';
+                break;
+            case Opcode::PRINT_STRING:
+                if (lowering == PrintLowering::CALL) {
+                    out << "call void @print(i8* getelementptr inbounds ([" << inst.size << " x i8], [" << inst.size
+                        << " x i8]* @.str" << inst.index << ", i32 0, i32 0))";
+                    break;
+                }
+                out << "call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str_specifier, i32 0, i32 0), "
+                    << "i8* getelementptr inbounds ([" << inst.size << " x i8], [" << inst.size << " x i8]* @.str"
+                    << inst.index << ", i32 0, i32 0))";
+                break;
+            case Opcode::PRINT_INT:
+                if (lowering == PrintLowering::CALL) {
+                    out << "call void @printi(i32 " << inst.lhs << ')';
+                    break;
+                }
+                out << "call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.int_specifier, i32 0, i32 0), i32 "
+                    << inst.lhs << ')';
+                break;
+            case Opcode::DIV_ZERO_ERROR:
+                out << "call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([24 x i8], [24 x i8]* @.div_zero_msg, i32 0, i32 0))\n"
+                    << "call void @exit(i32 1)\n"
+                    << "unreachable";
+                break;
+            case Opcode::BR:
+                out << "br label " << inst.target;
+                break;
+            case Opcode::COND_BR:
+                out << "br i1 " << inst.lhs << ", label " << inst.target << ", label " << inst.otherTarget;
+                break;
+            case Opcode::RET:
+                out << "ret " << inst.type;
+                if (inst.type != ast::BuiltInType::VOID) {
+                    out << ' ' << inst.lhs;
+                }
+                break;
+        }
+        out << '\n';
+    }
+
+    void print(const Function &function, output::CodeBuffer &out, PrintLowering lowering) {
+        out << "define " << function.returnType << " @" << function.name << '(';
+        for (size_t i = 0; i < function.paramTypes.size(); ++i) {
+            if (i != 0) {
+                out << ", ";
+            }
+            out << function.paramTypes[i] << ' ' << output::Value::arg(i);
+        }
+        out << ") {\n";
+        for (const auto &block : function.blocks) {
+            if (block.label.id >= 0) {
+                out << "label_" << block.label.id << ":\n";
+            }
+            for (const auto &inst : block.instructions) {
+                print(inst, out, lowering);
+            }
+        }
+        out << "}\n";
+    }
+}
@@ -0,0 +1,206 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "nodes.hpp"
+#include "value.hpp"
+
+namespace output {
+    class CodeBuffer;
+}
+
+namespace ir {
+
+    /* Instruction operators */
+
+    enum class BinaryOp {
+        ADD,
+        SUB,
+        MUL,
+        SDIV,
+        UDIV,
+        AND,
+        OR,
+        XOR
+    };
+
+    enum class Condition {
+        EQ,
+        NE,
+        SLT,
+        SLE,
+        SGT,
+        SGE
+    };
+
+    enum class CastOp {
+        ZEXT,
+        SEXT,
+        TRUNC
+    };
+
+    // LLVM mnemonic of the operator ("add", "sdiv", ...)
+    const char *mnemonic(BinaryOp op);
+
+    /* How a call is marked for LLVM's tail call optimization */
+    enum class TailCall : uint8_t {
+        NONE,
+        TAIL,     // "tail call": may reuse the caller's frame
+        MUSTTAIL  // "musttail call": must; only allowed right before a ret of its result, with the
+                  // same prototype as the caller
+    };
+
+    /* Function names are interned: a call names its callee by an index into a table shared by the
+     * whole program, so that instructions do not carry strings */
+
+    // Index of the name, added to the table on first use
+    int functionId(std::string_view name);
+
+    const std::string &functionName(int id);
+
+    /* A typed call argument */
+    struct Arg {
+        ast::BuiltInType type;
+        output::Value value;
+    };
+
+    enum class Opcode : uint8_t {
+        BINARY,         // dst = binaryOp type lhs, rhs
+        COMPARE,        // dst = icmp condition type lhs, rhs
+        CAST,           // dst = castOp type lhs to resultType
+        PHI,            // dst = phi type [args[i].value, incoming[i]]... (only at the start of a block)
+        ALLOCA,         // dst = alloca type
+        LOAD,           // dst = load type, type* lhs
+        STORE,          // store type lhs, type* rhs
+        CALL,           // [dst =] [tail] call type @callee(args)
+        PRINT_STRING,   // printf of the string constant @.str<index>, size bytes long
+        PRINT_INT,      // printf of the int lhs
+        DIV_ZERO_ERROR, // prints the division by zero message and exits (a terminator)
+        BR,             // br label target
+        COND_BR,        // br i1 lhs, label target, label otherTarget
+        RET             // ret type [lhs]
+    };
+
+    /* A single instruction. Which fields are meaningful depends on the opcode (see above) */
+    struct Instruction {
+        Opcode opcode;
+        BinaryOp binaryOp = BinaryOp::ADD;
+        Condition condition = Condition::EQ;
+        CastOp castOp = CastOp::ZEXT;
+        TailCall tailCall = TailCall::NONE;
+        ast::BuiltInType type = ast::BuiltInType::VOID;
+        ast::BuiltInType resultType = ast::BuiltInType::VOID;
+        output::Value dst;
+        output::Value lhs;
+        output::Value rhs;
+        output::Label target;
+        output::Label otherTarget;
+        int index = 0;
+        int size = 0;
+        // CALL: functionId() of the callee
+        int callee = -1;
+        std::vector<Arg> args;
+        // PHI: the predecessor each of args comes from
+        std::vector<output::Label> incoming;
+        // Source line of the expression it was generated for, or 0
+        int line = 0;
+
+        explicit Instruction(Opcode opcode) : opcode(opcode) {}
+
+        bool isTerminator() const {
+            return opcode == Opcode::BR || opcode == Opcode::COND_BR || opcode == Opcode::RET
+                   || opcode == Opcode::DIV_ZERO_ERROR;
+        }
+    };
+
+    // Calls f on every operand the instruction reads (unused operand slots are Kind::NONE)
+    template<typename F>
+    void forEachUse(Instruction &inst, F f) {
+        f(inst.lhs);
+        f(inst.rhs);
+        for (auto &arg : inst.args) {
+            f(arg.value);
+        }
+    }
+
+    template<typename F>
+    void forEachUse(const Instruction &inst, F f) {
+        f(inst.lhs);
+        f(inst.rhs);
+        for (const auto &arg : inst.args) {
+            f(arg.value);
+        }
+    }
+
+    /* A straight-line sequence of instructions ending in a terminator */
+    struct BasicBlock {
+        // Unset (id -1) for the entry block, which is never branched to, unless a PHI names it
+        output::Label label;
+        std::vector<Instruction> instructions;
+
+        bool terminated() const {
+            return !instructions.empty() && instructions.back().isTerminator();
+        }
+    };
+
+    struct Function {
+        std::string name;
+        // functionId(name)
+        int id = -1;
+        ast::BuiltInType returnType = ast::BuiltInType::VOID;
+        // Parameter i is output::Value::arg(i)
+        std::vector<ast::BuiltInType> paramTypes;
+        // blocks[0] is the entry block; all allocas are at its start
+        std::vector<BasicBlock> blocks;
+    };
+
+    /* Runs a list of function passes, in the order they were added, over each function
+     * between code generation and printing. Module passes see all the functions printed together
+     * (see CodeBuffer::flush()), after their function passes have run */
+    class PassManager {
+    public:
+        using Pass = std::function<void(Function &)>;
+        using ModulePass = std::function<void(std::vector<Function> &)>;
+
+        void add(const std::string &name, const Pass &pass);
+
+        void addModulePass(const std::string &name, const ModulePass &pass);
+
+        void run(Function &function) const;
+
+        void run(std::vector<Function> &functions) const;
+
+        bool empty() const {
+            return passes.empty() && modulePasses.empty();
+        }
+
+        bool hasModulePasses() const {
+            return !modulePasses.empty();
+        }
+
+    private:
+        std::vector<std::pair<std::string, Pass>> passes;
+        std::vector<std::pair<std::string, ModulePass>> modulePasses;
+    };
+
+    /* How PRINT_STRING and PRINT_INT are written out */
+    enum class PrintLowering {
+        PRINTF, // a printf call with the format specifier, at each site
+        CALL    // call void @print(i8*) / @printi(i32), which the module defines or links in
+    };
+
+    // LLVM spelling of each FanC type, indexed by BuiltInType
+    constexpr std::string_view LLVM_TYPES[] = {"void", "i1", "i8", "i32", "i8*"};
+
+    constexpr std::string_view llvmType(ast::BuiltInType type) {
+        return LLVM_TYPES[type];
+    }
+
+    // Writes the function as LLVM text
+    void print(const Function &function, output::CodeBuffer &out, PrintLowering lowering = PrintLowering::PRINTF);
+}
+
+#endif //IR_HPP
@@ -0,0 +1,106 @@
+#include "lazy.hpp"
+#include "lexer.hpp"
+#include "streaming.hpp"
+#include "parser.tab.h"
+#include "timing.hpp"
+#include <unistd.h>
+#include <unordered_map>
+
+namespace lazy {
+
+    using Handler = std::function<void(std::shared_ptr<ast::FuncDecl>)>;
+
+    // Runs a fresh push parser over tokens [begin, end) followed by end of input
+    static void parseRange(std::vector<lexer::Token> &tokens, size_t begin, size_t end, int endLine,
+                           const Handler &handler) {
+        streaming::FuncParser parser(handler);
+        for (size_t i = begin; i < end && parser.push(tokens[i]); ++i) {
+        }
+        parser.finish(endLine);
+    }
+
+    // Marks the functions reachable from main. A call is an ID followed by "(" anywhere in a
+    // body; names that are not functions are ignored
+    static std::vector<bool> reachableFromMain(const std::vector<streaming::Signature> &signatures,
+                                               const std::vector<lexer::Token> &tokens) {
+        std::unordered_map<std::string, size_t> indexOf;
+        for (size_t i = 0; i < signatures.size(); ++i) {
+            indexOf.emplace(signatures[i].name, i);
+        }
+
+        std::vector<bool> reachable(signatures.size(), false);
+        auto entry = indexOf.find("main");
+        if (entry == indexOf.end()) {
+            return reachable;
+        }
+        std::vector<size_t> worklist = {entry->second};
+        reachable[entry->second] = true;
+        while (!worklist.empty()) {
+            const streaming::Signature &caller = signatures[worklist.back()];
+            worklist.pop_back();
+            for (size_t i = caller.begin; i + 1 < caller.end; ++i) {
+                if (tokens[i].kind != ID || tokens[i + 1].kind != LPAREN) {
+                    continue;
+                }
+                auto callee = indexOf.find(dynamic_cast<ast::ID &>(*tokens[i].value).value);
+                if (callee != indexOf.end() && !reachable[callee->second]) {
+                    reachable[callee->second] = true;
+                    worklist.push_back(callee->second);
+                }
+            }
+        }
+        return reachable;
+    }
+
+    void compile(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer, bool checkAll) {
+        timing::Scope parsing(timing::Phase::PARSING);
+        lexer::Chunk input = lexer::takeTokens();
+        std::vector<lexer::Token> &tokens = input.tokens;
+
+        streaming::SignatureScanner scanner;
+        bool wellFormed = input.error == 0;
+        for (size_t i = 0; wellFormed && i < tokens.size(); ++i) {
+            wellFormed = scanner.step(tokens[i]);
+        }
+        if (!wellFormed || !scanner.atTopLevel()) {
+            // The input does not parse; run the parser over all of it, so that it reports the first error
+            streaming::FuncParser parser([](std::shared_ptr<ast::FuncDecl>) {});
+            for (size_t i = 0; i < tokens.size() && parser.push(tokens[i]); ++i) {
+            }
+            lexer::reportError(input);
+            parser.finish(lexer::endLine());
+            return;
+        }
+        const std::vector<streaming::Signature> &signatures = scanner.signatures;
+        std::vector<bool> reachable = reachableFromMain(signatures, tokens);
+
+        // Parse first, so that syntax errors are still reported before semantic ones
+        std::vector<std::shared_ptr<ast::FuncDecl>> funcs(signatures.size());
+        for (size_t i = 0; i < signatures.size(); ++i) {
+            if (reachable[i] || checkAll) {
+                const streaming::Signature &signature = signatures[i];
+                parseRange(tokens, signature.begin, signature.end, tokens[signature.end - 1].line,
+                           [&](std::shared_ptr<ast::FuncDecl> func) { funcs[i] = func; });
+            }
+        }
+        // The ID values are still needed by the call graph scan above, so free them only now
+        std::vector<lexer::Token>().swap(tokens);
+
+        for (const auto &signature : signatures) {
+            visitor.declareFunction(signature.name, signature.returnType, signature.paramTypes, signature.line);
+        }
+        if (!visitor.hasMain) {
+            output::errorMainMissing();
+        }
+
+        timing::Scope checking(timing::Phase::CHECKING);
+        for (size_t i = 0; i < funcs.size(); ++i) {
+            if (funcs[i]) {
+                codeBuffer.setMuted(!reachable[i]);
+                funcs[i]->accept(visitor);
+            }
+        }
+        codeBuffer.setMuted(false);
+        codeBuffer.flush(STDOUT_FILENO);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef LAZY_HPP
+#define LAZY_HPP
+
+#include "output.hpp"
+#include "semantic.hpp"
+
+namespace lazy {
+
+    // Compiles the input read by lexer::readInput() without parsing every function body.
+    // The top level is pre-scanned into signatures and brace-balanced body token ranges, the
+    // call graph is read off the "ID (" pairs in the bodies, and only the functions reachable
+    // from main are parsed, checked and emitted. With checkAll every body is parsed and checked
+    // (so all errors are reported as in the default mode) but unreachable ones are still not emitted
+    void compile(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer, bool checkAll);
+}
+
+#endif //LAZY_HPP
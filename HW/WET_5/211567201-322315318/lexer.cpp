@@ -0,0 +1,176 @@
+#include "lexer.hpp"
+#include "output.hpp"
+#include "parser.tab.h"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <string>
+#include <thread>
+
+// The parser's node arena (see parser.y)
+extern ast::NodeArena parserNodes;
+
+// Line of the token most recently handed to the parser. The reentrant scanner keeps its
+// own line counters, so this is the only global line number (used by Node() and yyerror).
+// Thread-local: the scanner actions build nodes on the lexing threads while the parser sets it
+// on the main thread; their nodes get the token's line afterwards, so their copy is never read
+thread_local int yylineno = 1;
+
+namespace lexer {
+
+    // Inputs smaller than this are lexed on the calling thread as a single chunk
+    static const size_t MIN_CHUNK_SIZE = 1 << 20;
+    // Upper bound on a chunk, so that flex's int-sized buffers are never exceeded
+    static const size_t MAX_CHUNK_SIZE = 64 << 20;
+
+    static std::string source;
+    static int lastLine = 1;
+
+    static std::vector<Chunk> chunks;
+    static size_t currentChunk = 0;
+    static size_t currentToken = 0;
+
+    /* A slice of the source, ending right after a newline or at end of input */
+    struct Slice {
+        size_t begin;
+        size_t end;
+        int firstLine;
+    };
+
+    void readInput(FILE *input) {
+        source.clear();
+        char block[1 << 16];
+        size_t read;
+        while ((read = fread(block, 1, sizeof(block), input)) > 0) {
+            source.append(block, read);
+        }
+        lastLine = 1 + std::count(source.begin(), source.end(), '\n');
+    }
+
+    // Splits the source into slices of about target bytes. Splits happen right after a newline:
+    // neither string literals nor comments can contain one (a comment ends at the newline it
+    // consumes), so every newline is a token boundary
+    static std::vector<Slice> split(size_t target) {
+        std::vector<Slice> slices;
+        size_t begin = 0;
+        int line = 1;
+        while (begin < source.size() || slices.empty()) {
+            size_t end = source.size();
+            if (source.size() - begin > target) {
+                size_t newline = source.find('\n', begin + target);
+                if (newline != std::string::npos) {
+                    end = newline + 1;
+                }
+            }
+            slices.push_back({begin, end, line});
+            line += std::count(source.begin() + begin, source.begin() + end, '\n');
+            begin = end;
+        }
+        return slices;
+    }
+
+    static void lexSlice(const Slice &slice, Chunk &chunk) {
+        lexChunk(source.data() + slice.begin, slice.end - slice.begin, slice.firstLine, chunk);
+    }
+
+    void tokenize() {
+        size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<Slice> slices = split(std::min(std::max(source.size() / workers, MIN_CHUNK_SIZE), MAX_CHUNK_SIZE));
+        size_t count = slices.size();
+
+        chunks.assign(count, Chunk());
+        currentChunk = 0;
+        currentToken = 0;
+
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                lexSlice(slices[i], chunks[i]);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(workers, count); ++i) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    Chunk takeTokens() {
+        Chunk all;
+        size_t total = 0;
+        for (const auto &chunk : chunks) {
+            total += chunk.tokens.size();
+        }
+        all.tokens.reserve(total);
+        for (auto &chunk : chunks) {
+            std::move(chunk.tokens.begin(), chunk.tokens.end(), std::back_inserter(all.tokens));
+            if (chunk.error != 0) {
+                // Nothing after the first lexical error is ever parsed
+                all.error = chunk.error;
+                all.errorLine = chunk.errorLine;
+                all.errorText = chunk.errorText;
+                break;
+            }
+        }
+        chunks.clear();
+        return all;
+    }
+
+    void streamChunks(const std::function<bool(Chunk &)> &consume) {
+        std::vector<Slice> slices = split(MIN_CHUNK_SIZE);
+        Chunk current;
+        lexSlice(slices[0], current);
+        for (size_t i = 0; i < slices.size(); ++i) {
+            // Lex the next slice while the consumer works on this one
+            Chunk ahead;
+            std::thread lookahead;
+            if (i + 1 < slices.size()) {
+                lookahead = std::thread(lexSlice, std::cref(slices[i + 1]), std::ref(ahead));
+            }
+            bool more = consume(current);
+            if (lookahead.joinable()) {
+                lookahead.join();
+            }
+            if (!more) {
+                return;
+            }
+            current = std::move(ahead);
+        }
+    }
+
+    void reportError(const Chunk &chunk) {
+        if (chunk.error == LEX_ERROR) {
+            output::errorLex(chunk.errorLine);
+        } else if (chunk.error == LEX_OVERFLOW) {
+            output::errorNumTooLarge(chunk.errorLine, chunk.errorText);
+        }
+    }
+
+    int endLine() {
+        return lastLine;
+    }
+}
+
+int yylex(int *value) {
+    using namespace lexer;
+    while (currentChunk < chunks.size()) {
+        Chunk &chunk = chunks[currentChunk];
+        if (currentToken < chunk.tokens.size()) {
+            Token &token = chunk.tokens[currentToken++];
+            yylineno = token.line;
+            *value = parserNodes.add(std::move(token.value));
+            return token.kind;
+        }
+        reportError(chunk);
+        // Release the chunk's storage once the parser is done with it
+        std::vector<Token>().swap(chunk.tokens);
+        ++currentChunk;
+        currentToken = 0;
+    }
+    yylineno = lastLine;
+    return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef LEXER_HPP
+#define LEXER_HPP
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "nodes.hpp"
+
+namespace lexer {
+
+    // Pseudo token returned by the scanner on a lexical error. It never reaches the parser:
+    // the error is reported when the parser asks for the token at that position.
+    const int LEX_ERROR = -1;
+    // Pseudo token returned for a number literal that does not fit in an int, reported the same way
+    const int LEX_OVERFLOW = -2;
+
+    /* A single scanned token */
+    struct Token {
+        // Token kind as defined in parser.tab.h
+        int kind;
+        // Line number of the token in the whole input
+        int line;
+        // Semantic value (ID, NUM, NUM_B and STRING only), nullptr otherwise
+        std::shared_ptr<ast::Node> value;
+    };
+
+    /* Tokens of one slice of the input, lexed independently of the other slices */
+    struct Chunk {
+        std::vector<Token> tokens;
+        // Pseudo token (LEX_ERROR or LEX_OVERFLOW) that stopped lexing after the last token, 0 if none
+        int error = 0;
+        int errorLine = 0;
+        // Text matched by the erroneous token
+        std::string errorText;
+    };
+
+    // Scans [begin, begin + size) with a private scanner instance, numbering lines from firstLine.
+    // Safe to call from several threads at once. Defined in scanner.lex
+    void lexChunk(const char *begin, size_t size, int firstLine, Chunk &chunk);
+
+    // Reads the whole input into memory. Must be called before tokenize() or streamChunks()
+    void readInput(FILE *input);
+
+    // Tokenizes the whole input. Large inputs are split at newlines and the resulting chunks
+    // are lexed in parallel; the token streams are then handed to the parser in order through yylex()
+    void tokenize();
+
+    // Moves all the tokens produced by tokenize() into a single chunk (instead of reading them
+    // through yylex()), together with the first lexical error
+    Chunk takeTokens();
+
+    // Lexes the input in small chunks, one chunk ahead of the consumer, and hands them to consume()
+    // in order until it returns false. Only two chunks are alive at a time. Lexical errors are left
+    // in the chunk for the consumer to report
+    void streamChunks(const std::function<bool(Chunk &)> &consume);
+
+    // Reports the lexical error that stopped the chunk, if any (does not return in that case)
+    void reportError(const Chunk &chunk);
+
+    // Line number the scanner reports at end of input
+    int endLine();
+}
+
+// Bison-facing scanner: returns the next token produced by lexer::tokenize. Its value is added to
+// the parser's node arena and *value is its handle
+int yylex(int *value);
+
+#endif //LEXER_HPP
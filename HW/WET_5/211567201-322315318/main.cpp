@@ -2,6 +2,15 @@
 #include "nodes.hpp"
 #//include "codeGenerator.hpp"
 #include "semantic.hpp"
+#include "lexer.hpp"
+#include "streaming.hpp"
+#include "lazy.hpp"
+#include "passes.hpp"
+#include "interpreter.hpp"
+#include "bytecode.hpp"
+#include "timing.hpp"
+#include <cctype>
+#include <cstdlib>
 #include <iostream>
 
 // Extern from the bison-generated parser
@@ -9,15 +18,151 @@ extern int yyparse();
 
 extern std::shared_ptr<ast::Node> program;
 
-int main() {
+// Reports a bad command line argument and exits
+[[noreturn]] static void usageError(const char *program, const std::string &message) {
+    std::cerr << program << ": " << message << "\n"
+              << "usage: " << program << " [--stream | --lazy [--check-all] | --interpret | --vm] [-O] [-Woverflow]\n"
+              << "       [--print=inline|helpers|external] [--target=llvm|x86-64] [--time-report[=N]] < input"
+              << std::endl;
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    bool streamMode = false;
+    bool lazyMode = false;
+    bool checkAll = false;
+    bool optimize = false;
+    bool warnOverflow = false;
+    bool interpretMode = false;
+    bool vmMode = false;
+    output::RuntimeMode runtimeMode = output::RuntimeMode::INLINE_PRINTF;
+    output::Target target = output::Target::LLVM;
+    // Number of functions listed by --time-report, 0 if there is no report
+    size_t timeReport = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--stream") {
+            streamMode = true;
+        } else if (arg == "--lazy") {
+            lazyMode = true;
+        } else if (arg == "--check-all") {
+            checkAll = true;
+        } else if (arg == "--interpret") {
+            interpretMode = true;
+        } else if (arg == "--vm") {
+            vmMode = true;
+        } else if (arg == "-O") {
+            optimize = true;
+        } else if (arg == "-Woverflow") {
+            warnOverflow = true;
+        } else if (arg == "--print=inline") {
+            runtimeMode = output::RuntimeMode::INLINE_PRINTF;
+        } else if (arg == "--print=helpers") {
+            runtimeMode = output::RuntimeMode::HELPERS;
+        } else if (arg == "--print=external") {
+            runtimeMode = output::RuntimeMode::EXTERNAL;
+        } else if (arg == "--target=x86-64") {
+            target = output::Target::X86_64;
+        } else if (arg == "--target=llvm") {
+            target = output::Target::LLVM;
+        } else if (arg == "--time-report") {
+            timeReport = 10;
+        } else if (arg.rfind("--time-report=", 0) == 0) {
+            // The number of functions to list, a positive integer
+            const char *count = argv[i] + std::string("--time-report=").size();
+            char *end;
+            timeReport = std::strtoul(count, &end, 10);
+            if (!std::isdigit((unsigned char) *count) || *end != '\0' || timeReport == 0) {
+                usageError(argv[0], "--time-report needs a positive number of functions, not '" + std::string(count) + "'");
+            }
+        } else {
+            usageError(argv[0], "unknown option '" + arg + "'");
+        }
+    }
+
+    if (timeReport) {
+        timing::enable(timeReport);
+    }
+
+    {
+        timing::Scope lexing(timing::Phase::LEXING);
+        lexer::readInput(stdin);
+    }
+
+    output::CodeBuffer codeBuffer;
+    codeBuffer.setRuntimeMode(runtimeMode);
+    codeBuffer.setTarget(target);
+    // The overflow warnings analyze variables in memory, so they come before the SSA passes of -O
+    if (warnOverflow) {
+        codeBuffer.passes().add("overflow-warnings", ir::warnOverflow);
+    }
+    if (optimize) {
+        // In stream mode functions are printed one by one, so no pass ever sees the whole program
+        ir::addOptimizationPasses(codeBuffer.passes(), !streamMode);
+    }
+    // Recursion in tail position then runs in constant stack space. Tail calls are marked after
+    // every other pass, the module passes included
+    if (codeBuffer.passes().hasModulePasses()) {
+        codeBuffer.passes().addModulePass("tail-calls", [](std::vector<ir::Function> &functions) {
+            for (auto &function : functions) {
+                ir::markTailCalls(function);
+            }
+        });
+    } else {
+        codeBuffer.passes().add("tail-calls", ir::markTailCalls);
+    }
+    SemanticVisitor codeGeneratorVisitor(codeBuffer);
+
+    if (streamMode) {
+        // Pre-scan the signatures, then parse, check and print one function at a time
+        streaming::compile(codeGeneratorVisitor, codeBuffer);
+        return 0;
+    }
+
+    // Tokenize the whole input up front. Large inputs are lexed in parallel chunks
+    {
+        timing::Scope lexing(timing::Phase::LEXING);
+        lexer::tokenize();
+    }
+
+    if (interpretMode) {
+        // Check the program and run it directly instead of printing its code
+        {
+            timing::Scope parsing(timing::Phase::PARSING);
+            yyparse();
+        }
+        interpreter::run(codeGeneratorVisitor, codeBuffer, dynamic_cast<ast::Funcs &>(*program));
+        return 0;
+    }
+
+    if (vmMode) {
+        // Check the program, compile it to bytecode and run that
+        {
+            timing::Scope parsing(timing::Phase::PARSING);
+            yyparse();
+        }
+        ast::Funcs &funcs = dynamic_cast<ast::Funcs &>(*program);
+        interpreter::check(codeGeneratorVisitor, codeBuffer, funcs);
+        bytecode::execute(bytecode::compile(funcs));
+        return 0;
+    }
+
+    if (lazyMode) {
+        // Parse, check and emit only the functions reachable from main
+        lazy::compile(codeGeneratorVisitor, codeBuffer, checkAll);
+        return 0;
+    }
+
     // Parse the input. The result is stored in the global variable `program`
-    yyparse();
+    {
+        timing::Scope parsing(timing::Phase::PARSING);
+        yyparse();
+    }
 
     //SemanticVisitor semanticVisitor;
     //program->accept(semanticVisitor);
 
-    output::CodeBuffer codeBuffer;
-    SemanticVisitor codeGeneratorVisitor(codeBuffer);
+    timing::Scope checking(timing::Phase::CHECKING);
     program->accept(codeGeneratorVisitor);
     //std::cout << codeBuffer;
 }
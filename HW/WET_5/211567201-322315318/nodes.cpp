@@ -2,15 +2,15 @@
 #include <string>
 #include <utility>
 
-extern int yylineno;
+extern thread_local int yylineno;
 
 namespace ast {
 
     Node::Node() : line(yylineno) {}
 
-    Num::Num(const char *str) : Exp(), value(std::stoi(str)) {}
+    Num::Num(int value) : Exp(), value(value) {}
 
-    NumB::NumB(const char *str) : Exp(), value(std::stoi(str)) {}
+    NumB::NumB(int value) : Exp(), value(value) {}
 
     String::String(const char *str) : Exp(), value(str) {
         // Remove the quotes
@@ -42,10 +42,6 @@ namespace ast {
 
     ExpList::ExpList(std::shared_ptr<Exp> exp) : Node(), exps({std::move(exp)}) {}
 
-    void ExpList::push_front(const std::shared_ptr<Exp> &exp) {
-        exps.insert(exps.begin(), exp);
-    }
-
     void ExpList::push_back(const std::shared_ptr<Exp> &exp) {
         exps.push_back(exp);
     }
@@ -58,10 +54,6 @@ namespace ast {
 
     Statements::Statements(std::shared_ptr<Statement> statement) : Statement(), statements({std::move(statement)}) {}
 
-    void Statements::push_front(const std::shared_ptr<Statement> &statement) {
-        statements.insert(statements.begin(), statement);
-    }
-
     void Statements::push_back(const std::shared_ptr<Statement> &statement) {
         statements.push_back(statement);
     }
@@ -86,10 +78,6 @@ namespace ast {
 
     Formals::Formals(std::shared_ptr<Formal> formal) : Node(), formals({std::move(formal)}) {}
 
-    void Formals::push_front(const std::shared_ptr<Formal> &formal) {
-        formals.insert(formals.begin(), formal);
-    }
-
     void Formals::push_back(const std::shared_ptr<Formal> &formal) {
         formals.push_back(formal);
     }
@@ -101,12 +89,22 @@ namespace ast {
 
     Funcs::Funcs(std::shared_ptr<FuncDecl> func) : Node(), funcs({std::move(func)}) {}
 
-    void Funcs::push_front(const std::shared_ptr<FuncDecl> &func) {
-        funcs.insert(funcs.begin(), func);
-    }
-
     void Funcs::push_back(const std::shared_ptr<FuncDecl> &func) {
         funcs.push_back(func);
     }
 
+    int NodeArena::add(std::shared_ptr<Node> node) {
+        if (!node) {
+            return NONE;
+        }
+        if (freeHandles.empty()) {
+            nodes.push_back(std::move(node));
+            return int(nodes.size()) - 1;
+        }
+        int handle = freeHandles.back();
+        freeHandles.pop_back();
+        nodes[handle] = std::move(node);
+        return handle;
+    }
+
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "visitor.hpp"
+#include "value.hpp"
 using namespace std;
 
 namespace ast {
@@ -36,6 +38,13 @@ namespace ast {
         STRING
     };
 
+    // Type names as spelled in error messages, indexed by BuiltInType
+    constexpr std::string_view TYPE_NAMES[] = {"VOID", "BOOL", "BYTE", "INT", "STRING"};
+
+    constexpr std::string_view typeName(BuiltInType type) {
+        return TYPE_NAMES[type];
+    }
+
     /* Base class for all AST nodes */
     class Node {
     public:
@@ -43,7 +52,8 @@ namespace ast {
         int line;
         BuiltInType type;
         std::string idValue;
-        std::string llvmValue;
+        // Register or immediate holding the value of an expression, set during code generation
+        output::Value llvmValue;
         // Use this constructor only while parsing in bison or flex
         Node();
 
@@ -68,8 +78,8 @@ namespace ast {
         // Value of the number
         int value;
 
-        // Constructor that receives a C-style string that represents the number
-        explicit Num(const char *str);
+        // Constructor that receives the value of the number, as computed by the scanner
+        explicit Num(int value);
 
         void accept(Visitor &visitor) override {
             visitor.visit(*this);
@@ -82,8 +92,8 @@ namespace ast {
         // Value of the number
         int value;
 
-        // Constructor that receives a C-style (including b character) string that represents the number
-        explicit NumB(const char *str);
+        // Constructor that receives the value of the number (without the b suffix), as computed by the scanner
+        explicit NumB(int value);
 
         void accept(Visitor &visitor) override {
             visitor.visit(*this);
@@ -123,6 +133,8 @@ namespace ast {
     public:
         // Name of the identifier
         std::string value;
+        // Offset of the variable it names (see Sym), set by the checker
+        int offset = 0;
         //BuiltInType type = BuiltInType::DEFAULT;
 
         // Constructor that receives a C-style string that represents the identifier
@@ -257,9 +269,6 @@ namespace ast {
         // Constructor that receives the first expression
         explicit ExpList(std::shared_ptr<Exp> exp);
 
-        // Method to add an expression at the beginning of the list
-        void push_front(const std::shared_ptr<Exp> &exp);
-
         // Method to add an expression at the end of the list
         void push_back(const std::shared_ptr<Exp> &exp);
 
@@ -299,9 +308,6 @@ namespace ast {
         // Constructor that receives the first statement
         explicit Statements(std::shared_ptr<Statement> statement);
 
-        // Method to add a statement at the beginning of the list
-        void push_front(const std::shared_ptr<Statement> &statement);
-
         // Method to add a statement at the end of the list
         void push_back(const std::shared_ptr<Statement> &statement);
 
@@ -442,9 +448,6 @@ namespace ast {
         // Constructor that receives the first formal parameter
         explicit Formals(std::shared_ptr<Formal> formal);
 
-        // Method to add a formal parameter at the beginning of the list
-        void push_front(const std::shared_ptr<Formal> &formal);
-
         // Method to add a formal parameter at the end of the list
         void push_back(const std::shared_ptr<Formal> &formal);
 
@@ -486,9 +489,6 @@ namespace ast {
         // Constructor that receives the first function declaration
         explicit Funcs(std::shared_ptr<FuncDecl> func);
 
-        // Method to add a function declaration at the beginning of the list
-        void push_front(const std::shared_ptr<FuncDecl> &func);
-
         // Method to add a function declaration at the end of the list
         void push_back(const std::shared_ptr<FuncDecl> &func);
 
@@ -496,8 +496,35 @@ namespace ast {
             visitor.visit(*this);
         }
     };
-}
 
-#define YYSTYPE std::shared_ptr<ast::Node>
+    /* Owner of the nodes on the parser's value stack.
+     * Bison's C parser copies its stacks around bytewise when they grow and never constructs or
+     * destroys their slots, so a slot only holds the handle of a node in this table (YYSTYPE is
+     * int). Actions take their operands out, which frees the entries for the next values: the
+     * table never holds more than the nodes of the stack and the lookahead.
+     */
+    class NodeArena {
+    public:
+        // Handle of tokens that carry no node
+        static const int NONE = -1;
+
+        int add(std::shared_ptr<Node> node);
+
+        // Moves the node out and frees its handle. Returns nullptr for NONE or a node of another type
+        template<typename T>
+        std::shared_ptr<T> take(int handle) {
+            if (handle == NONE) {
+                return nullptr;
+            }
+            std::shared_ptr<Node> node = std::move(nodes[handle]);
+            freeHandles.push_back(handle);
+            return std::dynamic_pointer_cast<T>(node);
+        }
+
+    private:
+        std::vector<std::shared_ptr<Node>> nodes;
+        std::vector<int> freeHandles;
+    };
+}
 
 #endif //NODES_HPP
@@ -1,26 +1,14 @@
 #include "output.hpp"
+#include "timing.hpp"
+#include "x86.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
 #include <iostream>
+#include <sys/uio.h>
 
 namespace output {
-    /* Helper functions */
-
-    static std::string toString(ast::BuiltInType type) {
-        switch (type) {
-            case ast::BuiltInType::INT:
-                return "int";
-            case ast::BuiltInType::BOOL:
-                return "bool";
-            case ast::BuiltInType::BYTE:
-                return "byte";
-            case ast::BuiltInType::VOID:
-                return "void";
-            case ast::BuiltInType::STRING:
-                return "string";
-            default:
-                return "unknown";
-        }
-    }
-
     /* Error handling functions */
 
     void errorLex(int lineno) {
@@ -96,39 +84,439 @@ namespace output {
         exit(0);
     }
 
+    void errorNumTooLarge(int lineno, const std::string &literal) {
+        std::cout << "line " << lineno << ": number " << literal << " out of range" << std::endl;
+        exit(0);
+    }
+
+    /* BlockBuffer class */
+
+    std::vector<BlockBuffer::Block *> BlockBuffer::pool;
+
+    BlockBuffer::~BlockBuffer() {
+        clear();
+    }
+
+    void BlockBuffer::append(const char *data, size_t size) {
+        while (size > 0) {
+            if (blocks.empty() || blocks.back()->used == BLOCK_SIZE) {
+                Block *block;
+                if (pool.empty()) {
+                    block = new Block;
+                } else {
+                    block = pool.back();
+                    pool.pop_back();
+                }
+                block->used = 0;
+                blocks.push_back(block);
+            }
+            Block *block = blocks.back();
+            size_t count = std::min(size, BLOCK_SIZE - block->used);
+            memcpy(block->data + block->used, data, count);
+            block->used += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    void BlockBuffer::append(char c) {
+        append(&c, 1);
+    }
+
+    void BlockBuffer::write(int fd) const {
+        std::vector<struct iovec> parts;
+        parts.reserve(blocks.size());
+        for (const Block *block : blocks) {
+            parts.push_back({const_cast<char *>(block->data), block->used});
+        }
+
+        size_t next = 0;
+        while (next < parts.size()) {
+            ssize_t written = writev(fd, parts.data() + next, std::min<size_t>(parts.size() - next, IOV_MAX));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            // Skip what was written; a short write leaves the rest of a block for the next call
+            while (next < parts.size() && static_cast<size_t>(written) >= parts[next].iov_len) {
+                written -= parts[next].iov_len;
+                ++next;
+            }
+            if (next < parts.size()) {
+                parts[next].iov_base = static_cast<char *>(parts[next].iov_base) + written;
+                parts[next].iov_len -= written;
+            }
+        }
+    }
+
+    void BlockBuffer::write(std::ostream &os) const {
+        for (const Block *block : blocks) {
+            os.write(block->data, block->used);
+        }
+    }
+
+    void BlockBuffer::clear() {
+        pool.insert(pool.end(), blocks.begin(), blocks.end());
+        blocks.clear();
+    }
+
     /* CodeBuffer class */
 
-    CodeBuffer::CodeBuffer() : labelCount(0), varCount(0), stringCount(0),argCount(0) {}
+    CodeBuffer::CodeBuffer() : muted(false), labelCount(0), varCount(0), stringCount(0), runtimeMode(RuntimeMode::INLINE_PRINTF), target(Target::LLVM), line(0) {}
+
+    Label CodeBuffer::freshLabel() {
+        return Label{labelCount++};
+    }
+
+    Value CodeBuffer::freshVar() {
+        return Value::temp(varCount++);
+    }
 
-    std::string CodeBuffer::freshLabel() {
-        return "%label_" + std::to_string(labelCount++);
+    std::string decodeString(const std::string &literal) {
+        std::string bytes;
+        bytes.reserve(literal.size());
+        for (size_t i = 0; i < literal.size(); ++i) {
+            char c = literal[i];
+            if (c == '\\' && i + 1 < literal.size()) {
+                switch (literal[++i]) {
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 'r':
+                        c = '\r';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    default:
+                        c = literal[i];
+                        break;
+                }
+            }
+            bytes += c;
+        }
+        return bytes;
+    }
+
+    // Writes the bytes of the FanC literal as the body of an LLVM c"..." constant: every byte that
+    // may not appear verbatim is hex-escaped. Returns the number of bytes (without the null character)
+    static int encodeString(const std::string &literal, std::string &encoded) {
+        static const char hex[] = "0123456789ABCDEF";
+        std::string bytes = decodeString(literal);
+        for (unsigned char c : bytes) {
+            if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+                encoded += c;
+            } else {
+                encoded += '\\';
+                encoded += hex[c >> 4];
+                encoded += hex[c & 0xf];
+            }
+        }
+        return bytes.size();
     }
 
-    std::string CodeBuffer::freshVar() {
-        return "%t" + std::to_string(varCount++);
+    CodeBuffer::PooledString CodeBuffer::internString(const std::string &literal) {
+        auto found = stringPool.find(literal);
+        if (found != stringPool.end()) {
+            return found->second;
+        }
+        std::string encoded;
+        PooledString pooled = {stringCount++, encodeString(literal, encoded) + 1};
+        if (muted) {
+            // Nothing is emitted, so the constant must not be reused by code that is
+            return pooled;
+        }
+        stringPool.emplace(literal, pooled);
+        if (target == Target::X86_64) {
+            globalsBuffer.append(x86::stringConstant(pooled.index, decodeString(literal)));
+            return pooled;
+        }
+        globalsBuffer.append("@.str" + std::to_string(pooled.index) + " = constant [" + std::to_string(pooled.size)
+                             + " x i8] c\"" + encoded + "\\00\"\n");
+        return pooled;
     }
 
     std::string CodeBuffer::emitString(const std::string &str) {
-        std::string var = "@.str" + std::to_string(stringCount++);
-        globalsBuffer << var << " = constant [" << str.length() + 1 << " x i8] c\"" << str << "\\00\"";
-        return var;
+        return "@.str" + std::to_string(internString(str).index);
     }
 
-    void CodeBuffer::emit(const std::string &str) {
-        buffer << str << std::endl;
+    void CodeBuffer::emit(std::string_view line) {
+        *this << line << '\n';
     }
 
-    void CodeBuffer::emitLabel(const std::string &label) {
-        buffer << label.substr(1) << ":" << std::endl;
+    void CodeBuffer::append(ir::Instruction &&inst) {
+        if (muted) {
+            return;
+        }
+        if (inst.opcode == ir::Opcode::ALLOCA) {
+            allocas.push_back(std::move(inst));
+            return;
+        }
+        if (!current.empty() && current.back().isTerminator()) {
+            // Code after a break, continue or return is unreachable, but later blocks may still
+            // use its registers, so it gets a block of its own
+            emitLabel(freshLabel());
+        }
+        inst.line = line;
+        current.push_back(std::move(inst));
+    }
+
+    void CodeBuffer::endBlock() {
+        auto &instructions = function.blocks.back().instructions;
+        instructions.insert(instructions.end(), std::make_move_iterator(current.begin()),
+                            std::make_move_iterator(current.end()));
+        current.clear();
+    }
+
+    void CodeBuffer::emitLabel(Label label) {
+        if (muted) {
+            return;
+        }
+        if (current.empty() || !current.back().isTerminator()) {
+            emitBr(label);
+        }
+        endBlock();
+        function.blocks.emplace_back();
+        function.blocks.back().label = label;
+        // Registers of the previous block may not dominate this one
+        widened.clear();
+    }
+
+    void CodeBuffer::emitBinary(Value dst, BinaryOp op, ast::BuiltInType type, Value lhs, Value rhs) {
+        ir::Instruction inst(ir::Opcode::BINARY);
+        inst.binaryOp = op;
+        inst.type = type;
+        inst.dst = dst;
+        inst.lhs = lhs;
+        inst.rhs = rhs;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitCompare(Value dst, Condition cond, ast::BuiltInType type, Value lhs, Value rhs) {
+        ir::Instruction inst(ir::Opcode::COMPARE);
+        inst.condition = cond;
+        inst.type = type;
+        inst.dst = dst;
+        inst.lhs = lhs;
+        inst.rhs = rhs;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitCast(Value dst, CastOp op, ast::BuiltInType from, Value value, ast::BuiltInType to) {
+        ir::Instruction inst(ir::Opcode::CAST);
+        inst.castOp = op;
+        inst.type = from;
+        inst.resultType = to;
+        inst.dst = dst;
+        inst.lhs = value;
+        append(std::move(inst));
+    }
+
+    Value CodeBuffer::emitConversion(Value value, ast::BuiltInType from, ast::BuiltInType to) {
+        if (from == to) {
+            return value;
+        }
+        bool widen = from == ast::BuiltInType::BYTE && to == ast::BuiltInType::INT;
+        if (value.isConst()) {
+            // Byte constants are kept in [0, 255], so widening leaves them unchanged
+            return widen ? value : Value::constant(value.id & 0xff);
+        }
+        if (widen) {
+            auto found = widened.find(value.id);
+            if (found != widened.end()) {
+                return found->second;
+            }
+        }
+        Value result = freshVar();
+        emitCast(result, widen ? CastOp::ZEXT : CastOp::TRUNC, from, value, to);
+        if (widen && value.kind == Value::Kind::TEMP) {
+            widened.emplace(value.id, result);
+        }
+        return result;
+    }
+
+    void CodeBuffer::emitAlloca(Value dst, ast::BuiltInType type) {
+        ir::Instruction inst(ir::Opcode::ALLOCA);
+        inst.type = type;
+        inst.dst = dst;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitLoad(Value dst, ast::BuiltInType type, Value ptr) {
+        ir::Instruction inst(ir::Opcode::LOAD);
+        inst.type = type;
+        inst.dst = dst;
+        inst.lhs = ptr;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitStore(ast::BuiltInType type, Value value, Value ptr) {
+        ir::Instruction inst(ir::Opcode::STORE);
+        inst.type = type;
+        inst.lhs = value;
+        inst.rhs = ptr;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitBr(Label target) {
+        ir::Instruction inst(ir::Opcode::BR);
+        inst.target = target;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitCondBr(Value cond, Label ifTrue, Label ifFalse) {
+        ir::Instruction inst(ir::Opcode::COND_BR);
+        inst.lhs = cond;
+        inst.target = ifTrue;
+        inst.otherTarget = ifFalse;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitRet(ast::BuiltInType type, Value value) {
+        ir::Instruction inst(ir::Opcode::RET);
+        inst.type = type;
+        inst.lhs = value;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitRetVoid() {
+        append(ir::Instruction(ir::Opcode::RET));
+    }
+
+    void CodeBuffer::emitCall(Value dst, ast::BuiltInType returnType, std::string_view name, std::vector<Arg> args) {
+        ir::Instruction inst(ir::Opcode::CALL);
+        inst.type = returnType;
+        inst.dst = dst;
+        inst.callee = ir::functionId(name);
+        inst.args = std::move(args);
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitPrintString(const std::string &str) {
+        PooledString pooled = internString(str);
+        ir::Instruction inst(ir::Opcode::PRINT_STRING);
+        inst.index = pooled.index;
+        inst.size = pooled.size;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitPrintInt(Value value) {
+        ir::Instruction inst(ir::Opcode::PRINT_INT);
+        inst.lhs = value;
+        append(std::move(inst));
+    }
+
+    void CodeBuffer::emitDivisionByZeroError() {
+        append(ir::Instruction(ir::Opcode::DIV_ZERO_ERROR));
+    }
+
+    void CodeBuffer::emitFunctionBegin(std::string_view name, ast::BuiltInType returnType,
+                                       const std::vector<ast::BuiltInType> &paramTypes) {
+        function = ir::Function();
+        function.name = name;
+        function.id = ir::functionId(name);
+        function.returnType = returnType;
+        function.paramTypes = paramTypes;
+        function.blocks.emplace_back();
+        allocas.clear();
+        current.clear();
+        widened.clear();
+    }
+
+    void CodeBuffer::emitFunctionEnd() {
+        if (muted) {
+            return;
+        }
+        timing::Scope codegen(timing::Phase::CODEGEN, function.name);
+        endBlock();
+        auto &entry = function.blocks.front().instructions;
+        entry.insert(entry.begin(), std::make_move_iterator(allocas.begin()), std::make_move_iterator(allocas.end()));
+        allocas.clear();
+        passManager.run(function);
+        if (passManager.hasModulePasses()) {
+            pending.push_back(std::move(function));
+        } else {
+            print(function);
+        }
+        function = ir::Function();
+    }
+
+    void CodeBuffer::print(const ir::Function &function) {
+        if (target == Target::X86_64) {
+            x86::print(function, *this);
+            return;
+        }
+        ir::print(function, *this,
+                  runtimeMode == RuntimeMode::INLINE_PRINTF ? ir::PrintLowering::PRINTF : ir::PrintLowering::CALL);
+    }
+
+    void CodeBuffer::printPending() {
+        if (pending.empty()) {
+            return;
+        }
+        timing::Scope codegen(timing::Phase::CODEGEN);
+        passManager.run(pending);
+        for (const auto &function : pending) {
+            timing::Scope printing(timing::Phase::CODEGEN, function.name);
+            print(function);
+        }
+        pending.clear();
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(Value value) {
+        switch (value.kind) {
+            case Value::Kind::TEMP:
+                return *this << "%t" << value.id;
+            case Value::Kind::ARG:
+                return *this << "%arg" << value.id;
+            default:
+                return *this << value.id;
+        }
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(Label label) {
+        return *this << "%label_" << label.id;
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(ast::BuiltInType type) {
+        return *this << ir::llvmType(type);
     }
 
     CodeBuffer &CodeBuffer::operator<<(std::ostream &(*manip)(std::ostream &)) {
-        buffer << manip;
-        return *this;
+        // std::endl is the only manipulator used; anything else that writes text works the same way
+        std::ostringstream text;
+        text << manip;
+        return *this << text.str();
+    }
+
+    void CodeBuffer::flush(std::ostream &os) {
+        printPending();
+        timing::Scope writing(timing::Phase::OUTPUT);
+        os << *this;
+        globalsBuffer.clear();
+        buffer.clear();
+    }
+
+    void CodeBuffer::flush(int fd) {
+        printPending();
+        timing::Scope writing(timing::Phase::OUTPUT);
+        globalsBuffer.append('\n');
+        globalsBuffer.write(fd);
+        buffer.write(fd);
+        globalsBuffer.clear();
+        buffer.clear();
+    }
+
+    void CodeBuffer::setMuted(bool muted) {
+        this->muted = muted;
     }
 
     std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer) {
-        os << buffer.globalsBuffer.str() << std::endl << buffer.buffer.str();
+        buffer.globalsBuffer.write(os);
+        os << std::endl;
+        buffer.buffer.write(os);
         return os;
     }
 }
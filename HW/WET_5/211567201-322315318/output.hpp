@@ -4,8 +4,14 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include <unordered_map>
 #include "visitor.hpp"
 #include "nodes.hpp"
+#include "value.hpp"
+#include "ir.hpp"
 
 namespace output {
     /* Error handling functions */
@@ -36,63 +42,290 @@ namespace output {
 
     void errorByteTooLarge(int lineno, int value);
 
+    void errorNumTooLarge(int lineno, const std::string &literal);
+
+    // The bytes of a FanC string literal (without its quotes): the escapes \n \r \t \" and \\ are
+    // replaced by the bytes they stand for
+    std::string decodeString(const std::string &literal);
+
+    /* The typed emission functions of CodeBuffer speak the IR's vocabulary */
+    using ir::BinaryOp;
+    using ir::Condition;
+    using ir::CastOp;
+    using ir::Arg;
+
+    /* Where the code for print and printi comes from */
+    enum class RuntimeMode {
+        INLINE_PRINTF, // every call site calls printf directly
+        HELPERS,       // call sites call @print/@printi, defined alwaysinline in the module
+        EXTERNAL       // call sites call @print/@printi, declared only; link print_functions.llvm
+                       // (or another runtime, e.g. a buffered one) with llvm-link
+    };
+
+    /* What the functions are printed as */
+    enum class Target {
+        LLVM,   // LLVM IR text
+        X86_64  // x86-64 assembly for GNU as, with its own runtime (see x86.hpp)
+    };
+
+    /* BlockBuffer class
+     * Append-only text buffer made of fixed-size blocks taken from a shared pool.
+     * The text is never joined into one string: it is written out block by block.
+     */
+    class BlockBuffer {
+    public:
+        static const size_t BLOCK_SIZE = 64 * 1024;
+
+        BlockBuffer() = default;
+        BlockBuffer(const BlockBuffer &) = delete;
+        BlockBuffer &operator=(const BlockBuffer &) = delete;
+        ~BlockBuffer();
+
+        void append(const char *data, size_t size);
+
+        void append(const std::string &str) {
+            append(str.data(), str.size());
+        }
+
+        void append(char c);
+
+        bool empty() const {
+            return blocks.empty();
+        }
+
+        // Writes the whole content to the file descriptor, gathering the blocks with writev
+        void write(int fd) const;
+
+        void write(std::ostream &os) const;
+
+        // Gives the blocks back to the pool
+        void clear();
+
+    private:
+        struct Block {
+            size_t used;
+            char data[BLOCK_SIZE];
+        };
+
+        std::vector<Block *> blocks;
+
+        // Blocks released by clear(), reused before allocating new ones
+        static std::vector<Block *> pool;
+    };
+
     /* CodeBuffer class
      * This class is used to store the generated code.
      * It provides a simple interface to emit code and manage labels and variables.
+     * Inside a function the typed emission functions build an ir::Function, which is run through
+     * the pass manager and printed into the buffer by emitFunctionEnd(). Outside functions (and
+     * for raw text) the buffer is written directly.
      */
     class CodeBuffer {
     private:
-        std::stringstream globalsBuffer;
-        std::stringstream buffer;
+        BlockBuffer globalsBuffer;
+        BlockBuffer buffer;
+        bool muted;
         int labelCount;
         int varCount;
         int stringCount;
-        int argCount;
+
+        /* A string constant in the globals section */
+        struct PooledString {
+            int index;
+            // Size in bytes, including the null character
+            int size;
+        };
+
+        // String constants already emitted, keyed by their source text
+        std::unordered_map<std::string, PooledString> stringPool;
+
+        // Returns the constant holding the literal, emitting it on first use
+        PooledString internString(const std::string &literal);
+
+        // Function being generated, between emitFunctionBegin() and emitFunctionEnd()
+        ir::Function function;
+        // Widened (zext) copies of the byte registers of the current block, by register number
+        std::unordered_map<int, Value> widened;
+
+        // Allocas of the function, moved to the start of the entry block by emitFunctionEnd()
+        std::vector<ir::Instruction> allocas;
+        // Instructions of the block being generated (the last one of the function). They are moved
+        // into it when it ends, so that each block is allocated once, at its final size
+        std::vector<ir::Instruction> current;
+        ir::PassManager passManager;
+        // Functions kept back for the module passes, printed by flush()
+        std::vector<ir::Function> pending;
+        RuntimeMode runtimeMode;
+        Target target;
+        // Stamped on the instructions as they are appended
+        int line;
+
+        void print(const ir::Function &function);
+
+        // Runs the module passes over the pending functions and prints them
+        void printPending();
+
+        // Adds an instruction to the current block. Code following a terminator starts a new
+        // (unreachable) block; allocas always go to the entry block
+        void append(ir::Instruction &&inst);
+
+        // Moves the instructions of the current block into the function
+        void endBlock();
 
         friend std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer);
 
-        std::vector<std::pair<std::string, std::string>> loopLabelStack;
+        std::vector<std::pair<Label, Label>> loopLabelStack;
 
     public:
         CodeBuffer();
 
-        // Returns a string that represents a label not used before
+        // Returns a label not used before
         // Usage examples:
         //      emitLabel(freshLabel());
-        //      buffer << "br label " << freshLabel() << std::endl;
-        std::string freshLabel();
+        //      emitBr(freshLabel());
+        Label freshLabel();
 
-        // Returns a string that represents a variable not used before
+        // Returns a register not used before
         // Usage examples:
-        //      std::string var = freshVar();
-        //      buffer << var << " = icmp eq i32 0, 0" << std::endl;
-        std::string freshVar();
+        //      Value var = freshVar();
+        //      emitCompare(var, Condition::EQ, ast::BuiltInType::INT, Value::constant(0), Value::constant(0));
+        Value freshVar();
 
         // Emits a label into the buffer
-        void emitLabel(const std::string &label);
+        void emitLabel(Label label);
 
-        // Emits a constant string into the globals section of the code.
+        // Emits a constant string into the globals section of the code, or reuses the one already
+        // emitted for the same text. str is the literal as written in FanC (escapes included).
         // Returns the name of the constant. For the string of the length n (not including null character), the type is [n+1 x i8]
-        // Usage examples:
-        //      std::string str = emitString("Hello, World!");
-        //      buffer << "call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([14 x i8], [14 x i8]* " << str << ", i32 0, i32 0))" << std::endl;
         std::string emitString(const std::string &str);
 
-        // Emits a string into the buffer
-        void emit(const std::string &str);
+        // Emits a line of text into the buffer as is (outside functions only)
+        void emit(std::string_view line);
+
+        // Must be set before any code is emitted
+        void setRuntimeMode(RuntimeMode mode) {
+            runtimeMode = mode;
+        }
+
+        RuntimeMode getRuntimeMode() const {
+            return runtimeMode;
+        }
+
+        // Must be set before any code is emitted
+        void setTarget(Target target) {
+            this->target = target;
+        }
+
+        Target getTarget() const {
+            return target;
+        }
+
+        // Passes run over every function before it is printed
+        ir::PassManager &passes() {
+            return passManager;
+        }
+
+        /* Typed instructions. Each one appends an ir::Instruction to the current block of the
+         * function; type is the FanC type of the operands (and of the result, except for comparisons) */
+
+        // dst = op type lhs, rhs
+        void emitBinary(Value dst, BinaryOp op, ast::BuiltInType type, Value lhs, Value rhs);
+
+        // dst = icmp cond type lhs, rhs
+        void emitCompare(Value dst, Condition cond, ast::BuiltInType type, Value lhs, Value rhs);
+
+        // dst = op from value to to
+        void emitCast(Value dst, CastOp op, ast::BuiltInType from, Value value, ast::BuiltInType to);
+
+        // Converts value between byte and int (zext or trunc) and returns the result. Constants are
+        // folded, and a register widened earlier in the same block is not widened again
+        Value emitConversion(Value value, ast::BuiltInType from, ast::BuiltInType to);
+
+        void emitAlloca(Value dst, ast::BuiltInType type);
+
+        void emitLoad(Value dst, ast::BuiltInType type, Value ptr);
+
+        void emitStore(ast::BuiltInType type, Value value, Value ptr);
+
+        void emitBr(Label target);
+
+        void emitCondBr(Value cond, Label ifTrue, Label ifFalse);
+
+        void emitRet(ast::BuiltInType type, Value value);
+
+        void emitRetVoid();
+
+        // Calls a FanC function; dst is ignored for void functions
+        void emitCall(Value dst, ast::BuiltInType returnType, std::string_view name, std::vector<Arg> args);
+
+        // Prints a string literal or an int with printf
+        void emitPrintString(const std::string &str);
+
+        void emitPrintInt(Value value);
+
+        // Prints the division by zero message and exits. Ends the block
+        void emitDivisionByZeroError();
+
+        // Starts a function: "define returnType @name(type %arg0, ...) {"; parameter i is Value::arg(i)
+        void emitFunctionBegin(std::string_view name, ast::BuiltInType returnType,
+                               const std::vector<ast::BuiltInType> &paramTypes);
+
+        // Ends the function, runs the passes over it and prints it. With module passes the function
+        // is only printed by the next flush(), once the module passes have seen it
+        void emitFunctionEnd();
+
+        // Prints the code emitted so far (globals first, like operator<<) and empties the buffer.
+        // Only call between functions, since the globals are printed ahead of the pending code.
+        // The functions flushed together are the module the module passes see
+        void flush(std::ostream &os);
+
+        // Same as flush(std::ostream &), but writes straight to a file descriptor without going
+        // through an iostream. Flush std::cout first if it may hold pending output
+        void flush(int fd);
+
+        // While muted, everything emitted is dropped (fresh names are still consumed). Used to
+        // type-check code that is not going to be printed
+        void setMuted(bool muted);
+
+        // Source line of the instructions emitted from now on, for the passes that report on them
+        void setLine(int line) {
+            this->line = line;
+        }
 
         // Template overload for general types
         template<typename T>
         CodeBuffer &operator<<(const T &value) {
-            buffer << value;
+            if (muted) {
+                return *this;
+            }
+            if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+                std::string_view text = value;
+                buffer.append(text.data(), text.size());
+            } else if constexpr (std::is_same_v<T, char>) {
+                buffer.append(value);
+            } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+                char digits[24];
+                buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr - digits);
+            } else {
+                std::ostringstream text;
+                text << value;
+                buffer.append(text.str());
+            }
             return *this;
         }
 
+        // Overloads for operands: registers, immediates and labels (as branch targets)
+        CodeBuffer &operator<<(Value value);
+
+        CodeBuffer &operator<<(Label label);
+
+        CodeBuffer &operator<<(ast::BuiltInType type);
+
         // Overload for manipulators (like std::endl)
         CodeBuffer &operator<<(std::ostream &(*manip)(std::ostream &));
 
 
-        void pushLoopLabels(const std::string &startLabel, const std::string &endLabel) {
+        void pushLoopLabels(Label startLabel, Label endLabel) {
             loopLabelStack.emplace_back(startLabel, endLabel);
         }
 
@@ -104,7 +337,7 @@ namespace output {
             }
         }
 
-        std::string getLoopStartLabel() const {
+        Label getLoopStartLabel() const {
             if (!loopLabelStack.empty()) {
                 return loopLabelStack.back().first;
             } else {
@@ -112,7 +345,7 @@ namespace output {
             }
         }
 
-        std::string getLoopEndLabel() const {
+        Label getLoopEndLabel() const {
             if (!loopLabelStack.empty()) {
                 return loopLabelStack.back().second;
             } else {
@@ -120,11 +353,6 @@ namespace output {
             }
         }
 
-        int getArgCount(){
-            argCount++;
-            return argCount;
-        }
-
     };
 
     std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer);
@@ -2,22 +2,47 @@
 
 #include "nodes.hpp"
 #include "output.hpp"
+#include <cstdlib>
+#include <functional>
 
 // bison declarations
-extern int yylineno;
-extern int yylex();
+extern thread_local int yylineno;
+extern int yylex(int *value);
 
 void yyerror(const char*);
 
+// The nodes on the value stack; its slots hold their handles (see ast::NodeArena)
+ast::NodeArena parserNodes;
+
+static int add(std::shared_ptr<ast::Node> node) {
+    return parserNodes.add(std::move(node));
+}
+
+template<typename T>
+static std::shared_ptr<T> take(int handle) {
+    return parserNodes.take<T>(handle);
+}
+
 // root of the AST, set by the parser and used by other parts of the compiler
 std::shared_ptr<ast::Node> program;
 
+// When set, every function is handed here as soon as it is reduced instead of being kept in
+// the root Funcs node (streaming mode)
+std::function<void(std::shared_ptr<ast::FuncDecl>)> funcDeclHandler;
+
 using namespace std;
 
 // TODO: Place any additional declarations here
 
 %}
 
+// Pure so that the push interface can be fed tokens with their values (see streaming.cpp);
+// yyparse() still pulls tokens from yylex()
+%define api.pure full
+%define api.push-pull both
+// Handles into parserNodes: plain ints, so that bison can grow its stacks
+%define api.value.type {int}
+
 // TODO: Define tokens here
 %token VOID
 %token INT
@@ -54,200 +79,205 @@ using namespace std;
 %%
 
 // While reducing the start variable, set the root of the AST
-Program:        Funcs                                                           { program = $1; }
+Program:        Funcs                                                           { program = take<ast::Node>($1); }
 ;
 
-Funcs:          FuncDecl Funcs                                                  { auto funcsList = dynamic_pointer_cast<ast::Funcs>($2); 
-                                                                                    funcsList->push_front(dynamic_pointer_cast<ast::FuncDecl>($1));
-                                                                                    $$ = funcsList;
-                                                                                } 
-                |                                                               { $$ = make_shared<ast::Funcs>(); }           
+Funcs:          Funcs FuncDecl                                                  { auto funcsList = take<ast::Funcs>($1);
+                                                                                    auto func = take<ast::FuncDecl>($2);
+                                                                                    if (funcDeclHandler) {
+                                                                                        funcDeclHandler(std::move(func));
+                                                                                    } else {
+                                                                                        funcsList->push_back(func);
+                                                                                    }
+                                                                                    $$ = add(funcsList);
+                                                                                }
+                |                                                               { $$ = add(make_shared<ast::Funcs>()); }           
 ;
 
-FuncDecl:       RetType ID LPAREN Formals RPAREN LBRACE Statements RBRACE       { $$ = make_shared<ast::FuncDecl>(
-                                                                                    dynamic_pointer_cast<ast::ID>($2),
-                                                                                    dynamic_pointer_cast<ast::Type>($1),
-                                                                                    dynamic_pointer_cast<ast::Formals>($4),
-                                                                                    dynamic_pointer_cast<ast::Statements>($7)
-                                                                                    ); 
+FuncDecl:       RetType ID LPAREN Formals RPAREN LBRACE Statements RBRACE       { $$ = add(make_shared<ast::FuncDecl>(
+                                                                                    take<ast::ID>($2),
+                                                                                    take<ast::Type>($1),
+                                                                                    take<ast::Formals>($4),
+                                                                                    take<ast::Statements>($7)
+                                                                                    )); 
                                                                                 }
 ;
 
 RetType:        Type                                                            { $$ = $1; }
-                | VOID                                                          { $$ = make_shared<ast::Type>(ast::BuiltInType::VOID); }   
+                | VOID                                                          { $$ = add(make_shared<ast::Type>(ast::BuiltInType::VOID)); }   
 ;
 
 Formals:        FormalsList                                                     { $$ = $1; }      
-                |                                                               { $$ = make_shared<ast::Formals>(); }
+                |                                                               { $$ = add(make_shared<ast::Formals>()); }
 ;
 
-FormalsList:    FormalDecl                                                      { $$ = make_shared<ast::Formals>(dynamic_pointer_cast<ast::Formal>($1)); } 
-                | FormalDecl COMMA FormalsList                                  { auto formalsList = dynamic_pointer_cast<ast::Formals>($3);
-                                                                                    formalsList->push_front(dynamic_pointer_cast<ast::Formal>($1));
-                                                                                    $$ = formalsList;
+FormalsList:    FormalDecl                                                      { $$ = add(make_shared<ast::Formals>(take<ast::Formal>($1))); } 
+                | FormalsList COMMA FormalDecl                                  { auto formalsList = take<ast::Formals>($1);
+                                                                                    formalsList->push_back(take<ast::Formal>($3));
+                                                                                    $$ = add(formalsList);
                                                                                 }
 ;
 
-FormalDecl:     Type ID                                                         { $$ = make_shared<ast::Formal>(
-                                                                                    dynamic_pointer_cast<ast::ID>($2),
-                                                                                    dynamic_pointer_cast<ast::Type>($1)
-                                                                                    );
+FormalDecl:     Type ID                                                         { $$ = add(make_shared<ast::Formal>(
+                                                                                    take<ast::ID>($2),
+                                                                                    take<ast::Type>($1)
+                                                                                    ));
                                                                                 }          
 ;
 
-Statements:     Statement                                                       { $$ = make_shared<ast::Statements>(dynamic_pointer_cast<ast::Statement>($1)); }     
-                | Statements Statement                                          { auto stmts = dynamic_pointer_cast<ast::Statements>($1);
-                                                                                    stmts->push_back(dynamic_pointer_cast<ast::Statement>($2));
-                                                                                    $$ = stmts;
+Statements:     Statement                                                       { $$ = add(make_shared<ast::Statements>(take<ast::Statement>($1))); }     
+                | Statements Statement                                          { auto stmts = take<ast::Statements>($1);
+                                                                                    stmts->push_back(take<ast::Statement>($2));
+                                                                                    $$ = add(stmts);
                                                                                 }      
 ;
 
 Statement:      LBRACE Statements RBRACE                                        { $$ = $2; }         
-                | Type ID SC                                                    { $$ = make_shared<ast::VarDecl>(
-                                                                                    dynamic_pointer_cast<ast::ID>($2),
-                                                                                    dynamic_pointer_cast<ast::Type>($1)
-                                                                                    ); 
+                | Type ID SC                                                    { $$ = add(make_shared<ast::VarDecl>(
+                                                                                    take<ast::ID>($2),
+                                                                                    take<ast::Type>($1)
+                                                                                    )); 
                                                                                 }
-                | Type ID ASSIGN Exp SC                                         { $$ = make_shared<ast::VarDecl>(
-                                                                                    dynamic_pointer_cast<ast::ID>($2),
-                                                                                    dynamic_pointer_cast<ast::Type>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($4)
-                                                                                    );
+                | Type ID ASSIGN Exp SC                                         { $$ = add(make_shared<ast::VarDecl>(
+                                                                                    take<ast::ID>($2),
+                                                                                    take<ast::Type>($1),
+                                                                                    take<ast::Exp>($4)
+                                                                                    ));
                                                                                 }
-                | ID ASSIGN Exp SC                                              { $$ = make_shared<ast::Assign>(
-                                                                                    dynamic_pointer_cast<ast::ID>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3)
-                                                                                    );
+                | ID ASSIGN Exp SC                                              { $$ = add(make_shared<ast::Assign>(
+                                                                                    take<ast::ID>($1),
+                                                                                    take<ast::Exp>($3)
+                                                                                    ));
                                                                                 }
                 | Call SC                                                       { $$ = $1; }
-                | RETURN SC                                                     { $$ = make_shared<ast::Return>(); }
-                | RETURN Exp SC                                                 { $$ = make_shared<ast::Return>(dynamic_pointer_cast<ast::Exp>($2)); }
-                | IF LPAREN Exp RPAREN Statement                                { $$ = make_shared<ast::If>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
-                                                                                    dynamic_pointer_cast<ast::Statement>($5)
-                                                                                    );
+                | RETURN SC                                                     { $$ = add(make_shared<ast::Return>()); }
+                | RETURN Exp SC                                                 { $$ = add(make_shared<ast::Return>(take<ast::Exp>($2))); }
+                | IF LPAREN Exp RPAREN Statement                                { $$ = add(make_shared<ast::If>(
+                                                                                    take<ast::Exp>($3),
+                                                                                    take<ast::Statement>($5)
+                                                                                    ));
                                                                                 }
-                | IF LPAREN Exp RPAREN Statement ELSE Statement %prec ELSE      { $$ = make_shared<ast::If>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
-                                                                                    dynamic_pointer_cast<ast::Statement>($5),
-                                                                                    dynamic_pointer_cast<ast::Statement>($7)
-                                                                                    );
+                | IF LPAREN Exp RPAREN Statement ELSE Statement %prec ELSE      { $$ = add(make_shared<ast::If>(
+                                                                                    take<ast::Exp>($3),
+                                                                                    take<ast::Statement>($5),
+                                                                                    take<ast::Statement>($7)
+                                                                                    ));
                                                                                 }
-                | WHILE LPAREN Exp RPAREN Statement                             { $$ = make_shared<ast::While>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
-                                                                                    dynamic_pointer_cast<ast::Statement>($5)
-                                                                                    );
+                | WHILE LPAREN Exp RPAREN Statement                             { $$ = add(make_shared<ast::While>(
+                                                                                    take<ast::Exp>($3),
+                                                                                    take<ast::Statement>($5)
+                                                                                    ));
                                                                                 }
-                | BREAK SC                                                      { $$ = make_shared<ast::Break>(); }
-                | CONTINUE SC                                                   { $$ = make_shared<ast::Continue>(); }
+                | BREAK SC                                                      { $$ = add(make_shared<ast::Break>()); }
+                | CONTINUE SC                                                   { $$ = add(make_shared<ast::Continue>()); }
 ;
 
-Call:           ID LPAREN ExpList RPAREN                                        { $$ = make_shared<ast::Call>(
-                                                                                    dynamic_pointer_cast<ast::ID>($1),
-                                                                                    dynamic_pointer_cast<ast::ExpList>($3)
-                                                                                    );
+Call:           ID LPAREN ExpList RPAREN                                        { $$ = add(make_shared<ast::Call>(
+                                                                                    take<ast::ID>($1),
+                                                                                    take<ast::ExpList>($3)
+                                                                                    ));
                                                                                 }
-                | ID LPAREN RPAREN                                              { $$ = make_shared<ast::Call>(
-                                                                                    dynamic_pointer_cast<ast::ID>($1)
-                                                                                    );
+                | ID LPAREN RPAREN                                              { $$ = add(make_shared<ast::Call>(
+                                                                                    take<ast::ID>($1)
+                                                                                    ));
                                                                                 }
 ;
 
-ExpList:        Exp                                                             { $$ = make_shared<ast::ExpList>(dynamic_pointer_cast<ast::Exp>($1)); }
-                | Exp COMMA ExpList                                             { auto expList = dynamic_pointer_cast<ast::ExpList>($3);
-                                                                                    expList->push_front(dynamic_pointer_cast<ast::Exp>($1));
-                                                                                    $$ = expList;
+ExpList:        Exp                                                             { $$ = add(make_shared<ast::ExpList>(take<ast::Exp>($1))); }
+                | ExpList COMMA Exp                                             { auto expList = take<ast::ExpList>($1);
+                                                                                    expList->push_back(take<ast::Exp>($3));
+                                                                                    $$ = add(expList);
                                                                                 }
 ;
 
-Type:           INT                                                             { $$ = make_shared<ast::Type>(ast::BuiltInType::INT); }
-                | BYTE                                                          { $$ = make_shared<ast::Type>(ast::BuiltInType::BYTE); }
-                | BOOL                                                          { $$ = make_shared<ast::Type>(ast::BuiltInType::BOOL); }
+Type:           INT                                                             { $$ = add(make_shared<ast::Type>(ast::BuiltInType::INT)); }
+                | BYTE                                                          { $$ = add(make_shared<ast::Type>(ast::BuiltInType::BYTE)); }
+                | BOOL                                                          { $$ = add(make_shared<ast::Type>(ast::BuiltInType::BOOL)); }
 ;
 
 Exp:            LPAREN Exp RPAREN                                               { $$ = $2; }
-                | Exp BINOP_ADD  Exp                                            { $$ = make_shared<ast::BinOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp BINOP_ADD  Exp                                            { $$ = add(make_shared<ast::BinOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::BinOpType::ADD
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp BINOP_SUB  Exp                                            { $$ = make_shared<ast::BinOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp BINOP_SUB  Exp                                            { $$ = add(make_shared<ast::BinOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::BinOpType::SUB
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp BINOP_MUL  Exp                                            { $$ = make_shared<ast::BinOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp BINOP_MUL  Exp                                            { $$ = add(make_shared<ast::BinOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::BinOpType::MUL
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp BINOP_DIV  Exp                                            { $$ = make_shared<ast::BinOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp BINOP_DIV  Exp                                            { $$ = add(make_shared<ast::BinOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::BinOpType::DIV
-                                                                                    );
+                                                                                    ));
                                                                                 }
                 | ID                                                            { $$ = $1; }
                 | Call                                                          { $$ = $1; }
                 | NUM                                                           { $$ = $1; }
                 | NUM_B                                                         { $$ = $1; }
                 | STRING                                                        { $$ = $1; }
-                | TRUE                                                          { $$ = make_shared<ast::Bool>(true); }
-                | FALSE                                                         { $$ = make_shared<ast::Bool>(false); }
-                | NOT Exp                                                       { $$ = make_shared<ast::Not>(dynamic_pointer_cast<ast::Exp>($2)); }
-                | Exp AND Exp                                                   { $$ = make_shared<ast::And>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3)
-                                                                                    );
+                | TRUE                                                          { $$ = add(make_shared<ast::Bool>(true)); }
+                | FALSE                                                         { $$ = add(make_shared<ast::Bool>(false)); }
+                | NOT Exp                                                       { $$ = add(make_shared<ast::Not>(take<ast::Exp>($2))); }
+                | Exp AND Exp                                                   { $$ = add(make_shared<ast::And>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3)
+                                                                                    ));
                                                                                 }
-                | Exp OR Exp                                                    { $$ = make_shared<ast::Or>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3)
-                                                                                    );
+                | Exp OR Exp                                                    { $$ = add(make_shared<ast::Or>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3)
+                                                                                    ));
                                                                                 }
-                | Exp RELOP_EQ Exp                                              { $$ = make_shared<ast::RelOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp RELOP_EQ Exp                                              { $$ = add(make_shared<ast::RelOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::RelOpType::EQ
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp RELOP_NE Exp                                             { $$ = make_shared<ast::RelOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp RELOP_NE Exp                                             { $$ = add(make_shared<ast::RelOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::RelOpType::NE
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp RELOP_LT Exp                                              { $$ = make_shared<ast::RelOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp RELOP_LT Exp                                              { $$ = add(make_shared<ast::RelOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::RelOpType::LT
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp RELOP_GT Exp                                              { $$ = make_shared<ast::RelOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp RELOP_GT Exp                                              { $$ = add(make_shared<ast::RelOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::RelOpType::GT
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp RELOP_LE Exp                                              { $$ = make_shared<ast::RelOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp RELOP_LE Exp                                              { $$ = add(make_shared<ast::RelOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::RelOpType::LE
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | Exp RELOP_GE Exp                                              { $$ = make_shared<ast::RelOp>(
-                                                                                    dynamic_pointer_cast<ast::Exp>($1),
-                                                                                    dynamic_pointer_cast<ast::Exp>($3),
+                | Exp RELOP_GE Exp                                              { $$ = add(make_shared<ast::RelOp>(
+                                                                                    take<ast::Exp>($1),
+                                                                                    take<ast::Exp>($3),
                                                                                     ast::RelOpType::GE
-                                                                                    );
+                                                                                    ));
                                                                                 }
-                | LPAREN Type RPAREN Exp                                        { $$ = make_shared<ast::Cast>(   
-                                                                                    dynamic_pointer_cast<ast::Exp>($4),
-                                                                                    dynamic_pointer_cast<ast::Type>($2)
-                                                                                    );
+                | LPAREN Type RPAREN Exp                                        { $$ = add(make_shared<ast::Cast>(   
+                                                                                    take<ast::Exp>($4),
+                                                                                    take<ast::Type>($2)
+                                                                                    ));
                                                                                 }
 ;
 
@@ -0,0 +1,1711 @@
+#include "passes.hpp"
+#include "intervals.hpp"
+#include "timing.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+
+namespace ir {
+
+    using output::Label;
+    using output::Value;
+
+    // Follows the replacements of removed registers down to the value that stands for them
+    static Value resolve(const std::unordered_map<int, Value> &replaced, Value value) {
+        while (value.kind == Value::Kind::TEMP) {
+            auto found = replaced.find(value.id);
+            if (found == replaced.end()) {
+                break;
+            }
+            value = found->second;
+        }
+        return value;
+    }
+
+    static size_t size(const Function &function) {
+        size_t count = 0;
+        for (const auto &block : function.blocks) {
+            for (const auto &inst : block.instructions) {
+                count += inst.opcode != Opcode::ALLOCA;
+            }
+        }
+        return count;
+    }
+
+    /* A table indexed by the registers of a function. Register numbers come from a counter shared
+     * by the whole program, but those of one function fall in a narrow range */
+    template<typename T>
+    class RegisterMap {
+    public:
+        RegisterMap(const Function &function, const T &initial) {
+            for (const auto &block : function.blocks) {
+                for (const auto &inst : block.instructions) {
+                    include(inst.dst);
+                    forEachUse(inst, [&](const Value &value) { include(value); });
+                }
+            }
+            table.assign(first <= last ? last - first + 1 : 0, initial);
+        }
+
+        bool contains(Value value) const {
+            return value.kind == Value::Kind::TEMP && value.id >= first && value.id <= last;
+        }
+
+        T &operator[](Value value) {
+            return table[value.id - first];
+        }
+
+        const T &operator[](Value value) const {
+            return table[value.id - first];
+        }
+
+    private:
+        int first = INT_MAX;
+        int last = INT_MIN;
+        std::vector<T> table;
+
+        void include(Value value) {
+            if (value.kind == Value::Kind::TEMP) {
+                first = std::min(first, value.id);
+                last = std::max(last, value.id);
+            }
+        }
+    };
+
+    static Value resolve(const RegisterMap<Value> &replaced, Value value) {
+        while (replaced.contains(value) && replaced[value].kind != Value::Kind::NONE) {
+            value = replaced[value];
+        }
+        return value;
+    }
+
+    /* Inliner */
+
+    void Inliner::run(Function &function) {
+        // Registers and labels of the inlined copies are numbered past the ones of the caller
+        int nextTemp = 0;
+        int nextLabel = 0;
+        for (const auto &block : function.blocks) {
+            nextLabel = std::max(nextLabel, block.label.id + 1);
+            for (const auto &inst : block.instructions) {
+                if (inst.dst.kind == Value::Kind::TEMP) {
+                    nextTemp = std::max(nextTemp, inst.dst.id + 1);
+                }
+            }
+        }
+
+        size_t grown = 0;
+        // Results of calls that were inlined without a return slot, and loads of formal slots
+        std::unordered_map<int, Value> replaced;
+        std::vector<Instruction> allocas;
+        std::vector<BasicBlock> blocks;
+        blocks.reserve(function.blocks.size());
+
+        for (auto &original : function.blocks) {
+            blocks.emplace_back();
+            blocks.back().label = original.label;
+            for (auto &inst : original.instructions) {
+                forEachUse(inst, [&](Value &value) { value = resolve(replaced, value); });
+                auto found = inst.opcode == Opcode::CALL ? candidates.find(inst.callee) : candidates.end();
+                if (found == candidates.end() || inst.callee == function.id) {
+                    blocks.back().instructions.push_back(std::move(inst));
+                    continue;
+                }
+                const Candidate &callee = found->second;
+                size_t calleeSize = size(callee.body);
+                if (grown + calleeSize > CALLER_BUDGET) {
+                    blocks.back().instructions.push_back(std::move(inst));
+                    continue;
+                }
+                grown += calleeSize;
+
+                int tempOffset = nextTemp - callee.firstTemp;
+                int labelOffset = nextLabel - callee.firstLabel;
+                nextTemp += callee.lastTemp - callee.firstTemp + 1;
+                nextLabel += callee.lastLabel - callee.firstLabel + 1;
+
+                auto formalOf = [&](Value slot) {
+                    for (size_t i = 0; i < callee.formalSlots.size(); ++i) {
+                        if (callee.formalSlots[i] == slot) {
+                            return (int) i;
+                        }
+                    }
+                    return -1;
+                };
+                auto rename = [&](Value &value) {
+                    if (value.kind == Value::Kind::TEMP) {
+                        value.id += tempOffset;
+                    } else if (value.kind == Value::Kind::ARG) {
+                        value = inst.args[value.id].value;
+                    }
+                    value = resolve(replaced, value);
+                };
+                auto relabel = [&](Label &label) {
+                    if (label.id >= 0) {
+                        label.id += labelOffset;
+                    }
+                };
+
+                // Multi-block bodies return through a slot read back in a continuation block
+                bool singleBlock = callee.body.blocks.size() == 1;
+                Label continuation;
+                Value result;
+                if (!singleBlock) {
+                    continuation = Label{nextLabel++};
+                    result = Value::temp(nextTemp++);
+                    if (callee.body.returnType != ast::BuiltInType::VOID) {
+                        Instruction slot(Opcode::ALLOCA);
+                        slot.type = callee.body.returnType;
+                        slot.dst = result;
+                        allocas.push_back(std::move(slot));
+                    }
+                }
+
+                for (size_t b = 0; b < callee.body.blocks.size(); ++b) {
+                    const BasicBlock &block = callee.body.blocks[b];
+                    if (b != 0) {
+                        // The entry block continues the caller's current block
+                        blocks.emplace_back();
+                        blocks.back().label = block.label;
+                        relabel(blocks.back().label);
+                    }
+                    for (Instruction copy : block.instructions) {
+                        if (copy.opcode == Opcode::ALLOCA && formalOf(copy.dst) >= 0) {
+                            continue;
+                        }
+                        if (copy.opcode == Opcode::STORE && formalOf(copy.rhs) >= 0) {
+                            continue;
+                        }
+                        if (copy.opcode == Opcode::LOAD && formalOf(copy.lhs) >= 0) {
+                            replaced[copy.dst.id + tempOffset] = resolve(replaced, inst.args[formalOf(copy.lhs)].value);
+                            continue;
+                        }
+                        if (copy.dst.kind == Value::Kind::TEMP) {
+                            copy.dst.id += tempOffset;
+                        }
+                        // The copy of a call is no longer followed by its function's return
+                        copy.tailCall = TailCall::NONE;
+                        forEachUse(copy, rename);
+                        relabel(copy.target);
+                        relabel(copy.otherTarget);
+
+                        if (copy.opcode == Opcode::ALLOCA) {
+                            allocas.push_back(std::move(copy));
+                        } else if (copy.opcode != Opcode::RET) {
+                            blocks.back().instructions.push_back(std::move(copy));
+                        } else if (singleBlock) {
+                            if (copy.type != ast::BuiltInType::VOID) {
+                                replaced[inst.dst.id] = copy.lhs;
+                            }
+                        } else {
+                            if (copy.type != ast::BuiltInType::VOID) {
+                                Instruction store(Opcode::STORE);
+                                store.type = copy.type;
+                                store.lhs = copy.lhs;
+                                store.rhs = result;
+                                blocks.back().instructions.push_back(std::move(store));
+                            }
+                            Instruction br(Opcode::BR);
+                            br.target = continuation;
+                            blocks.back().instructions.push_back(std::move(br));
+                        }
+                    }
+                }
+
+                if (!singleBlock) {
+                    blocks.emplace_back();
+                    blocks.back().label = continuation;
+                    if (callee.body.returnType != ast::BuiltInType::VOID) {
+                        Instruction load(Opcode::LOAD);
+                        load.type = callee.body.returnType;
+                        load.dst = inst.dst;
+                        load.lhs = result;
+                        blocks.back().instructions.push_back(std::move(load));
+                    }
+                }
+            }
+        }
+
+        if (!replaced.empty()) {
+            // A register may be used in a block laid out before the one it was replaced in
+            for (auto &block : blocks) {
+                for (auto &inst : block.instructions) {
+                    forEachUse(inst, [&](Value &value) { value = resolve(replaced, value); });
+                }
+            }
+        }
+        auto &entry = blocks.front().instructions;
+        entry.insert(entry.begin(), std::make_move_iterator(allocas.begin()), std::make_move_iterator(allocas.end()));
+        function.blocks = std::move(blocks);
+    }
+
+    void Inliner::remember(const Function &function) {
+        if (!acyclic.count(function.id)) {
+            for (const auto &block : function.blocks) {
+                for (const auto &inst : block.instructions) {
+                    if (inst.opcode == Opcode::CALL && !acyclic.count(inst.callee)) {
+                        return;
+                    }
+                }
+            }
+            acyclic.insert(function.id);
+        }
+        if (size(function) > CALLEE_BUDGET) {
+            return;
+        }
+        Candidate candidate;
+        candidate.firstTemp = INT_MAX;
+        candidate.lastTemp = INT_MIN;
+        candidate.firstLabel = INT_MAX;
+        candidate.lastLabel = INT_MIN;
+        candidate.formalSlots.assign(function.paramTypes.size(), Value());
+
+        std::unordered_map<int, int> storesTo;
+        for (const auto &block : function.blocks) {
+            if (block.label.id >= 0) {
+                candidate.firstLabel = std::min(candidate.firstLabel, block.label.id);
+                candidate.lastLabel = std::max(candidate.lastLabel, block.label.id);
+            }
+            for (const auto &inst : block.instructions) {
+                if (inst.dst.kind == Value::Kind::TEMP) {
+                    candidate.firstTemp = std::min(candidate.firstTemp, inst.dst.id);
+                    candidate.lastTemp = std::max(candidate.lastTemp, inst.dst.id);
+                }
+                if (inst.opcode == Opcode::STORE && inst.rhs.kind == Value::Kind::TEMP) {
+                    ++storesTo[inst.rhs.id];
+                    if (inst.lhs.kind == Value::Kind::ARG) {
+                        candidate.formalSlots[inst.lhs.id] = inst.rhs;
+                    }
+                }
+            }
+        }
+        for (auto &slot : candidate.formalSlots) {
+            if (slot.kind == Value::Kind::TEMP && storesTo[slot.id] != 1) {
+                slot = Value();
+            }
+        }
+        if (candidate.firstTemp > candidate.lastTemp) {
+            candidate.firstTemp = candidate.lastTemp = 0;
+        }
+        if (candidate.firstLabel > candidate.lastLabel) {
+            candidate.firstLabel = candidate.lastLabel = 0;
+        }
+        candidate.body = function;
+        candidates[function.id] = std::move(candidate);
+    }
+
+    std::vector<size_t> Inliner::callGraphOrder(const std::vector<Function> &functions) {
+        std::unordered_map<int, size_t> indexOf;
+        for (size_t i = 0; i < functions.size(); ++i) {
+            indexOf[functions[i].id] = i;
+        }
+        std::vector<std::vector<size_t>> callees(functions.size());
+        std::vector<bool> callsItself(functions.size(), false);
+        for (size_t i = 0; i < functions.size(); ++i) {
+            for (const auto &block : functions[i].blocks) {
+                for (const auto &inst : block.instructions) {
+                    auto found = inst.opcode == Opcode::CALL ? indexOf.find(inst.callee) : indexOf.end();
+                    if (found != indexOf.end()) {
+                        callees[i].push_back(found->second);
+                        callsItself[i] = callsItself[i] || found->second == i;
+                    }
+                }
+            }
+        }
+
+        // Tarjan's algorithm, which finds each component after the ones reachable from it. The
+        // depth first search keeps its own stack, since call chains can be as long as the program
+        const size_t UNVISITED = SIZE_MAX;
+        std::vector<size_t> number(functions.size(), UNVISITED);
+        std::vector<size_t> lowest(functions.size());
+        std::vector<bool> onStack(functions.size(), false);
+        std::vector<size_t> stack;
+        // Functions being searched, with the next of their callees to look at
+        std::vector<std::pair<size_t, size_t>> search;
+        std::vector<size_t> order;
+        size_t visited = 0;
+        for (size_t root = 0; root < functions.size(); ++root) {
+            if (number[root] != UNVISITED) {
+                continue;
+            }
+            search.emplace_back(root, 0);
+            number[root] = lowest[root] = visited++;
+            stack.push_back(root);
+            onStack[root] = true;
+            while (!search.empty()) {
+                size_t function = search.back().first;
+                size_t &next = search.back().second;
+                if (next < callees[function].size()) {
+                    size_t callee = callees[function][next++];
+                    if (number[callee] == UNVISITED) {
+                        number[callee] = lowest[callee] = visited++;
+                        stack.push_back(callee);
+                        onStack[callee] = true;
+                        search.emplace_back(callee, 0);
+                    } else if (onStack[callee]) {
+                        lowest[function] = std::min(lowest[function], number[callee]);
+                    }
+                    continue;
+                }
+                search.pop_back();
+                if (!search.empty()) {
+                    size_t caller = search.back().first;
+                    lowest[caller] = std::min(lowest[caller], lowest[function]);
+                }
+                if (lowest[function] != number[function]) {
+                    continue;
+                }
+                // The function is the first of its component found; the rest is above it on the stack
+                size_t begin = order.size();
+                size_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    order.push_back(member);
+                } while (member != function);
+                if (order.size() - begin == 1 && !callsItself[function]) {
+                    acyclic.insert(functions[function].id);
+                }
+            }
+        }
+        return order;
+    }
+
+    /* Tail calls */
+
+    // Drops the entries of the block's phis for values coming from the predecessors in removed
+    static void removeIncoming(BasicBlock &block, const std::unordered_set<int> &removed) {
+        for (auto &inst : block.instructions) {
+            if (inst.opcode != Opcode::PHI) {
+                break;
+            }
+            for (size_t i = inst.incoming.size(); i-- > 0;) {
+                if (removed.count(inst.incoming[i].id)) {
+                    inst.incoming.erase(inst.incoming.begin() + i);
+                    inst.args.erase(inst.args.begin() + i);
+                }
+            }
+        }
+    }
+
+    // The call ending the block if the block returns exactly its result, or nullptr
+    static Instruction *tailCallOf(BasicBlock &block) {
+        auto &insts = block.instructions;
+        if (insts.size() < 2 || insts.back().opcode != Opcode::RET || insts[insts.size() - 2].opcode != Opcode::CALL) {
+            return nullptr;
+        }
+        Instruction &call = insts[insts.size() - 2];
+        const Instruction &ret = insts.back();
+        bool returnsResult = ret.type == ast::BuiltInType::VOID ? call.type == ast::BuiltInType::VOID
+                                                                 : call.type != ast::BuiltInType::VOID && ret.lhs == call.dst;
+        return returnsResult ? &call : nullptr;
+    }
+
+    void eliminateTailRecursion(Function &function) {
+        // The prologue copies each parameter into its variable; parameters are not read elsewhere
+        auto &entry = function.blocks.front().instructions;
+        std::vector<Value> formalSlots(function.paramTypes.size());
+        size_t prologue = 0;
+        for (; prologue < entry.size(); ++prologue) {
+            const Instruction &inst = entry[prologue];
+            if (inst.opcode == Opcode::STORE && inst.lhs.kind == Value::Kind::ARG
+                && formalSlots[inst.lhs.id].kind == Value::Kind::NONE) {
+                formalSlots[inst.lhs.id] = inst.rhs;
+            } else if (inst.opcode != Opcode::ALLOCA) {
+                break;
+            }
+        }
+        size_t reads = 0;
+        bool selfTailCall = false;
+        int nextLabel = 0;
+        for (auto &block : function.blocks) {
+            nextLabel = std::max(nextLabel, block.label.id + 1);
+            for (const auto &inst : block.instructions) {
+                forEachUse(inst, [&](const Value &value) { reads += value.kind == Value::Kind::ARG; });
+            }
+            Instruction *call = tailCallOf(block);
+            selfTailCall |= call != nullptr && call->callee == function.id;
+        }
+        for (Value slot : formalSlots) {
+            if (slot.kind == Value::Kind::NONE) {
+                return;
+            }
+        }
+        if (!selfTailCall || reads != formalSlots.size()) {
+            return;
+        }
+
+        // The body after the prologue becomes the loop, which each self tail call restarts with
+        // the new arguments in the parameter variables. Every other variable is initialized by
+        // its declaration, so it does not carry over from the previous iteration
+        BasicBlock loop;
+        loop.label = Label{nextLabel};
+        loop.instructions.assign(std::make_move_iterator(entry.begin() + prologue), std::make_move_iterator(entry.end()));
+        entry.erase(entry.begin() + prologue, entry.end());
+        Instruction enter(Opcode::BR);
+        enter.target = loop.label;
+        entry.push_back(std::move(enter));
+        function.blocks.insert(function.blocks.begin() + 1, std::move(loop));
+
+        for (auto &block : function.blocks) {
+            Instruction *call = tailCallOf(block);
+            if (call == nullptr || call->callee != function.id) {
+                continue;
+            }
+            std::vector<Arg> args = std::move(call->args);
+            auto &insts = block.instructions;
+            insts.erase(insts.end() - 2, insts.end());
+            for (size_t i = 0; i < args.size(); ++i) {
+                Instruction store(Opcode::STORE);
+                store.type = function.paramTypes[i];
+                store.lhs = args[i].value;
+                store.rhs = formalSlots[i];
+                insts.push_back(std::move(store));
+            }
+            Instruction restart(Opcode::BR);
+            restart.target = Label{nextLabel};
+            insts.push_back(std::move(restart));
+        }
+    }
+
+    // Whether the value, flowing from the block labelled from into the one labelled target, is
+    // returned with no other work on the way: through blocks holding only phis (which may pass it
+    // on) and a branch, up to a ret of it, or a ret void
+    static bool returnedUnchanged(const Function &function, const std::unordered_map<int, size_t> &blockOf,
+                                  Label from, Label target, Value value) {
+        // Bounded, since the branches may form a loop
+        for (size_t steps = 0; steps < function.blocks.size(); ++steps) {
+            const auto &insts = function.blocks[blockOf.at(target.id)].instructions;
+            size_t i = 0;
+            Value passed;
+            for (; i < insts.size() && insts[i].opcode == Opcode::PHI; ++i) {
+                for (size_t k = 0; k < insts[i].incoming.size(); ++k) {
+                    if (insts[i].incoming[k].id == from.id && insts[i].args[k].value == value) {
+                        passed = insts[i].dst;
+                    }
+                }
+            }
+            if (passed.kind != Value::Kind::NONE) {
+                value = passed;
+            }
+            if (i + 1 != insts.size()) {
+                return false;
+            }
+            const Instruction &last = insts.back();
+            if (last.opcode == Opcode::RET) {
+                return last.type == ast::BuiltInType::VOID || last.lhs == value;
+            }
+            if (last.opcode != Opcode::BR) {
+                return false;
+            }
+            from = target;
+            target = last.target;
+        }
+        return false;
+    }
+
+    void markTailCalls(Function &function) {
+        std::unordered_map<int, size_t> blockOf;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            blockOf[function.blocks[i].label.id] = i;
+        }
+        bool returnsMoved = false;
+        for (auto &block : function.blocks) {
+            // An inlined body returns through a branch to its continuation: a call whose result is
+            // only carried to the function's return by the branches can return it right away
+            auto &insts = block.instructions;
+            if (insts.size() >= 2 && insts.back().opcode == Opcode::BR && insts[insts.size() - 2].opcode == Opcode::CALL) {
+                const Instruction &candidate = insts[insts.size() - 2];
+                Label target = insts.back().target;
+                if ((candidate.type == ast::BuiltInType::VOID) == (function.returnType == ast::BuiltInType::VOID)
+                    && returnedUnchanged(function, blockOf, block.label, target, candidate.dst)) {
+                    removeIncoming(function.blocks[blockOf.at(target.id)], {block.label.id});
+                    Instruction ret(Opcode::RET);
+                    ret.type = function.returnType;
+                    ret.lhs = candidate.dst;
+                    insts.back() = std::move(ret);
+                    returnsMoved = true;
+                }
+            }
+
+            Instruction *call = tailCallOf(block);
+            if (call == nullptr) {
+                continue;
+            }
+            bool samePrototype = call->type == function.returnType && call->args.size() == function.paramTypes.size();
+            for (size_t i = 0; samePrototype && i < call->args.size(); ++i) {
+                samePrototype = call->args[i].type == function.paramTypes[i];
+            }
+            call->tailCall = samePrototype ? TailCall::MUSTTAIL : TailCall::TAIL;
+        }
+        if (returnsMoved) {
+            // The continuations may now be reached from nowhere
+            removeUnreachableBlocks(function);
+        }
+    }
+
+    /* Constant folding */
+
+    // Brings a computed value to the form constants of the type are kept in: ints are signed,
+    // bytes are 0..255 and booleans 0 or 1
+    static int normalize(uint32_t value, ast::BuiltInType type) {
+        switch (type) {
+            case ast::BuiltInType::BYTE:
+                return value & 0xff;
+            case ast::BuiltInType::BOOL:
+                return value & 1;
+            default:
+                return (int32_t) value;
+        }
+    }
+
+    static int width(ast::BuiltInType type) {
+        switch (type) {
+            case ast::BuiltInType::BYTE:
+                return 8;
+            case ast::BuiltInType::BOOL:
+                return 1;
+            default:
+                return 32;
+        }
+    }
+
+    // The value as LLVM's signed operations see it
+    static int32_t signedValue(int value, ast::BuiltInType type) {
+        switch (type) {
+            case ast::BuiltInType::BYTE:
+                return (int8_t) value;
+            case ast::BuiltInType::BOOL:
+                return (value & 1) ? -1 : 0;
+            default:
+                return value;
+        }
+    }
+
+    // Computes the result of an instruction with constant operands. Returns false if it cannot
+    // be folded (not a computation, an operand is not constant, or division by zero / overflow)
+    static bool evaluate(const Instruction &inst, int &result) {
+        switch (inst.opcode) {
+            case Opcode::BINARY: {
+                if (!inst.lhs.isConst() || !inst.rhs.isConst()) {
+                    return false;
+                }
+                uint32_t a = normalize(inst.lhs.id, inst.type);
+                uint32_t b = normalize(inst.rhs.id, inst.type);
+                int32_t sa = signedValue(inst.lhs.id, inst.type);
+                int32_t sb = signedValue(inst.rhs.id, inst.type);
+                uint32_t value;
+                switch (inst.binaryOp) {
+                    case BinaryOp::ADD:
+                        value = a + b;
+                        break;
+                    case BinaryOp::SUB:
+                        value = a - b;
+                        break;
+                    case BinaryOp::MUL:
+                        value = a * b;
+                        break;
+                    case BinaryOp::SDIV:
+                        // The smallest value divided by -1 overflows
+                        if (sb == 0 || (sb == -1 && sa == signedValue(normalize(0x80000000u >> (32 - width(inst.type)), inst.type), inst.type))) {
+                            return false;
+                        }
+                        value = sa / sb;
+                        break;
+                    case BinaryOp::UDIV:
+                        if (b == 0) {
+                            return false;
+                        }
+                        value = a / b;
+                        break;
+                    case BinaryOp::AND:
+                        value = a & b;
+                        break;
+                    case BinaryOp::OR:
+                        value = a | b;
+                        break;
+                    default:
+                        value = a ^ b;
+                        break;
+                }
+                result = normalize(value, inst.type);
+                return true;
+            }
+            case Opcode::COMPARE: {
+                if (!inst.lhs.isConst() || !inst.rhs.isConst()) {
+                    return false;
+                }
+                int32_t a = signedValue(inst.lhs.id, inst.type);
+                int32_t b = signedValue(inst.rhs.id, inst.type);
+                switch (inst.condition) {
+                    case Condition::EQ:
+                        result = a == b;
+                        break;
+                    case Condition::NE:
+                        result = a != b;
+                        break;
+                    case Condition::SLT:
+                        result = a < b;
+                        break;
+                    case Condition::SLE:
+                        result = a <= b;
+                        break;
+                    case Condition::SGT:
+                        result = a > b;
+                        break;
+                    default:
+                        result = a >= b;
+                        break;
+                }
+                return true;
+            }
+            case Opcode::CAST:
+                if (!inst.lhs.isConst()) {
+                    return false;
+                }
+                if (inst.castOp == CastOp::SEXT) {
+                    result = normalize(signedValue(inst.lhs.id, inst.type), inst.resultType);
+                } else {
+                    result = normalize(normalize(inst.lhs.id, inst.type), inst.resultType);
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void removeUnreachableBlocks(Function &function) {
+        std::unordered_map<int, size_t> blockOf;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            blockOf[function.blocks[i].label.id] = i;
+        }
+        std::vector<bool> reachable(function.blocks.size(), false);
+        std::vector<size_t> worklist = {0};
+        reachable[0] = true;
+        while (!worklist.empty()) {
+            const BasicBlock &block = function.blocks[worklist.back()];
+            worklist.pop_back();
+            if (!block.terminated()) {
+                continue;
+            }
+            const Instruction &last = block.instructions.back();
+            for (Label target : {last.target, last.otherTarget}) {
+                if (target.id < 0) {
+                    continue;
+                }
+                size_t index = blockOf.at(target.id);
+                if (!reachable[index]) {
+                    reachable[index] = true;
+                    worklist.push_back(index);
+                }
+            }
+        }
+        std::unordered_set<int> removed;
+        size_t kept = 0;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            if (reachable[i]) {
+                if (kept != i) {
+                    function.blocks[kept] = std::move(function.blocks[i]);
+                }
+                ++kept;
+            } else {
+                removed.insert(function.blocks[i].label.id);
+            }
+        }
+        function.blocks.resize(kept);
+        if (!removed.empty()) {
+            for (auto &block : function.blocks) {
+                removeIncoming(block, removed);
+            }
+        }
+    }
+
+    void foldConstants(Function &function) {
+        std::unordered_map<int, Value> constants;
+        // Edges removed by folding a branch, as (from, to)
+        std::vector<std::pair<Label, Label>> removedEdges;
+        bool branchFolded = false;
+        size_t folded;
+        // Uses may come before the definition in block order, so repeat until nothing changes
+        do {
+            folded = constants.size();
+            for (auto &block : function.blocks) {
+                auto &insts = block.instructions;
+                size_t kept = 0;
+                for (auto &inst : insts) {
+                    forEachUse(inst, [&](Value &value) { value = resolve(constants, value); });
+                    int result;
+                    if (evaluate(inst, result)) {
+                        constants[inst.dst.id] = Value::constant(result);
+                        continue;
+                    }
+                    if (inst.opcode == Opcode::COND_BR && inst.lhs.isConst()) {
+                        inst.opcode = Opcode::BR;
+                        if (!(inst.lhs.id & 1)) {
+                            std::swap(inst.target, inst.otherTarget);
+                        }
+                        if (inst.otherTarget.id != inst.target.id) {
+                            removedEdges.emplace_back(block.label, inst.otherTarget);
+                        }
+                        inst.otherTarget = Label();
+                        inst.lhs = Value();
+                        branchFolded = true;
+                    }
+                    if (&insts[kept] != &inst) {
+                        insts[kept] = std::move(inst);
+                    }
+                    ++kept;
+                }
+                insts.erase(insts.begin() + kept, insts.end());
+            }
+        } while (constants.size() != folded);
+
+        if (branchFolded) {
+            std::unordered_map<int, size_t> blockOf;
+            for (size_t i = 0; i < function.blocks.size(); ++i) {
+                blockOf[function.blocks[i].label.id] = i;
+            }
+            for (const auto &edge : removedEdges) {
+                removeIncoming(function.blocks[blockOf.at(edge.second.id)], {edge.first.id});
+            }
+            removeUnreachableBlocks(function);
+        }
+    }
+
+    /* Loop-invariant code motion */
+
+    // Whether the instruction can be executed before the loop even if the loop would not have
+    // executed it: no side effects and no trap. Division is only safe by a constant that is neither
+    // 0 nor -1, since the division by zero check stays in the loop
+    static bool speculatable(const Instruction &inst) {
+        switch (inst.opcode) {
+            case Opcode::BINARY:
+                if (inst.binaryOp == BinaryOp::SDIV || inst.binaryOp == BinaryOp::UDIV) {
+                    return inst.rhs.isConst() && normalize(inst.rhs.id, inst.type) != 0
+                           && signedValue(inst.rhs.id, inst.type) != -1;
+                }
+                return true;
+            case Opcode::COMPARE:
+            case Opcode::CAST:
+            case Opcode::LOAD:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Hoists the invariants of the loop made of blocks [header, last] into its preheader, the single
+    // block outside the loop that enters it. Loops of any other shape are left alone
+    static void hoistLoop(Function &function, const std::unordered_map<int, size_t> &blockOf, size_t header, size_t last) {
+        auto inLoop = [&](size_t index) {
+            return index >= header && index <= last;
+        };
+        size_t preheader = SIZE_MAX;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            if (inLoop(i) || !function.blocks[i].terminated()) {
+                continue;
+            }
+            const Instruction &branch = function.blocks[i].instructions.back();
+            for (Label target : {branch.target, branch.otherTarget}) {
+                if (target.id < 0 || !inLoop(blockOf.at(target.id))) {
+                    continue;
+                }
+                if (blockOf.at(target.id) != header || branch.opcode != Opcode::BR || preheader != SIZE_MAX) {
+                    return;
+                }
+                preheader = i;
+            }
+        }
+        if (preheader == SIZE_MAX) {
+            return;
+        }
+
+        std::unordered_set<int> stored;
+        std::unordered_set<int> defined;
+        for (size_t i = header; i <= last; ++i) {
+            for (const auto &inst : function.blocks[i].instructions) {
+                if (inst.opcode == Opcode::STORE) {
+                    stored.insert(inst.rhs.id);
+                }
+                if (inst.dst.kind == Value::Kind::TEMP) {
+                    defined.insert(inst.dst.id);
+                }
+            }
+        }
+
+        std::vector<Instruction> hoisted;
+        size_t count;
+        do {
+            count = hoisted.size();
+            for (size_t i = header; i <= last; ++i) {
+                auto &insts = function.blocks[i].instructions;
+                size_t kept = 0;
+                for (size_t j = 0; j < insts.size(); ++j) {
+                    Instruction &inst = insts[j];
+                    bool invariant = speculatable(inst);
+                    if (inst.opcode == Opcode::LOAD) {
+                        invariant = !stored.count(inst.lhs.id);
+                    } else if (invariant) {
+                        forEachUse(inst, [&](Value &value) {
+                            invariant &= value.kind != Value::Kind::TEMP || !defined.count(value.id);
+                        });
+                    }
+                    if (invariant) {
+                        defined.erase(inst.dst.id);
+                        hoisted.push_back(std::move(inst));
+                        continue;
+                    }
+                    if (kept != j) {
+                        insts[kept] = std::move(inst);
+                    }
+                    ++kept;
+                }
+                insts.erase(insts.begin() + kept, insts.end());
+            }
+        } while (hoisted.size() != count);
+
+        auto &target = function.blocks[preheader].instructions;
+        target.insert(target.end() - 1, std::make_move_iterator(hoisted.begin()), std::make_move_iterator(hoisted.end()));
+    }
+
+    void hoistLoopInvariants(Function &function) {
+        std::unordered_map<int, size_t> blockOf;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            blockOf[function.blocks[i].label.id] = i;
+        }
+        // Last block of each loop, by header
+        std::unordered_map<size_t, size_t> loops;
+        for (size_t i = 0; i < function.blocks.size(); ++i) {
+            const BasicBlock &block = function.blocks[i];
+            if (!block.terminated()) {
+                continue;
+            }
+            const Instruction &branch = block.instructions.back();
+            for (Label target : {branch.target, branch.otherTarget}) {
+                if (target.id >= 0 && blockOf.at(target.id) <= i) {
+                    size_t &last = loops[blockOf.at(target.id)];
+                    last = std::max(last, i);
+                }
+            }
+        }
+        // Inner loops first, so that what they hoist can move further out of the enclosing loops
+        std::vector<std::pair<size_t, size_t>> order(loops.begin(), loops.end());
+        std::sort(order.begin(), order.end(), [](const auto &a, const auto &b) {
+            return a.second - a.first < b.second - b.first;
+        });
+        for (const auto &loop : order) {
+            hoistLoop(function, blockOf, loop.first, loop.second);
+        }
+    }
+
+    /* Range analysis */
+
+    void simplifyWithRanges(Function &function) {
+        dataflow::CFG cfg(function);
+        dataflow::IntervalAnalysis analysis(function, cfg);
+        auto solution = dataflow::solve(cfg, analysis);
+
+        std::unordered_map<int, Value> decided;
+        for (size_t block : cfg.order) {
+            analysis.evaluate(block, solution.in[block], [&](const Instruction &inst, const dataflow::Interval &result, bool) {
+                if (inst.opcode == Opcode::COMPARE && !result.empty() && result.isConstant()) {
+                    decided[inst.dst.id] = Value::constant(result.lo);
+                }
+            });
+        }
+        if (decided.empty()) {
+            return;
+        }
+        for (auto &block : function.blocks) {
+            auto &insts = block.instructions;
+            insts.erase(std::remove_if(insts.begin(), insts.end(), [&](const Instruction &inst) {
+                return inst.opcode == Opcode::COMPARE && decided.count(inst.dst.id);
+            }), insts.end());
+            for (auto &inst : insts) {
+                forEachUse(inst, [&](Value &value) { value = resolve(decided, value); });
+            }
+        }
+        foldConstants(function);
+    }
+
+    // The operation as the source names it
+    static const char *operation(BinaryOp op) {
+        switch (op) {
+            case BinaryOp::ADD:
+                return "addition";
+            case BinaryOp::SUB:
+                return "subtraction";
+            case BinaryOp::MUL:
+                return "multiplication";
+            default:
+                return "division";
+        }
+    }
+
+    void warnOverflow(Function &function) {
+        dataflow::CFG cfg(function);
+        dataflow::IntervalAnalysis analysis(function, cfg);
+        auto solution = dataflow::solve(cfg, analysis);
+        for (size_t block : cfg.order) {
+            analysis.evaluate(block, solution.in[block], [&](const Instruction &inst, const dataflow::Interval &, bool overflows) {
+                if (overflows) {
+                    std::cerr << "line " << inst.line << ": warning: " << operation(inst.binaryOp) << " of "
+                              << (inst.type == ast::BuiltInType::BYTE ? "bytes" : "ints") << " overflows for every input"
+                              << std::endl;
+                }
+            });
+        }
+    }
+
+    /* SSA construction */
+
+    void promoteToRegisters(Function &function) {
+        removeUnreachableBlocks(function);
+
+        // Variables whose address is used other than by loads and stores stay in memory. FanC
+        // never does that, but the IR would allow it
+        std::unordered_set<int> escaped;
+        for (const auto &block : function.blocks) {
+            for (const auto &inst : block.instructions) {
+                forEachUse(inst, [&](const Value &value) {
+                    bool address = (inst.opcode == Opcode::LOAD && &value == &inst.lhs)
+                                   || (inst.opcode == Opcode::STORE && &value == &inst.rhs);
+                    if (value.kind == Value::Kind::TEMP && !address) {
+                        escaped.insert(value.id);
+                    }
+                });
+            }
+        }
+        RegisterMap<int> slotOf(function, -1);
+        std::vector<ast::BuiltInType> slotTypes;
+        int nextTemp = 0;
+        int nextLabel = 0;
+        for (const auto &block : function.blocks) {
+            nextLabel = std::max(nextLabel, block.label.id + 1);
+            for (const auto &inst : block.instructions) {
+                if (inst.opcode == Opcode::ALLOCA && !escaped.count(inst.dst.id)) {
+                    slotOf[inst.dst] = (int) slotTypes.size();
+                    slotTypes.push_back(inst.type);
+                }
+                if (inst.dst.kind == Value::Kind::TEMP) {
+                    nextTemp = std::max(nextTemp, inst.dst.id + 1);
+                }
+            }
+        }
+        if (slotTypes.empty()) {
+            return;
+        }
+        auto slot = [&](Value pointer) {
+            return slotOf.contains(pointer) ? slotOf[pointer] : -1;
+        };
+
+        size_t n = function.blocks.size();
+        dataflow::CFG cfg(function);
+        dataflow::DominatorTree tree(cfg);
+        std::unordered_map<int, size_t> blockOf;
+        for (size_t i = 0; i < n; ++i) {
+            blockOf[function.blocks[i].label.id] = i;
+        }
+
+        // Phis go to the iterated dominance frontier of the blocks storing to each variable
+        std::vector<std::vector<Instruction>> phis(n);
+        std::vector<std::vector<size_t>> phiSlots(n);
+        std::vector<std::vector<size_t>> storedIn(slotTypes.size());
+        for (size_t b = 0; b < n; ++b) {
+            for (const auto &inst : function.blocks[b].instructions) {
+                int s = inst.opcode == Opcode::STORE ? slot(inst.rhs) : -1;
+                if (s >= 0 && (storedIn[s].empty() || storedIn[s].back() != b)) {
+                    storedIn[s].push_back(b);
+                }
+            }
+        }
+        std::vector<size_t> hasPhi(n, SIZE_MAX);
+        std::vector<size_t> queued(n, SIZE_MAX);
+        for (size_t s = 0; s < slotTypes.size(); ++s) {
+            std::vector<size_t> worklist = storedIn[s];
+            for (size_t b : worklist) {
+                queued[b] = s;
+            }
+            while (!worklist.empty()) {
+                size_t b = worklist.back();
+                worklist.pop_back();
+                for (size_t f : tree.frontier[b]) {
+                    if (hasPhi[f] == s) {
+                        continue;
+                    }
+                    hasPhi[f] = s;
+                    Instruction phi(Opcode::PHI);
+                    phi.type = slotTypes[s];
+                    phi.dst = Value::temp(nextTemp++);
+                    phis[f].push_back(std::move(phi));
+                    phiSlots[f].push_back(s);
+                    if (queued[f] != s) {
+                        queued[f] = s;
+                        worklist.push_back(f);
+                    }
+                }
+            }
+        }
+        // Phis name their predecessors by label, so the entry block needs one if it is a predecessor
+        BasicBlock &entry = function.blocks.front();
+        if (entry.label.id < 0) {
+            for (size_t successor : cfg.successors[0]) {
+                if (!phis[successor].empty()) {
+                    entry.label = Label{nextLabel++};
+                    break;
+                }
+            }
+        }
+
+        // Renaming, in a preorder walk of the dominator tree. Each variable has a stack of the values
+        // it holds along the walk; variables are never read before being written in FanC, and 0 is
+        // as good a value as any otherwise
+        std::vector<std::vector<Value>> current(slotTypes.size(), std::vector<Value>{Value::constant(0)});
+        RegisterMap<Value> replaced(function, Value());
+        // (block, next child to visit, variables written in the block)
+        struct Frame {
+            size_t block;
+            size_t child;
+            std::vector<size_t> written;
+        };
+        std::vector<Frame> stack;
+        stack.push_back({0, 0, {}});
+        bool entering = true;
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (entering) {
+                BasicBlock &block = function.blocks[frame.block];
+                for (size_t k = 0; k < phis[frame.block].size(); ++k) {
+                    current[phiSlots[frame.block][k]].push_back(phis[frame.block][k].dst);
+                    frame.written.push_back(phiSlots[frame.block][k]);
+                }
+                auto &insts = block.instructions;
+                size_t kept = 0;
+                for (size_t i = 0; i < insts.size(); ++i) {
+                    Instruction &inst = insts[i];
+                    forEachUse(inst, [&](Value &value) { value = resolve(replaced, value); });
+                    if (inst.opcode == Opcode::LOAD && slot(inst.lhs) >= 0) {
+                        replaced[inst.dst] = current[slot(inst.lhs)].back();
+                        continue;
+                    }
+                    if (inst.opcode == Opcode::STORE && slot(inst.rhs) >= 0) {
+                        current[slot(inst.rhs)].push_back(inst.lhs);
+                        frame.written.push_back(slot(inst.rhs));
+                        continue;
+                    }
+                    if (inst.opcode == Opcode::ALLOCA && slot(inst.dst) >= 0) {
+                        continue;
+                    }
+                    if (kept != i) {
+                        insts[kept] = std::move(inst);
+                    }
+                    ++kept;
+                }
+                insts.erase(insts.begin() + kept, insts.end());
+
+                // One phi entry per edge: both arms of a conditional branch may go to the same block
+                if (block.terminated()) {
+                    const Instruction &branch = block.instructions.back();
+                    for (Label target : {branch.target, branch.otherTarget}) {
+                        if (target.id < 0) {
+                            continue;
+                        }
+                        size_t successor = blockOf.at(target.id);
+                        for (size_t k = 0; k < phis[successor].size(); ++k) {
+                            phis[successor][k].args.push_back({slotTypes[phiSlots[successor][k]], current[phiSlots[successor][k]].back()});
+                            phis[successor][k].incoming.push_back(block.label);
+                        }
+                    }
+                }
+            }
+            if (frame.child < tree.children[frame.block].size()) {
+                size_t child = tree.children[frame.block][frame.child++];
+                stack.push_back({child, 0, {}});
+                entering = true;
+                continue;
+            }
+            for (size_t s : frame.written) {
+                current[s].pop_back();
+            }
+            stack.pop_back();
+            entering = false;
+        }
+
+        for (size_t b = 0; b < n; ++b) {
+            auto &insts = function.blocks[b].instructions;
+            insts.insert(insts.begin(), std::make_move_iterator(phis[b].begin()), std::make_move_iterator(phis[b].end()));
+        }
+    }
+
+    /* Sparse conditional constant propagation */
+
+    // What is known about a register: nothing yet (TOP), that it holds a constant, or that it
+    // may hold different values (BOTTOM)
+    struct LatticeValue {
+        enum class State {
+            TOP,
+            CONSTANT,
+            BOTTOM
+        };
+        State state = State::TOP;
+        int value = 0;
+
+        bool operator==(const LatticeValue &other) const {
+            return state == other.state && (state != State::CONSTANT || value == other.value);
+        }
+
+        // this = this meet other
+        void meet(const LatticeValue &other) {
+            if (other.state == State::TOP || state == State::BOTTOM) {
+                return;
+            }
+            if (state == State::TOP) {
+                *this = other;
+            } else if (other.state == State::BOTTOM || other.value != value) {
+                state = State::BOTTOM;
+            }
+        }
+    };
+
+    static bool hasSideEffects(const Instruction &inst) {
+        switch (inst.opcode) {
+            case Opcode::BINARY:
+            case Opcode::COMPARE:
+            case Opcode::CAST:
+            case Opcode::PHI:
+            case Opcode::ALLOCA:
+            case Opcode::LOAD:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    // Replaces the phis whose entries all hold the same value (or the phi itself) by that value
+    static void simplifyPhis(Function &function) {
+        std::unordered_map<int, Value> replaced;
+        size_t count;
+        do {
+            count = replaced.size();
+            for (auto &block : function.blocks) {
+                for (auto &inst : block.instructions) {
+                    if (inst.opcode != Opcode::PHI) {
+                        break;
+                    }
+                    if (replaced.count(inst.dst.id)) {
+                        continue;
+                    }
+                    Value same;
+                    bool unique = true;
+                    for (auto &arg : inst.args) {
+                        arg.value = resolve(replaced, arg.value);
+                        if (arg.value == inst.dst || arg.value == same) {
+                            continue;
+                        }
+                        unique &= same.kind == Value::Kind::NONE;
+                        same = arg.value;
+                    }
+                    if (unique && same.kind != Value::Kind::NONE) {
+                        replaced[inst.dst.id] = same;
+                    }
+                }
+            }
+        } while (replaced.size() != count);
+        if (replaced.empty()) {
+            return;
+        }
+        for (auto &block : function.blocks) {
+            auto &insts = block.instructions;
+            insts.erase(std::remove_if(insts.begin(), insts.end(), [&](const Instruction &inst) {
+                return inst.opcode == Opcode::PHI && replaced.count(inst.dst.id);
+            }), insts.end());
+            for (auto &inst : insts) {
+                forEachUse(inst, [&](Value &value) { value = resolve(replaced, value); });
+            }
+        }
+    }
+
+    void removeDeadCode(Function &function) {
+        // Marks the registers something with side effects depends on
+        std::unordered_map<int, const Instruction *> definition;
+        std::unordered_set<int> live;
+        std::vector<const Instruction *> worklist;
+        for (const auto &block : function.blocks) {
+            for (const auto &inst : block.instructions) {
+                if (inst.dst.kind == Value::Kind::TEMP) {
+                    definition[inst.dst.id] = &inst;
+                }
+                if (hasSideEffects(inst)) {
+                    worklist.push_back(&inst);
+                }
+            }
+        }
+        while (!worklist.empty()) {
+            const Instruction *inst = worklist.back();
+            worklist.pop_back();
+            forEachUse(*inst, [&](const Value &value) {
+                if (value.kind == Value::Kind::TEMP && live.insert(value.id).second) {
+                    auto found = definition.find(value.id);
+                    if (found != definition.end()) {
+                        worklist.push_back(found->second);
+                    }
+                }
+            });
+        }
+        for (auto &block : function.blocks) {
+            auto &insts = block.instructions;
+            insts.erase(std::remove_if(insts.begin(), insts.end(), [&](const Instruction &inst) {
+                return !hasSideEffects(inst) && !live.count(inst.dst.id);
+            }), insts.end());
+        }
+    }
+
+    void propagateConstants(Function &function) {
+        size_t n = function.blocks.size();
+        std::unordered_map<int, size_t> blockOf;
+        LatticeValue bottom;
+        bottom.state = LatticeValue::State::BOTTOM;
+        // Value of each register (registers defined in the function start out unknown), and the
+        // instructions using it, as (block, index)
+        RegisterMap<LatticeValue> values(function, bottom);
+        RegisterMap<std::vector<std::pair<size_t, size_t>>> users(function, {});
+        for (size_t b = 0; b < n; ++b) {
+            blockOf[function.blocks[b].label.id] = b;
+            const auto &insts = function.blocks[b].instructions;
+            for (size_t i = 0; i < insts.size(); ++i) {
+                if (insts[i].dst.kind == Value::Kind::TEMP) {
+                    values[insts[i].dst] = LatticeValue();
+                }
+                forEachUse(insts[i], [&](const Value &value) {
+                    if (value.kind == Value::Kind::TEMP) {
+                        users[value].emplace_back(b, i);
+                    }
+                });
+            }
+        }
+        auto valueOf = [&](Value value) {
+            LatticeValue result;
+            if (value.isConst()) {
+                result.state = LatticeValue::State::CONSTANT;
+                result.value = value.id;
+                return result;
+            }
+            return values.contains(value) ? values[value] : bottom;
+        };
+
+        std::vector<bool> executable(n, false);
+        std::unordered_set<uint64_t> executableEdges;
+        // Edges to follow, as (from, to), and instructions whose operands changed, as (block, index)
+        std::vector<std::pair<size_t, size_t>> flowWork = {{SIZE_MAX, 0}};
+        std::vector<std::pair<size_t, size_t>> ssaWork;
+
+        auto lower = [&](Value dst, const LatticeValue &next) {
+            LatticeValue &value = values[dst];
+            if (value == next) {
+                return;
+            }
+            value = next;
+            const auto &uses = users[dst];
+            ssaWork.insert(ssaWork.end(), uses.begin(), uses.end());
+        };
+        auto follow = [&](size_t from, Label target) {
+            flowWork.emplace_back(from, blockOf.at(target.id));
+        };
+        auto visit = [&](size_t b, size_t i) {
+            const Instruction &inst = function.blocks[b].instructions[i];
+            switch (inst.opcode) {
+                case Opcode::BINARY:
+                case Opcode::COMPARE:
+                case Opcode::CAST: {
+                    LatticeValue result;
+                    Instruction folded = inst;
+                    bool top = false;
+                    bool bottom = false;
+                    forEachUse(folded, [&](Value &operand) {
+                        if (operand.kind == Value::Kind::NONE) {
+                            return;
+                        }
+                        LatticeValue value = valueOf(operand);
+                        top |= value.state == LatticeValue::State::TOP;
+                        bottom |= value.state == LatticeValue::State::BOTTOM;
+                        operand = Value::constant(value.value);
+                    });
+                    if (bottom || (!top && !evaluate(folded, result.value))) {
+                        result.state = LatticeValue::State::BOTTOM;
+                    } else if (!top) {
+                        result.state = LatticeValue::State::CONSTANT;
+                    }
+                    lower(inst.dst, result);
+                    break;
+                }
+                case Opcode::PHI: {
+                    LatticeValue result;
+                    for (size_t k = 0; k < inst.args.size(); ++k) {
+                        uint64_t edge = blockOf.at(inst.incoming[k].id) * n + b;
+                        if (executableEdges.count(edge)) {
+                            result.meet(valueOf(inst.args[k].value));
+                        }
+                    }
+                    lower(inst.dst, result);
+                    break;
+                }
+                case Opcode::COND_BR: {
+                    LatticeValue condition = valueOf(inst.lhs);
+                    if (condition.state == LatticeValue::State::CONSTANT) {
+                        follow(b, condition.value & 1 ? inst.target : inst.otherTarget);
+                    } else if (condition.state == LatticeValue::State::BOTTOM) {
+                        follow(b, inst.target);
+                        follow(b, inst.otherTarget);
+                    }
+                    break;
+                }
+                case Opcode::BR:
+                    follow(b, inst.target);
+                    break;
+                default:
+                    if (inst.dst.kind == Value::Kind::TEMP) {
+                        LatticeValue bottom;
+                        bottom.state = LatticeValue::State::BOTTOM;
+                        lower(inst.dst, bottom);
+                    }
+                    break;
+            }
+        };
+
+        while (!flowWork.empty() || !ssaWork.empty()) {
+            if (!flowWork.empty()) {
+                auto edge = flowWork.back();
+                flowWork.pop_back();
+                size_t to = edge.second;
+                if (edge.first != SIZE_MAX && !executableEdges.insert(edge.first * n + to).second) {
+                    continue;
+                }
+                const auto &insts = function.blocks[to].instructions;
+                // Phis see a new incoming edge; the rest of the block only needs a first visit
+                for (size_t i = 0; i < insts.size() && (insts[i].opcode == Opcode::PHI || !executable[to]); ++i) {
+                    visit(to, i);
+                }
+                executable[to] = true;
+                continue;
+            }
+            auto use = ssaWork.back();
+            ssaWork.pop_back();
+            if (executable[use.first]) {
+                visit(use.first, use.second);
+            }
+        }
+
+        auto isConstant = [&](Value value) {
+            return values.contains(value) && values[value].state == LatticeValue::State::CONSTANT;
+        };
+        RegisterMap<Value> constants(function, Value());
+        for (auto &block : function.blocks) {
+            auto &insts = block.instructions;
+            insts.erase(std::remove_if(insts.begin(), insts.end(), [&](const Instruction &inst) {
+                if (!isConstant(inst.dst)) {
+                    return false;
+                }
+                constants[inst.dst] = Value::constant(values[inst.dst].value);
+                return !hasSideEffects(inst);
+            }), insts.end());
+        }
+        for (auto &block : function.blocks) {
+            auto &insts = block.instructions;
+            for (auto &inst : insts) {
+                forEachUse(inst, [&](Value &value) { value = resolve(constants, value); });
+            }
+        }
+        // Branches on conditions found constant become plain branches, and what they skip goes away
+        foldConstants(function);
+        simplifyPhis(function);
+        removeDeadCode(function);
+    }
+
+    /* Global value numbering */
+
+    // What an instruction computes: two instructions with equal expressions compute the same value
+    struct Expression {
+        Opcode opcode;
+        // The binaryOp, condition or castOp
+        int op;
+        ast::BuiltInType type;
+        ast::BuiltInType resultType;
+        Value lhs;
+        Value rhs;
+
+        bool operator==(const Expression &other) const {
+            return opcode == other.opcode && op == other.op && type == other.type && resultType == other.resultType
+                   && lhs == other.lhs && rhs == other.rhs;
+        }
+    };
+
+    struct ExpressionHash {
+        size_t operator()(const Expression &expression) const {
+            size_t hash = (size_t) expression.opcode;
+            for (size_t part : {(size_t) expression.op, (size_t) expression.type, (size_t) expression.resultType,
+                                (size_t) expression.lhs.kind, (size_t) (uint32_t) expression.lhs.id,
+                                (size_t) expression.rhs.kind, (size_t) (uint32_t) expression.rhs.id}) {
+                hash = hash * 1000003 ^ part;
+            }
+            return hash;
+        }
+    };
+
+    static bool precedes(Value a, Value b) {
+        return a.kind < b.kind || (a.kind == b.kind && a.id < b.id);
+    }
+
+    // The operands of commutative operations, and of compares (whose condition is mirrored), are put
+    // in a fixed order, so that a + b and b + a, or a < b and b > a, get the same expression
+    static Expression expressionOf(const Instruction &inst) {
+        Expression expression = {inst.opcode, 0, inst.type, inst.resultType, inst.lhs, inst.rhs};
+        bool swap = precedes(inst.rhs, inst.lhs);
+        if (inst.opcode == Opcode::BINARY) {
+            expression.op = (int) inst.binaryOp;
+            swap &= inst.binaryOp != BinaryOp::SUB && inst.binaryOp != BinaryOp::SDIV && inst.binaryOp != BinaryOp::UDIV;
+        } else if (inst.opcode == Opcode::COMPARE) {
+            Condition condition = inst.condition;
+            if (swap) {
+                switch (condition) {
+                    case Condition::SLT:
+                        condition = Condition::SGT;
+                        break;
+                    case Condition::SLE:
+                        condition = Condition::SGE;
+                        break;
+                    case Condition::SGT:
+                        condition = Condition::SLT;
+                        break;
+                    case Condition::SGE:
+                        condition = Condition::SLE;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            expression.op = (int) condition;
+        } else {
+            expression.op = (int) inst.castOp;
+            swap = false;
+        }
+        if (swap) {
+            std::swap(expression.lhs, expression.rhs);
+        }
+        return expression;
+    }
+
+    void numberValues(Function &function) {
+        dataflow::CFG cfg(function);
+        dataflow::DominatorTree tree(cfg);
+
+        // Expressions computed by the blocks dominating the current one, and the register holding each
+        std::unordered_map<Expression, Value, ExpressionHash> available;
+        RegisterMap<Value> replaced(function, Value());
+        // Conditions known to hold in the current block, from the branches that lead to it
+        RegisterMap<Value> known(function, Value());
+        bool conditionKnown = false;
+
+        // (block, next child to visit, expressions and conditions added in the block)
+        struct Frame {
+            size_t block;
+            size_t child;
+            std::vector<Expression> added;
+            Value condition;
+        };
+        std::vector<Frame> stack;
+        stack.push_back({0, 0, {}, Value()});
+        bool entering = true;
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (entering) {
+                // A block whose only way in is one arm of a conditional branch knows the condition
+                const auto &predecessors = cfg.predecessors[frame.block];
+                if (predecessors.size() == 1) {
+                    const Instruction &branch = function.blocks[predecessors[0]].instructions.back();
+                    if (branch.opcode == Opcode::COND_BR && branch.lhs.kind == Value::Kind::TEMP
+                        && branch.target.id != branch.otherTarget.id && known.contains(branch.lhs)) {
+                        frame.condition = branch.lhs;
+                        known[branch.lhs] = Value::constant(branch.target.id == function.blocks[frame.block].label.id);
+                    }
+                }
+
+                auto &insts = function.blocks[frame.block].instructions;
+                size_t kept = 0;
+                for (size_t i = 0; i < insts.size(); ++i) {
+                    Instruction &inst = insts[i];
+                    bool phi = inst.opcode == Opcode::PHI;
+                    forEachUse(inst, [&](Value &value) {
+                        value = resolve(replaced, value);
+                        // A phi reads its operands at the end of its predecessors, not here
+                        if (!phi && known.contains(value) && known[value].kind != Value::Kind::NONE) {
+                            value = known[value];
+                            conditionKnown = true;
+                        }
+                    });
+                    if (inst.opcode == Opcode::BINARY || inst.opcode == Opcode::COMPARE || inst.opcode == Opcode::CAST) {
+                        Expression expression = expressionOf(inst);
+                        auto found = available.find(expression);
+                        if (found != available.end()) {
+                            replaced[inst.dst] = found->second;
+                            continue;
+                        }
+                        available.emplace(expression, inst.dst);
+                        frame.added.push_back(expression);
+                    }
+                    if (kept != i) {
+                        insts[kept] = std::move(inst);
+                    }
+                    ++kept;
+                }
+                insts.erase(insts.begin() + kept, insts.end());
+            }
+            if (frame.child < tree.children[frame.block].size()) {
+                size_t child = tree.children[frame.block][frame.child++];
+                stack.push_back({child, 0, {}, Value()});
+                entering = true;
+                continue;
+            }
+            for (const auto &expression : frame.added) {
+                available.erase(expression);
+            }
+            if (frame.condition.kind != Value::Kind::NONE) {
+                known[frame.condition] = Value();
+            }
+            stack.pop_back();
+            entering = false;
+        }
+
+        // Phis on back edges may read registers replaced after their block was visited
+        for (auto &block : function.blocks) {
+            for (auto &inst : block.instructions) {
+                forEachUse(inst, [&](Value &value) { value = resolve(replaced, value); });
+            }
+        }
+        if (conditionKnown) {
+            // Branches on known conditions, like the second division by zero check of the same divisor
+            foldConstants(function);
+            simplifyPhis(function);
+            removeDeadCode(function);
+        }
+    }
+
+    void propagateArguments(std::vector<Function> &functions) {
+        std::unordered_map<int, size_t> indexOf;
+        for (size_t i = 0; i < functions.size(); ++i) {
+            indexOf[functions[i].id] = i;
+        }
+        // Number of calls to each function, by caller
+        std::vector<std::unordered_map<size_t, size_t>> callers(functions.size());
+        auto countCalls = [&](size_t caller, int delta, std::vector<size_t> &callees) {
+            for (const auto &block : functions[caller].blocks) {
+                for (const auto &inst : block.instructions) {
+                    auto found = inst.opcode == Opcode::CALL ? indexOf.find(inst.callee) : indexOf.end();
+                    if (found == indexOf.end()) {
+                        continue;
+                    }
+                    size_t &count = callers[found->second][caller];
+                    count += delta;
+                    if (count == 0) {
+                        callers[found->second].erase(caller);
+                    }
+                    callees.push_back(found->second);
+                }
+            }
+        };
+        std::vector<size_t> worklist;
+        for (size_t i = 0; i < functions.size(); ++i) {
+            countCalls(i, 1, worklist);
+        }
+
+        // Parameters already replaced, so that every parameter is specialized at most once
+        std::vector<std::vector<bool>> done(functions.size());
+        for (size_t i = 0; i < functions.size(); ++i) {
+            done[i].assign(functions[i].paramTypes.size(), false);
+        }
+        while (!worklist.empty()) {
+            size_t callee = worklist.back();
+            worklist.pop_back();
+            if (callers[callee].size() != 1 || callers[callee].begin()->second != 1) {
+                continue;
+            }
+            size_t caller = callers[callee].begin()->first;
+            if (caller == callee) {
+                continue;
+            }
+            const Instruction *call = nullptr;
+            for (const auto &block : functions[caller].blocks) {
+                for (const auto &inst : block.instructions) {
+                    if (inst.opcode == Opcode::CALL && inst.callee == functions[callee].id) {
+                        call = &inst;
+                    }
+                }
+            }
+            std::unordered_map<int, Value> arguments;
+            for (size_t i = 0; i < call->args.size(); ++i) {
+                if (call->args[i].value.isConst() && !done[callee][i]) {
+                    arguments[(int) i] = call->args[i].value;
+                    done[callee][i] = true;
+                }
+            }
+            if (arguments.empty()) {
+                continue;
+            }
+
+            Function &function = functions[callee];
+            for (auto &block : function.blocks) {
+                for (auto &inst : block.instructions) {
+                    forEachUse(inst, [&](Value &value) {
+                        auto found = value.kind == Value::Kind::ARG ? arguments.find(value.id) : arguments.end();
+                        if (found != arguments.end()) {
+                            value = found->second;
+                        }
+                    });
+                }
+            }
+            // The calls the function makes may have lost arguments or become dead
+            std::vector<size_t> callees;
+            countCalls(callee, -1, callees);
+            propagateConstants(function);
+            countCalls(callee, 1, callees);
+            worklist.insert(worklist.end(), callees.begin(), callees.end());
+        }
+    }
+
+    // Adds the passes -O runs over each function, in order
+    static void addFunctionPasses(PassManager &passes, const std::shared_ptr<Inliner> &inliner) {
+        passes.add("inline", [inliner](Function &function) { inliner->run(function); });
+        passes.add("tail-recursion", eliminateTailRecursion);
+        passes.add("fold-constants", foldConstants);
+        passes.add("ranges", simplifyWithRanges);
+        passes.add("licm", hoistLoopInvariants);
+        // Remembered after folding, so inlined copies start out folded, and before mem2reg, since
+        // the inliner works on variables kept in memory
+        passes.add("inline-candidates", [inliner](Function &function) { inliner->remember(function); });
+        passes.add("mem2reg", promoteToRegisters);
+        passes.add("sccp", propagateConstants);
+        passes.add("gvn", numberValues);
+    }
+
+    void addOptimizationPasses(PassManager &passes, bool wholeProgram) {
+        auto inliner = std::make_shared<Inliner>();
+        if (!wholeProgram) {
+            addFunctionPasses(passes, inliner);
+            return;
+        }
+        // Callees are optimized before their callers, so that by the time a function is inlined
+        // into, every callee that is not in a cycle with it is a candidate, wherever it is defined
+        auto functionPasses = std::make_shared<PassManager>();
+        addFunctionPasses(*functionPasses, inliner);
+        passes.addModulePass("optimize", [inliner, functionPasses](std::vector<Function> &functions) {
+            for (size_t i : inliner->callGraphOrder(functions)) {
+                timing::Scope codegen(timing::Phase::CODEGEN, functions[i].name);
+                functionPasses->run(functions[i]);
+            }
+        });
+        passes.addModulePass("propagate-arguments", propagateArguments);
+    }
+}
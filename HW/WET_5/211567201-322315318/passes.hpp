@@ -0,0 +1,121 @@
+#ifndef PASSES_HPP
+#define PASSES_HPP
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "ir.hpp"
+
+namespace ir {
+
+    /* Inlines calls to small functions.
+     * The candidates are the functions this pass has already seen: after a function is processed
+     * it is remembered if it is small enough and in no cycle of the call graph. Recursion, mutual
+     * recursion included, is therefore never unrolled, and a remembered body already has its own
+     * calls inlined.
+     * With the whole program, callGraphOrder() gives the order to process the functions in
+     * (callees first) and which of them are in no cycle. Otherwise functions come in program order,
+     * and since a cycle through a later function cannot be ruled out, only functions whose calls
+     * all go to acyclic functions seen before count as acyclic.
+     */
+    class Inliner {
+    public:
+        // Largest callee inlined, in instructions (allocas not counted)
+        static const size_t CALLEE_BUDGET = 40;
+        // Largest number of instructions inlining may add to a single caller
+        static const size_t CALLER_BUDGET = 2000;
+
+        // Inlines the calls to remembered functions
+        void run(Function &function);
+
+        // Makes the function a candidate for later callers if it is small and in no cycle
+        void remember(const Function &function);
+
+        // Computes the strongly connected components of the program's call graph. Returns the
+        // indexes of the functions bottom-up: a component comes after the components it calls
+        // into. The functions alone in their component and not calling themselves become acyclic
+        std::vector<size_t> callGraphOrder(const std::vector<Function> &functions);
+
+    private:
+        struct Candidate {
+            Function body;
+            // Range of the registers and labels used by the body, renamed at each inlined copy
+            int firstTemp;
+            int lastTemp;
+            int firstLabel;
+            int lastLabel;
+            // For each parameter, the alloca it is stored into if the body never assigns it again
+            // (its loads are then replaced by the argument itself), or Kind::NONE
+            std::vector<output::Value> formalSlots;
+        };
+
+        // By function id
+        std::unordered_map<int, Candidate> candidates;
+        // Ids of the functions known to be in no cycle of the call graph
+        std::unordered_set<int> acyclic;
+    };
+
+    // Turns self-recursive calls in tail position (a return of the call's result) into a jump back
+    // to the start of the function, with the arguments stored into the parameters' variables.
+    // Works on variables in memory, so it runs before mem2reg, which then makes the loop SSA
+    void eliminateTailRecursion(Function &function);
+
+    // Marks the calls in tail position for LLVM: musttail when the callee has the caller's
+    // prototype (which guarantees the frame is reused), tail otherwise. A call whose result
+    // reaches the return only through branches and phis, as an inlined body leaves it, is made to
+    // return directly first. Runs after every other pass, since moving the call away from its
+    // return would make a musttail call invalid
+    void markTailCalls(Function &function);
+
+    // Removes the blocks the entry block cannot reach, and the phi entries for them
+    void removeUnreachableBlocks(Function &function);
+
+    // Evaluates instructions whose operands are all constants, turns conditional branches on a
+    // constant into plain branches and removes the blocks that become unreachable
+    void foldConstants(Function &function);
+
+    // Moves computations that give the same result on every iteration of a loop (loads of variables
+    // the loop never stores to, and arithmetic, compares and casts on loop-invariant operands) into
+    // the block that enters the loop. Loops are found from their back edges: FanC code is structured,
+    // so a loop is laid out as the blocks from its header to the last block that branches back to it
+    void hoistLoopInvariants(Function &function);
+
+    // Runs the interval analysis (dataflow::IntervalAnalysis) and replaces the compares it decides
+    // by constants, then folds: division by zero checks on divisors that cannot be zero, and
+    // branches that always go the same way, disappear
+    void simplifyWithRanges(Function &function);
+
+    // Reports on stderr the arithmetic that overflows its type whatever the inputs
+    void warnOverflow(Function &function);
+
+    // Puts the function in SSA form (mem2reg): variables become registers, joined by phis at the
+    // iterated dominance frontier of their stores, and their allocas, loads and stores go away
+    void promoteToRegisters(Function &function);
+
+    // Removes the side-effect-free instructions whose results nothing with side effects depends on
+    void removeDeadCode(Function &function);
+
+    // Sparse conditional constant propagation (Wegman and Zadeck) over the SSA form: finds the
+    // registers that hold a single constant on every path the function can actually take, assuming
+    // branches on constants only go one way, then removes the code those branches skip (if arms
+    // never taken, while loops whose condition is false on entry) and the dead code left behind
+    void propagateConstants(Function &function);
+
+    // Global value numbering over the SSA form: an arithmetic, compare or cast instruction computing
+    // the same thing as one in a dominating block (or earlier in the same block) is replaced by it.
+    // Commutative operands and mirrored compares are matched. Blocks reached only through one arm
+    // of a conditional branch also know its condition, so that a repeated check (the division by
+    // zero check of a divisor already checked) folds away
+    void numberValues(Function &function);
+
+    // Passes constant arguments into functions that are called from a single place, and propagates
+    // constants again in them (which may in turn make the arguments of their own calls constant)
+    void propagateArguments(std::vector<Function> &functions);
+
+    // Adds the optimization pipeline (enabled by -O) to the pass manager. For a wholeProgram
+    // compilation it is a module pass, which optimizes the functions bottom-up in the call graph,
+    // followed by the passes that need every function at once
+    void addOptimizationPasses(PassManager &passes, bool wholeProgram);
+}
+
+#endif //PASSES_HPP
@@ -1,69 +1,75 @@
 #include "semantic.hpp"
+#include "x86.hpp"
 #include <iostream>
-SemanticVisitor::SemanticVisitor(output::CodeBuffer &buffer) : whileDepth(0), currentFunctionName(""),codeBuffer(buffer) {
+#include <unistd.h>
+SemanticVisitor::SemanticVisitor(output::CodeBuffer &buffer) : whileDepth(0), hasMain(false), currentFunctionName(""),codeBuffer(buffer) {
     emitRuntimeHelperFunctions();
 }
 
-std::string SemanticVisitor::getLLVMType(ast::BuiltInType type) {
-    switch (type) {
-        case ast::BuiltInType::INT:
-            return "i32";
-        case ast::BuiltInType::BYTE:
-            return "i8";
-        case ast::BuiltInType::BOOL:
-            return "i1";
-        case ast::BuiltInType::STRING:
-            return "i8*";
-        case ast::BuiltInType::VOID:
-            return "void";
-        default:
-            throw std::runtime_error("Unknown type");
-    }
+std::string_view SemanticVisitor::getLLVMType(ast::BuiltInType type) {
+    return ir::llvmType(type);
 }
 
-std::string SemanticVisitor::emitBinaryOperation(const std::string &left, const std::string &right, const std::string &op, ast::BuiltInType type) {
-    std::string resultVar = codeBuffer.freshVar();
-    codeBuffer.emit(resultVar + " = " + op + " " + getLLVMType(type) + " " + left + ", " + right);
+output::Value SemanticVisitor::emitBinaryOperation(output::Value left, output::Value right, output::BinaryOp op, ast::BuiltInType type) {
+    output::Value resultVar = codeBuffer.freshVar();
+    codeBuffer.emitBinary(resultVar, op, type, left, right);
     return resultVar;
 } 
 
+void SemanticVisitor::coerce(ast::Node &exp, ast::BuiltInType to) {
+    exp.llvmValue = codeBuffer.emitConversion(exp.llvmValue, exp.type, to);
+    exp.type = to;
+}
+
 void SemanticVisitor::emitRuntimeHelperFunctions() {
+    if (codeBuffer.getTarget() == output::Target::X86_64) {
+        // The assembly brings its own runtime instead of linking the C library
+        codeBuffer.emit(x86::RUNTIME);
+        return;
+    }
+
     // Declare external functions
     codeBuffer.emit("declare void @print_error_message()");
     codeBuffer.emit("declare void @exit(i32)");
     codeBuffer.emit("declare i32 @printf(i8*, ...)");
 
-    // Declare constants for format specifiers
-    codeBuffer.emit("@.int_specifier = constant [4 x i8] c\"%d\\0A\\00\"");
-    codeBuffer.emit("@.str_specifier = constant [4 x i8] c\"%s\\0A\\00\"");
+    if (codeBuffer.getRuntimeMode() == output::RuntimeMode::EXTERNAL) {
+        // The linked runtime defines the helpers and their format specifiers
+        codeBuffer.emit("declare void @printi(i32)");
+        codeBuffer.emit("declare void @print(i8*)");
+    } else {
+        // Declare constants for format specifiers
+        codeBuffer.emit("@.int_specifier = constant [4 x i8] c\"%d\\0A\\00\"");
+        codeBuffer.emit("@.str_specifier = constant [4 x i8] c\"%s\\0A\\00\"");
+    }
+
+    if (codeBuffer.getRuntimeMode() == output::RuntimeMode::HELPERS) {
+        codeBuffer.emit("define internal void @printi(i32 %value) alwaysinline {");
+        codeBuffer.emit("call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.int_specifier, i32 0, i32 0), i32 %value)");
+        codeBuffer.emit("ret void");
+        codeBuffer.emit("}");
+        codeBuffer.emit("define internal void @print(i8* %str) alwaysinline {");
+        codeBuffer.emit("call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str_specifier, i32 0, i32 0), i8* %str)");
+        codeBuffer.emit("ret void");
+        codeBuffer.emit("}");
+    }
 
     codeBuffer.emit("@.div_zero_msg = constant [24 x i8] c\"Error division by zero\\0A\\00\"");
 }
 
 
-// Map to convert BuiltInType to string
-static const std::map<ast::BuiltInType, std::string> typeToString = {
-    {ast::BuiltInType::VOID, "void"},
-    {ast::BuiltInType::BOOL, "bool"},
-    {ast::BuiltInType::BYTE, "byte"},
-    {ast::BuiltInType::INT, "int"},
-    {ast::BuiltInType::STRING, "string"}
-};
-
-static const std::map<std::string, ast::BuiltInType> stringToType = {
-    {"void", ast::BuiltInType::VOID},
-    {"bool", ast::BuiltInType::BOOL},
-    {"byte", ast::BuiltInType::BYTE},
-    {"int", ast::BuiltInType::INT},
-    {"string", ast::BuiltInType::STRING}
-};
-
-
-
+// Builds the expected parameter list only once the error is actually reported
+static void errorPrototypeMismatch(int line, const std::string &name, const std::vector<ast::BuiltInType> &formals) {
+    std::vector<std::string> expectedParamTypes;
+    for (const auto &type : formals) {
+        expectedParamTypes.emplace_back(ast::typeName(type));
+    }
+    output::errorPrototypeMismatch(line, name, expectedParamTypes);
+}
 
 void SemanticVisitor::visit(ast::Num &node) {
     node.type = ast::BuiltInType::INT;
-    node.llvmValue = std::to_string(node.value);
+    node.llvmValue = output::Value::constant(node.value);
 }
 
 void SemanticVisitor::visit(ast::NumB &node) {
@@ -71,18 +77,17 @@ void SemanticVisitor::visit(ast::NumB &node) {
         output::errorByteTooLarge(node.line, node.value);
     }
     node.type = ast::BuiltInType::BYTE;
-    node.llvmValue = std::to_string(node.value);
+    node.llvmValue = output::Value::constant(node.value);
 }
 
 void SemanticVisitor::visit(ast::String &node) {
     node.type = ast::BuiltInType::STRING;
-    node.llvmValue = node.value;
 
 }
 
 void SemanticVisitor::visit(ast::Bool &node) {
     node.type = ast::BuiltInType::BOOL;
-    node.llvmValue = node.value ? "1" : "0";
+    node.llvmValue = output::Value::constant(node.value ? 1 : 0);
 }
 
 void SemanticVisitor::visit(ast::ID &node) {
@@ -91,14 +96,13 @@ void SemanticVisitor::visit(ast::ID &node) {
         output::errorUndef(node.line, node.value);
     }
     node.type = symbol->getType();
-    node.llvmValue = symbol->getEmittedName(); // the register name
+    node.offset = symbol->getOffset();
 
     if (!symbol->isFunctionSymbol()) {
-        string resultVar = codeBuffer.freshVar();
-        if(node.llvmValue[1] == 't') {
-            codeBuffer.emit(resultVar + " = load " + getLLVMType(node.type) + ", " + getLLVMType(node.type) + "* " + node.llvmValue);
-            node.llvmValue = resultVar;
-        }
+        // Variables live in stack slots
+        output::Value resultVar = codeBuffer.freshVar();
+        codeBuffer.emitLoad(resultVar, node.type, symbol->getEmittedValue());
+        node.llvmValue = resultVar;
     }
 }
 
@@ -112,47 +116,40 @@ void SemanticVisitor::visit(ast::BinOp &node) {
         node.type = ast::BuiltInType::BYTE;
     } else if (node.left->type == ast::BuiltInType::INT && node.right->type == ast::BuiltInType::BYTE) {
         node.type = ast::BuiltInType::INT;
-        //convert byte to int
-        string new_reg = codeBuffer.freshVar();
-        codeBuffer.emit(new_reg + " = zext i8 " + node.right->llvmValue + " to i32");
-        node.right->llvmValue = new_reg;
+        coerce(*node.right, ast::BuiltInType::INT);
     } else if (node.left->type == ast::BuiltInType::BYTE && node.right->type == ast::BuiltInType::INT) {
         node.type = ast::BuiltInType::INT;
-        //convert byte to int
-        string new_reg = codeBuffer.freshVar();
-        codeBuffer.emit(new_reg + " = zext i8 " + node.left->llvmValue + " to i32");
-        node.left->llvmValue = new_reg;
+        coerce(*node.left, ast::BuiltInType::INT);
     } else { 
         output::errorMismatch(node.line);
     }
 
-    string resultVar;
-    
+    output::Value resultVar;
+    codeBuffer.setLine(node.line);
+
     switch (node.op) {
         case ast::BinOpType::ADD:
-            resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, "add", node.type);
+            resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, output::BinaryOp::ADD, node.type);
             break;
         case ast::BinOpType::SUB:
-            resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, "sub", node.type);
+            resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, output::BinaryOp::SUB, node.type);
             break;
         case ast::BinOpType::MUL:
-            resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, "mul", node.type);
+            resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, output::BinaryOp::MUL, node.type);
             break;
         case ast::BinOpType::DIV: {
-            std::string isZeroCheck = codeBuffer.freshVar();
-            std::string errorLabel = codeBuffer.freshLabel();
-            std::string continueLabel = codeBuffer.freshLabel();
+            output::Value isZeroCheck = codeBuffer.freshVar();
+            output::Label errorLabel = codeBuffer.freshLabel();
+            output::Label continueLabel = codeBuffer.freshLabel();
             
             //check div by zero
-            codeBuffer.emit(isZeroCheck + " = icmp eq "+getLLVMType(node.type)+" " + node.right->llvmValue + ", 0");
-            codeBuffer.emit("br i1 " + isZeroCheck + ", label " + errorLabel + ", label " + continueLabel);
+            codeBuffer.emitCompare(isZeroCheck, output::Condition::EQ, node.type, node.right->llvmValue, output::Value::constant(0));
+            codeBuffer.emitCondBr(isZeroCheck, errorLabel, continueLabel);
             codeBuffer.emitLabel(errorLabel);
-            codeBuffer.emit("call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([24 x i8], [24 x i8]* @.div_zero_msg, i32 0, i32 0))");
-            codeBuffer.emit("call void @exit(i32 1)");
-            codeBuffer.emit("br label " + continueLabel);
+            codeBuffer.emitDivisionByZeroError();
 
             codeBuffer.emitLabel(continueLabel);
-            std::string divOp = (node.type == ast::BuiltInType::INT) ? "sdiv" : "udiv";
+            output::BinaryOp divOp = (node.type == ast::BuiltInType::INT) ? output::BinaryOp::SDIV : output::BinaryOp::UDIV;
             resultVar = emitBinaryOperation(node.left->llvmValue, node.right->llvmValue, divOp, node.type);
             break;
         }
@@ -174,51 +171,47 @@ void SemanticVisitor::visit(ast::RelOp &node) {
     }
 
     node.type = ast::BuiltInType::BOOL;
-    std::string leftValue = node.left->llvmValue;
-    std::string rightValue = node.right->llvmValue;
 
-    if (node.left->type == ast::BuiltInType::BYTE && node.right->type == ast::BuiltInType::INT) {
-        std::string extendedLeft = codeBuffer.freshVar();
-        codeBuffer.emit(extendedLeft + " = zext i8 " + leftValue + " to i32");
-        leftValue = extendedLeft;
-    } else if (node.left->type == ast::BuiltInType::INT && node.right->type == ast::BuiltInType::BYTE) {
-        std::string extendedRight = codeBuffer.freshVar();
-        codeBuffer.emit(extendedRight + " = zext i8 " + rightValue + " to i32");
-        rightValue = extendedRight;
+    // Compare in the wider of the two types
+    if (node.left->type != node.right->type) {
+        coerce(*node.left, ast::BuiltInType::INT);
+        coerce(*node.right, ast::BuiltInType::INT);
     }
+    output::Value leftValue = node.left->llvmValue;
+    output::Value rightValue = node.right->llvmValue;
 
     
-    std::string op;
+    output::Condition op;
     switch (node.op) {
         case ast::RelOpType::EQ:
-            op = "eq";
+            op = output::Condition::EQ;
             break;
         case ast::RelOpType::NE:
-            op = "ne";
+            op = output::Condition::NE;
             break;
         case ast::RelOpType::LT:
-            op = "slt";
+            op = output::Condition::SLT;
             break;
         case ast::RelOpType::LE:
-            op = "sle";
+            op = output::Condition::SLE;
             break;
         case ast::RelOpType::GT:
-            op = "sgt";
+            op = output::Condition::SGT;
             break;
         case ast::RelOpType::GE:
-            op = "sge";
+            op = output::Condition::SGE;
             break;
         default:
             throw std::runtime_error("Unknown relational operation");
     }
-    std::string resultVar = codeBuffer.freshVar();
+    output::Value resultVar = codeBuffer.freshVar();
     if(node.left->type == ast::BuiltInType::BYTE && node.right->type == ast::BuiltInType::BYTE)
     {
-        codeBuffer.emit(resultVar + " = icmp " + op + " i8 " + leftValue + ", " + rightValue);
+        codeBuffer.emitCompare(resultVar, op, ast::BuiltInType::BYTE, leftValue, rightValue);
     }
     else
     {
-        codeBuffer.emit(resultVar + " = icmp " + op + " i32 " + leftValue + ", " + rightValue);
+        codeBuffer.emitCompare(resultVar, op, ast::BuiltInType::INT, leftValue, rightValue);
     }
     
     node.llvmValue = resultVar;
@@ -234,21 +227,21 @@ void SemanticVisitor::visit(ast::Not &node) {
         output::errorMismatch(node.line);
     }
 
-    string resultVar = codeBuffer.freshVar();
-    codeBuffer.emit(resultVar + " = xor i1 1, " + node.exp->llvmValue);
+    output::Value resultVar = codeBuffer.freshVar();
+    codeBuffer.emitBinary(resultVar, output::BinaryOp::XOR, ast::BuiltInType::BOOL, output::Value::constant(1), node.exp->llvmValue);
     node.llvmValue = resultVar;
 }
 
 void SemanticVisitor::visit(ast::And &node) {
     // THIS WORKS
-    string trueLabel = codeBuffer.freshLabel();
-    string falseLabel = codeBuffer.freshLabel();
-    string endLabel = codeBuffer.freshLabel();
+    output::Label trueLabel = codeBuffer.freshLabel();
+    output::Label falseLabel = codeBuffer.freshLabel();
+    output::Label endLabel = codeBuffer.freshLabel();
 
-    string reg = codeBuffer.freshVar();
-    string in_memmory = codeBuffer.freshVar();
-    codeBuffer.emit(in_memmory + " = alloca i1");
-    codeBuffer.emit("store i1 0 , i1* " + in_memmory);
+    output::Value reg = codeBuffer.freshVar();
+    output::Value in_memmory = codeBuffer.freshVar();
+    codeBuffer.emitAlloca(in_memmory, ast::BuiltInType::BOOL);
+    codeBuffer.emitStore(ast::BuiltInType::BOOL, output::Value::constant(0), in_memmory);
 
     node.left->accept(*this);
     if(node.left->type != ast::BuiltInType::BOOL) {
@@ -256,39 +249,39 @@ void SemanticVisitor::visit(ast::And &node) {
     }
     node.type = ast::BuiltInType::BOOL;
 
-    codeBuffer.emit("br i1 " + node.left->llvmValue + ", label " + trueLabel + ", label " + falseLabel);
+    codeBuffer.emitCondBr(node.left->llvmValue, trueLabel, falseLabel);
 
     codeBuffer.emitLabel(trueLabel);
-    string true_reg = codeBuffer.freshVar();
+    output::Value true_reg = codeBuffer.freshVar();
     node.right->accept(*this);
     if(node.right->type != ast::BuiltInType::BOOL) {
         output::errorMismatch(node.line);
     }
-    codeBuffer.emit(true_reg + " = and i1 " + node.left->llvmValue + ", " + node.right->llvmValue);
-    codeBuffer.emit("store i1 " + true_reg + ", i1* " + in_memmory);
-    codeBuffer.emit("br label " + endLabel);
+    codeBuffer.emitBinary(true_reg, output::BinaryOp::AND, ast::BuiltInType::BOOL, node.left->llvmValue, node.right->llvmValue);
+    codeBuffer.emitStore(ast::BuiltInType::BOOL, true_reg, in_memmory);
+    codeBuffer.emitBr(endLabel);
 
     codeBuffer.emitLabel(falseLabel);
-    string false_reg = codeBuffer.freshVar();
-    codeBuffer.emit(false_reg + " = add i1 0, 0");
-    codeBuffer.emit("store i1 " + false_reg + ", i1* " + in_memmory);
-    codeBuffer.emit("br label " + endLabel);
+    output::Value false_reg = codeBuffer.freshVar();
+    codeBuffer.emitBinary(false_reg, output::BinaryOp::ADD, ast::BuiltInType::BOOL, output::Value::constant(0), output::Value::constant(0));
+    codeBuffer.emitStore(ast::BuiltInType::BOOL, false_reg, in_memmory);
+    codeBuffer.emitBr(endLabel);
 
     codeBuffer.emitLabel(endLabel);
-    codeBuffer.emit(reg + " = load i1, i1* " + in_memmory);
+    codeBuffer.emitLoad(reg, ast::BuiltInType::BOOL, in_memmory);
     node.llvmValue = reg;
 }
 
 void SemanticVisitor::visit(ast::Or &node) {
 
-    string trueLabel = codeBuffer.freshLabel();
-    string falseLabel = codeBuffer.freshLabel();
-    string endLabel = codeBuffer.freshLabel();
+    output::Label trueLabel = codeBuffer.freshLabel();
+    output::Label falseLabel = codeBuffer.freshLabel();
+    output::Label endLabel = codeBuffer.freshLabel();
 
-    string reg = codeBuffer.freshVar();
-    string in_memmory = codeBuffer.freshVar();
-    codeBuffer.emit(in_memmory + " = alloca i1");
-    codeBuffer.emit("store i1 0 , i1* " + in_memmory);
+    output::Value reg = codeBuffer.freshVar();
+    output::Value in_memmory = codeBuffer.freshVar();
+    codeBuffer.emitAlloca(in_memmory, ast::BuiltInType::BOOL);
+    codeBuffer.emitStore(ast::BuiltInType::BOOL, output::Value::constant(0), in_memmory);
 
     node.left->accept(*this);
     if(node.left->type != ast::BuiltInType::BOOL) {
@@ -296,26 +289,26 @@ void SemanticVisitor::visit(ast::Or &node) {
     }
     node.type = ast::BuiltInType::BOOL;
 
-    codeBuffer.emit("br i1 " + node.left->llvmValue + ", label " + trueLabel + ", label " + falseLabel);
+    codeBuffer.emitCondBr(node.left->llvmValue, trueLabel, falseLabel);
 
     codeBuffer.emitLabel(falseLabel);
-    string false_reg = codeBuffer.freshVar();
+    output::Value false_reg = codeBuffer.freshVar();
     node.right->accept(*this);
     if(node.right->type != ast::BuiltInType::BOOL) {
         output::errorMismatch(node.line);
     }
-    codeBuffer.emit(false_reg + " = or i1 " + node.left->llvmValue + ", " + node.right->llvmValue);
-    codeBuffer.emit("store i1 " + false_reg + ", i1* " + in_memmory);
-    codeBuffer.emit("br label " + endLabel);
+    codeBuffer.emitBinary(false_reg, output::BinaryOp::OR, ast::BuiltInType::BOOL, node.left->llvmValue, node.right->llvmValue);
+    codeBuffer.emitStore(ast::BuiltInType::BOOL, false_reg, in_memmory);
+    codeBuffer.emitBr(endLabel);
 
     codeBuffer.emitLabel(trueLabel);
-    string true_reg = codeBuffer.freshVar();
-    codeBuffer.emit(true_reg + " = add i1 1, 0");
-    codeBuffer.emit("store i1 " + true_reg + ", i1* " + in_memmory);
-    codeBuffer.emit("br label " + endLabel);
+    output::Value true_reg = codeBuffer.freshVar();
+    codeBuffer.emitBinary(true_reg, output::BinaryOp::ADD, ast::BuiltInType::BOOL, output::Value::constant(1), output::Value::constant(0));
+    codeBuffer.emitStore(ast::BuiltInType::BOOL, true_reg, in_memmory);
+    codeBuffer.emitBr(endLabel);
 
     codeBuffer.emitLabel(endLabel);
-    codeBuffer.emit(reg + " = load i1, i1* " + in_memmory);
+    codeBuffer.emitLoad(reg, ast::BuiltInType::BOOL, in_memmory);
     node.llvmValue = reg;
 
 }
@@ -327,8 +320,8 @@ void SemanticVisitor::visit(ast::Type &node) {
 void SemanticVisitor::visit(ast::Cast &node) {
     node.exp->accept(*this);
 
-    std::string sourceType = getLLVMType(node.exp->type);
-    std::string targetType = getLLVMType(node.target_type->type);
+    ast::BuiltInType sourceType = node.exp->type;
+    ast::BuiltInType targetType = node.target_type->type;
     //
     if(node.exp->type != node.target_type->type)
     {
@@ -339,20 +332,7 @@ void SemanticVisitor::visit(ast::Cast &node) {
             output::errorMismatch(node.line);
         }
 
-        std::string resultVar = codeBuffer.freshVar();
-
-        if (sourceType == "i8" && targetType == "i32") {
-            if (node.exp->type == ast::BuiltInType::BYTE) {
-                codeBuffer.emit(resultVar + " = zext i8 " + node.exp->llvmValue + " to i32");
-            } else {
-                codeBuffer.emit(resultVar + " = sext i8 " + node.exp->llvmValue + " to i32");
-            }
-        } else if (sourceType == "i32" && targetType == "i8") {
-            codeBuffer.emit(resultVar + " = trunc i32 " + node.exp->llvmValue + " to i8");
-        } else {
-            throw std::runtime_error("Unsupported cast from " + sourceType + " to " + targetType);
-        }
-        node.llvmValue = resultVar;
+        node.llvmValue = codeBuffer.emitConversion(node.exp->llvmValue, sourceType, targetType);
     } else {
         node.type = node.target_type->type;
         node.llvmValue = node.exp->llvmValue;
@@ -379,36 +359,27 @@ void SemanticVisitor::visit(ast::Call &node) {
     }
 
     const auto &formals = function->getFormalsTypes();
-    std::vector<std::string> expectedParamTypes;
-    for (const auto &type : formals) {
-        std::string upperCaseType = typeToString.at(type);
-        std::transform(upperCaseType.begin(), upperCaseType.end(), upperCaseType.begin(), ::toupper);
-        expectedParamTypes.push_back(upperCaseType);
-    }
     if (formals.size() != node.args->exps.size()) {
-        output::errorPrototypeMismatch(node.line, node.func_id->value, expectedParamTypes);
+        errorPrototypeMismatch(node.line, node.func_id->value, formals);
     }
+    bool isPrint = node.func_id->value == "print";
+    bool isPrinti = node.func_id->value == "printi";
 
     for (size_t i = 0; i < node.args->exps.size(); ++i) {
         node.args->exps[i]->accept(*this); 
         // Disallow string arguments for non-print functions   
-        if (node.func_id->value == "print") {
+        if (isPrint) {
             if (node.args->exps[i]->type != ast::BuiltInType::STRING) {
-                std::vector<std::string> expectedParamTypes = {"STRING"};
-                output::errorPrototypeMismatch(node.line, "print", expectedParamTypes);
+                errorPrototypeMismatch(node.line, "print", formals);
             }
             continue; // Skip further checks for print
         }
         
-        if (node.func_id->value == "printi") {
+        if (isPrinti) {
             if (node.args->exps[i]->type == ast::BuiltInType::BYTE) {
-                std::string extendedVar = codeBuffer.freshVar();
-                codeBuffer.emit(extendedVar + " = zext i8 " +  node.args->exps[i]->llvmValue + " to i32");
-                //cout<< " 1 in call" << endl;
-                node.args->exps[i]->llvmValue = extendedVar;
+                coerce(*node.args->exps[i], ast::BuiltInType::INT);
             } else if (node.args->exps[i]->type != ast::BuiltInType::INT) {
-                std::vector<std::string> expectedParamTypes = {"INT"};
-                output::errorPrototypeMismatch(node.line, "printi", expectedParamTypes);
+                errorPrototypeMismatch(node.line, "printi", formals);
             }
             continue; // Skip further checks for printi
         }
@@ -419,58 +390,40 @@ void SemanticVisitor::visit(ast::Call &node) {
                     output::errorByteTooLarge(node.line, numNode->value);
                 }
             } 
-            std::string extendedVar = codeBuffer.freshVar();
-            codeBuffer.emit(extendedVar + " = trunc i32 " + node.args->exps[i]->llvmValue + " to i8");
-            node.args->exps[i]->llvmValue = extendedVar;
-            node.args->exps[i]->type = ast::BuiltInType::BYTE;
+            coerce(*node.args->exps[i], ast::BuiltInType::BYTE);
 
 
         } 
         if(formals[i] == ast::BuiltInType::INT && node.args->exps[i]->type == ast::BuiltInType::BYTE) {
-            std::string extendedVar = codeBuffer.freshVar();
-            codeBuffer.emit(extendedVar + " = zext i8 " + node.args->exps[i]->llvmValue + " to i32");
-            node.args->exps[i]->llvmValue = extendedVar;
-            node.args->exps[i]->type = ast::BuiltInType::INT;
+            coerce(*node.args->exps[i], ast::BuiltInType::INT);
         }
         else if (formals[i] != node.args->exps[i]->type) {
-            output::errorPrototypeMismatch(node.line, node.func_id->value,expectedParamTypes);
+            errorPrototypeMismatch(node.line, node.func_id->value, formals);
         }
     }
     node.type = function->getReturnType();
 
-    std::string emittedArgs;
-    for (size_t i = 0; i < node.args->exps.size(); ++i) {
-        auto &arg = node.args->exps[i];
-        emittedArgs += getLLVMType(arg->type) + " " + arg->llvmValue;
-        if (i != node.args->exps.size() - 1) {
-            emittedArgs += ", ";
-        }
-    }
-
-    std::string returnType = getLLVMType(node.type);
-    std::string resultVar;
-
-    if(node.func_id->value == "print") {
-        string ptrVar = codeBuffer.freshVar(); 
-        resultVar = codeBuffer.freshVar();
-        string strLen = to_string(node.args->exps[0]->llvmValue.length()+1);
-        string strVar = codeBuffer.emitString(node.args->exps[0]->llvmValue);
-        codeBuffer.emit(ptrVar + " = getelementptr [" + strLen + " x i8], [" + strLen + " x i8]* " + strVar + ", i32 0, i32 0");//need to fix last str
-        codeBuffer.emit(resultVar + " = call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str_specifier, i32 0, i32 0), i8* " + ptrVar + ")");
+    if(isPrint) {
+        // The only string expressions are literals
+        codeBuffer.emitPrintString(std::dynamic_pointer_cast<ast::String>(node.args->exps[0])->value);
         return;
-    } else if(node.func_id->value == "printi") {
-        resultVar = codeBuffer.freshVar();
-        codeBuffer.emit(resultVar + " = call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.int_specifier, i32 0, i32 0), i32 " + node.args->exps[0]->llvmValue + ")");
+    } else if(isPrinti) {
+        codeBuffer.emitPrintInt(node.args->exps[0]->llvmValue);
         return;
     }
 
-    if (returnType == "void") {
-        codeBuffer.emit("call void @" + node.func_id->value + "(" + emittedArgs + ")");
-    } else {
+    std::vector<output::Arg> emittedArgs;
+    emittedArgs.reserve(node.args->exps.size());
+    for (const auto &arg : node.args->exps) {
+        emittedArgs.push_back({arg->type, arg->llvmValue});
+    }
+
+    output::Value resultVar;
+    if (node.type != ast::BuiltInType::VOID) {
         resultVar = codeBuffer.freshVar();
-        codeBuffer.emit(resultVar + " = call " + returnType + " @" + node.func_id->value + "(" + emittedArgs + ")");
-        node.llvmValue = resultVar;
     }
+    codeBuffer.emitCall(resultVar, node.type, node.func_id->value, std::move(emittedArgs));
+    node.llvmValue = resultVar;
 }
 
 void SemanticVisitor::visit(ast::Statements &node) {  
@@ -486,7 +439,7 @@ void SemanticVisitor::visit(ast::Break &node) {
     if(whileDepth == 0) {
         output::errorUnexpectedBreak(node.line);
     } 
-    codeBuffer.emit("br label " + codeBuffer.getLoopEndLabel());
+    codeBuffer.emitBr(codeBuffer.getLoopEndLabel());
 
 }
 
@@ -494,7 +447,7 @@ void SemanticVisitor::visit(ast::Continue &node) {
     if(whileDepth == 0) {
         output::errorUnexpectedContinue(node.line);
     }
-    codeBuffer.emit("br label " + codeBuffer.getLoopStartLabel());
+    codeBuffer.emitBr(codeBuffer.getLoopStartLabel());
 }
 
 void SemanticVisitor::visit(ast::Return &node) { 
@@ -507,30 +460,26 @@ void SemanticVisitor::visit(ast::Return &node) {
 
     if (node.exp != nullptr) {
         node.exp->accept(*this);
-        std::string returnType = getLLVMType(expectedReturnType);
         
         if (node.exp->type != expectedReturnType) {
             if (!(node.exp->type == ast::BuiltInType::BYTE && expectedReturnType == ast::BuiltInType::INT)) {
                 output::errorMismatch(node.line);
             }
-            std::string mismatchReg = codeBuffer.freshVar();
-            codeBuffer.emit(mismatchReg + " = zext i8 " + node.exp->llvmValue + " to i32");
-            node.exp->llvmValue = mismatchReg;
-            node.exp->type = ast::BuiltInType::INT;
+            coerce(*node.exp, ast::BuiltInType::INT);
         }
-        codeBuffer.emit("ret " + returnType + " " + node.exp->llvmValue);
+        codeBuffer.emitRet(expectedReturnType, node.exp->llvmValue);
     } else {
         if (expectedReturnType != ast::BuiltInType::VOID) {
             output::errorMismatch(node.line);
         }
-        codeBuffer.emit("ret void");
+        codeBuffer.emitRetVoid();
     }
 }
 
 void SemanticVisitor::visit(ast::If &node) {
-    std::string trueLabel = codeBuffer.freshLabel();
-    std::string falseLabel = node.otherwise ? codeBuffer.freshLabel() : "";
-    std::string endLabel = codeBuffer.freshLabel();
+    output::Label trueLabel = codeBuffer.freshLabel();
+    output::Label falseLabel = node.otherwise ? codeBuffer.freshLabel() : output::Label();
+    output::Label endLabel = codeBuffer.freshLabel();
 
     node.condition->accept(*this);
 
@@ -541,16 +490,16 @@ void SemanticVisitor::visit(ast::If &node) {
     symbolTables.resetFunctionVarOffset();
 
     if(node.otherwise) { 
-        codeBuffer.emit("br i1 " + node.condition->llvmValue + ", label " + trueLabel + ", label " + falseLabel);
+        codeBuffer.emitCondBr(node.condition->llvmValue, trueLabel, falseLabel);
     } else {
-        codeBuffer.emit("br i1 " + node.condition->llvmValue + ", label " + trueLabel + ", label " + endLabel);
+        codeBuffer.emitCondBr(node.condition->llvmValue, trueLabel, endLabel);
     }
 
     codeBuffer.emitLabel(trueLabel);
 
     node.then->accept(*this);
 
-    codeBuffer.emit("br label " + endLabel);
+    codeBuffer.emitBr(endLabel);
 
     symbolTables.endScope();
     
@@ -563,7 +512,7 @@ void SemanticVisitor::visit(ast::If &node) {
         } else {
             node.otherwise->accept(*this);
         }
-        codeBuffer.emit("br label " + endLabel);
+        codeBuffer.emitBr(endLabel);
         symbolTables.endScope();
     }
     codeBuffer.emitLabel(endLabel);
@@ -571,15 +520,15 @@ void SemanticVisitor::visit(ast::If &node) {
 }
 
 void SemanticVisitor::visit(ast::While &node) {
-    std::string conditionLabel = codeBuffer.freshLabel();
-    std::string loopBodyLabel = codeBuffer.freshLabel();
-    std::string endLabel = codeBuffer.freshLabel();
+    output::Label conditionLabel = codeBuffer.freshLabel();
+    output::Label loopBodyLabel = codeBuffer.freshLabel();
+    output::Label endLabel = codeBuffer.freshLabel();
 
     ++whileDepth;
     codeBuffer.pushLoopLabels(conditionLabel, endLabel);
 
 
-    codeBuffer.emit("br label " + conditionLabel);
+    codeBuffer.emitBr(conditionLabel);
     codeBuffer.emitLabel(conditionLabel);
 
     node.condition->accept(*this);
@@ -588,7 +537,7 @@ void SemanticVisitor::visit(ast::While &node) {
         output::errorMismatch(node.condition->line);
     }
 
-    codeBuffer.emit("br i1 " + node.condition->llvmValue + ", label " + loopBodyLabel + ", label " + endLabel);
+    codeBuffer.emitCondBr(node.condition->llvmValue, loopBodyLabel, endLabel);
     codeBuffer.emitLabel(loopBodyLabel);
 
 
@@ -599,7 +548,7 @@ void SemanticVisitor::visit(ast::While &node) {
     
     symbolTables.endScope();
 
-    codeBuffer.emit("br label " + conditionLabel);
+    codeBuffer.emitBr(conditionLabel);
     codeBuffer.emitLabel(endLabel);
     codeBuffer.popLoopLabels();
 
@@ -616,11 +565,11 @@ void SemanticVisitor::visit(ast::VarDecl &node) {
         output::errorDefAsFunc(node.line, node.id->value);
     }
 
-    std::string type = getLLVMType(node.type->type);
-    std::string resultVar = codeBuffer.freshVar();
+    ast::BuiltInType type = node.type->type;
+    output::Value resultVar = codeBuffer.freshVar();
 
-    codeBuffer.emit(resultVar + " = alloca " + type);
-    std::string initialValue = "0";
+    codeBuffer.emitAlloca(resultVar, type);
+    output::Value initialValue = output::Value::constant(0);
 
     if(node.init_exp != nullptr) {
         node.init_exp->accept(*this);
@@ -632,23 +581,20 @@ void SemanticVisitor::visit(ast::VarDecl &node) {
                 output::errorUndef(idNode->line, idNode->value);
             }
         }
-        initialValue = node.init_exp->llvmValue;
-
         if(node.type->type != node.init_exp->type) {
-            //allow int to byte conversion
+            //allow byte to int conversion
             if (!(node.type->type == ast::BuiltInType::INT && node.init_exp->type == ast::BuiltInType::BYTE)) {
                 output::errorMismatch(node.line);
-            } else { // convert byte to int
-                std::string extendedVar = codeBuffer.freshVar();
-                codeBuffer.emit(extendedVar + " = zext i8 " + initialValue + " to i32");
-                initialValue = extendedVar;
             }
+            coerce(*node.init_exp, ast::BuiltInType::INT);
         }
+        initialValue = node.init_exp->llvmValue;
     }
 
 
-    codeBuffer.emit("store " + type + " " + initialValue + ", " + type + "* " + resultVar);
+    codeBuffer.emitStore(type, initialValue, resultVar);
 
+    node.id->offset = symbolTables.getFunctionVarOffset();
     symbolTables.insertSymbol(Sym(node.id->value, node.type->type, symbolTables.getFunctionVarOffset(), node.line, resultVar));
 }
 
@@ -663,6 +609,7 @@ void SemanticVisitor::visit(ast::Assign &node) {
     if (symbol->isFunctionSymbol()) {
         output::errorDefAsFunc(node.line, node.id->value);
     } 
+    node.id->offset = symbol->getOffset();
 
     
     if (auto idNode = std::dynamic_pointer_cast<ast::ID>(node.exp)) {
@@ -679,8 +626,7 @@ void SemanticVisitor::visit(ast::Assign &node) {
         }
     } 
 
-    std::string assignedValue = node.exp->llvmValue;
-    std::string leftReg = symbol->getEmittedName();
+    output::Value leftReg = symbol->getEmittedValue();
     
     if (symbol->getType() == ast::BuiltInType::INT && node.exp->type == ast::BuiltInType::BYTE) {
         if (auto numNode = std::dynamic_pointer_cast<ast::NumB>(node.exp)) {
@@ -688,13 +634,10 @@ void SemanticVisitor::visit(ast::Assign &node) {
                 output::errorByteTooLarge(node.line, numNode->value);
             }
         }
-        std::string extendedVar = codeBuffer.freshVar();
-        codeBuffer.emit(extendedVar + " = zext i8 " + assignedValue + " to i32");
-        assignedValue = extendedVar;
+        coerce(*node.exp, ast::BuiltInType::INT);
     }
 
-    std::string llvmType = getLLVMType(symbol->getType());
-    codeBuffer.emit("store " + llvmType + " " + assignedValue + ", " + llvmType + "* " + leftReg);
+    codeBuffer.emitStore(symbol->getType(), node.exp->llvmValue, leftReg);
 
 }
 
@@ -702,12 +645,8 @@ void SemanticVisitor::visit(ast::Formal &node) {
     if (symbolTables.isSymbolDefined(node.id->value)) {
         output::errorDef(node.line, node.id->value);
     }
-    Sym *symbol = symbolTables.getSymbol(node.id->value);
-    string reg = "%arg"+to_string(codeBuffer.getArgCount()); 
-
-    std::string type = getLLVMType(node.type->type);
-    codeBuffer<<type;
-    codeBuffer<< " "+reg;
+    // Parameters are numbered by position; FuncDecl stores them to stack slots right away
+    output::Value reg = output::Value::arg(-symbolTables.getFunctionParamOffset() - 1);
 
     symbolTables.insertSymbol(Sym(node.id->value, node.type->type, symbolTables.getFunctionParamOffset(), node.line, reg));
     symbolTables.decrementFunctionParamOffset();
@@ -715,41 +654,40 @@ void SemanticVisitor::visit(ast::Formal &node) {
 }
 
 void SemanticVisitor::visit(ast::Formals &node) {
-    size_t size = node.formals.size(); 
-    for (size_t i = 0; i < size; ++i) {
-        node.formals[i]->accept(*this);
-        if (i != size - 1) { 
-            codeBuffer << " ,";
-        }
+    for (auto &formal : node.formals) {
+        formal->accept(*this);
     }
 }
 
 void SemanticVisitor::visit(ast::FuncDecl &node) {
     currentFunctionName = node.id->value;
 
-    std::string returnType = getLLVMType(node.return_type->type);
+    ast::BuiltInType returnType = node.return_type->type;
 
     symbolTables.beginScope();
 
     symbolTables.resetFunctionParamOffset();
     symbolTables.resetFunctionVarOffset();
 
-    codeBuffer << "define " + returnType + " @" + currentFunctionName + "(" ;
+    std::vector<ast::BuiltInType> paramTypes;
+    for (auto &formal : node.formals->formals) {
+        paramTypes.push_back(formal->type->type);
+    }
+    codeBuffer.emitFunctionBegin(currentFunctionName, returnType, paramTypes);
     node.formals->accept(*this);
-    codeBuffer.emit(") {");
     
     //function aruments allocation
     for(auto &formal : node.formals->formals) {
-        std::string llvmType = getLLVMType(formal->type->type);
+        ast::BuiltInType type = formal->type->type;
         
-        std::string allocVar = codeBuffer.freshVar();
+        output::Value allocVar = codeBuffer.freshVar();
         
-        codeBuffer.emit(allocVar + " = alloca " + llvmType);
-        codeBuffer.emit("store " + llvmType + " " + formal->llvmValue + ", " + llvmType + "* " + allocVar);
+        codeBuffer.emitAlloca(allocVar, type);
+        codeBuffer.emitStore(type, formal->llvmValue, allocVar);
         formal->llvmValue = allocVar;
 
         Sym* symbol = symbolTables.getSymbol(formal->id->value);
-        symbol->setEmittedName(allocVar);
+        symbol->setEmittedValue(allocVar);
     }
 
     for(auto &statement : node.body->statements) {
@@ -758,43 +696,44 @@ void SemanticVisitor::visit(ast::FuncDecl &node) {
 
     symbolTables.endScope();
 
-    if (returnType == "void") {
-        codeBuffer.emit("ret void");
+    if (returnType == ast::BuiltInType::VOID) {
+        codeBuffer.emitRetVoid();
     }
     else {
-        codeBuffer.emit("ret " + returnType + " 0");
+        codeBuffer.emitRet(returnType, output::Value::constant(0));
     }
 
-    codeBuffer.emit("}");
+    codeBuffer.emitFunctionEnd();
     currentFunctionName = "";
 }
 
 
-void SemanticVisitor::visit(ast::Funcs &node) { 
-    bool hasMain = false;
+void SemanticVisitor::declareFunction(const std::string &name, ast::BuiltInType returnType,
+                                      const std::vector<ast::BuiltInType> &paramTypes, int line) {
+    if (name == "print" || name == "printi") {
+        return;  // Skip built-in functions
+    }
+    if (symbolTables.isFunctionDefined(name)) {
+        output::errorDef(line, name);
+    }
 
-    for (const auto &func : node.funcs) {
-        if (func->id->value == "print" || func->id->value == "printi") {
-            continue;  // Skip built-in functions
-        }
-        if (symbolTables.isFunctionDefined(func->id->value)) {
-            output::errorDef(func->id->line, func->id->value);
+    symbolTables.insertFunction(Sym(name, returnType, paramTypes, line));
+
+    if (name == "main") {
+        hasMain = true;
+        if (!paramTypes.empty() || returnType != ast::BuiltInType::VOID) {
+            output::errorMainMissing();
         }
+    }
+}
 
+void SemanticVisitor::visit(ast::Funcs &node) { 
+    for (const auto &func : node.funcs) {
         std::vector<ast::BuiltInType> paramTypes;
         for (const auto &formal : func->formals->formals) {
             paramTypes.push_back(formal->type->type);
         }
-
-        string FuncRegName = func->id->value;
-        symbolTables.insertFunction(Sym(func->id->value, func->return_type->type, paramTypes, func->line ,FuncRegName ));
-        
-        if (func->id->value == "main") {
-            hasMain = true;
-            if (!func->formals->formals.empty() || func->return_type->type != ast::BuiltInType::VOID) {
-                output::errorMainMissing();
-            }
-        }
+        declareFunction(func->id->value, func->return_type->type, paramTypes, func->id->line);
     }
 
     if (!hasMain) {
@@ -803,5 +742,5 @@ void SemanticVisitor::visit(ast::Funcs &node) {
     for (const auto &func : node.funcs) {
         func->accept(*this);
     }
-    std::cout << codeBuffer;
+    codeBuffer.flush(STDOUT_FILENO);
 }
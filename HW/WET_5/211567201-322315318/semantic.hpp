@@ -12,14 +12,24 @@
 class SemanticVisitor : public Visitor {
 public:
     int whileDepth = 0;
+    bool hasMain = false;
     //output::ScopePrinter scopePrinter;       
     Tables symbolTables;
     string currentFunctionName;
     output::CodeBuffer &codeBuffer;
-    std::string getLLVMType(ast::BuiltInType type);
-    std::string emitBinaryOperation(const std::string &left, const std::string &right, const std::string &op, ast::BuiltInType type);
+    std::string_view getLLVMType(ast::BuiltInType type);
+    output::Value emitBinaryOperation(output::Value left, output::Value right, output::BinaryOp op, ast::BuiltInType type);
     void emitRuntimeHelperFunctions();
 
+    // Converts the value of an already visited expression to the given type (byte <-> int) and
+    // updates its llvmValue and type. Every implicit widening and every cast goes through here
+    void coerce(ast::Node &exp, ast::BuiltInType to);
+
+    // Adds a function signature to the global scope; all signatures must be declared before
+    // any function body is visited
+    void declareFunction(const std::string &name, ast::BuiltInType returnType,
+                         const std::vector<ast::BuiltInType> &paramTypes, int line);
+
     //SemanticVisitor();
     explicit SemanticVisitor(output::CodeBuffer &buffer);
 
@@ -0,0 +1,192 @@
+#include "streaming.hpp"
+#include "lexer.hpp"
+#include "parser.tab.h"
+#include "timing.hpp"
+#include <unistd.h>
+
+extern thread_local int yylineno;
+extern std::function<void(std::shared_ptr<ast::FuncDecl>)> funcDeclHandler;
+extern ast::NodeArena parserNodes;
+
+namespace streaming {
+
+    static bool isType(int kind) {
+        return kind == INT || kind == BYTE || kind == BOOL;
+    }
+
+    static ast::BuiltInType toBuiltInType(int kind) {
+        switch (kind) {
+            case INT:
+                return ast::BuiltInType::INT;
+            case BYTE:
+                return ast::BuiltInType::BYTE;
+            case BOOL:
+                return ast::BuiltInType::BOOL;
+            default:
+                return ast::BuiltInType::VOID;
+        }
+    }
+
+    bool SignatureScanner::step(const lexer::Token &token) {
+        size_t index = position++;
+        switch (state) {
+            case EXPECT_RET_TYPE:
+                if (token.kind != VOID && !isType(token.kind)) {
+                    return false;
+                }
+                current = Signature();
+                current.returnType = toBuiltInType(token.kind);
+                current.begin = index;
+                state = EXPECT_NAME;
+                return true;
+            case EXPECT_NAME:
+                if (token.kind != ID) {
+                    return false;
+                }
+                current.name = dynamic_cast<ast::ID &>(*token.value).value;
+                current.line = token.line;
+                state = EXPECT_LPAREN;
+                return true;
+            case EXPECT_LPAREN:
+                state = EXPECT_FIRST_PARAM;
+                return token.kind == LPAREN;
+            case EXPECT_FIRST_PARAM:
+                if (token.kind == RPAREN) {
+                    state = EXPECT_BODY;
+                    return true;
+                }
+                // fall through
+            case EXPECT_PARAM:
+                if (!isType(token.kind)) {
+                    return false;
+                }
+                current.paramTypes.push_back(toBuiltInType(token.kind));
+                state = EXPECT_PARAM_NAME;
+                return true;
+            case EXPECT_PARAM_NAME:
+                state = EXPECT_PARAM_END;
+                return token.kind == ID;
+            case EXPECT_PARAM_END:
+                if (token.kind == COMMA) {
+                    state = EXPECT_PARAM;
+                    return true;
+                }
+                state = EXPECT_BODY;
+                return token.kind == RPAREN;
+            case EXPECT_BODY:
+                if (token.kind != LBRACE) {
+                    return false;
+                }
+                depth = 1;
+                state = IN_BODY;
+                return true;
+            case IN_BODY:
+                if (token.kind == LBRACE) {
+                    ++depth;
+                } else if (token.kind == RBRACE && --depth == 0) {
+                    current.end = index + 1;
+                    signatures.push_back(current);
+                    state = EXPECT_RET_TYPE;
+                }
+                return true;
+        }
+        return false;
+    }
+
+    bool SignatureScanner::atTopLevel() const {
+        return state == EXPECT_RET_TYPE;
+    }
+
+    FuncParser::FuncParser(const std::function<void(std::shared_ptr<ast::FuncDecl>)> &handler)
+            : parser(yypstate_new()), status(YYPUSH_MORE) {
+        funcDeclHandler = handler;
+    }
+
+    FuncParser::~FuncParser() {
+        yypstate_delete(parser);
+        funcDeclHandler = nullptr;
+    }
+
+    bool FuncParser::push(lexer::Token &token) {
+        if (status != YYPUSH_MORE) {
+            return false;
+        }
+        yylineno = token.line;
+        YYSTYPE value = parserNodes.add(std::move(token.value));
+        status = yypush_parse(parser, token.kind, &value);
+        return status == YYPUSH_MORE;
+    }
+
+    void FuncParser::finish(int line) {
+        if (status == YYPUSH_MORE) {
+            YYSTYPE none = ast::NodeArena::NONE;
+            yylineno = line;
+            status = yypush_parse(parser, 0, &none);
+        }
+    }
+
+    bool prescan(std::vector<Signature> &signatures) {
+        SignatureScanner scanner;
+        bool wellFormed = true;
+        lexer::streamChunks([&](lexer::Chunk &chunk) {
+            for (const auto &token : chunk.tokens) {
+                if (!scanner.step(token)) {
+                    wellFormed = false;
+                    return false;
+                }
+            }
+            if (chunk.error != 0) {
+                wellFormed = false;
+            }
+            return wellFormed;
+        });
+        signatures = std::move(scanner.signatures);
+        return wellFormed && scanner.atTopLevel();
+    }
+
+    void parse(const std::function<void(std::shared_ptr<ast::FuncDecl>)> &handler) {
+        FuncParser parser(handler);
+
+        lexer::streamChunks([&](lexer::Chunk &chunk) {
+            for (auto &token : chunk.tokens) {
+                if (!parser.push(token)) {
+                    return false;
+                }
+            }
+            lexer::reportError(chunk);
+            return true;
+        });
+
+        parser.finish(lexer::endLine());
+    }
+
+    void compile(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer) {
+        std::vector<Signature> signatures;
+        bool wellFormed;
+        {
+            // The pre-scan is a pass of the lexer that only looks at the tokens
+            timing::Scope lexing(timing::Phase::LEXING);
+            wellFormed = prescan(signatures);
+        }
+        // The second pass lexes while parsing; its time goes to parsing
+        timing::Scope parsing(timing::Phase::PARSING);
+        if (!wellFormed) {
+            // The input does not parse; run the parser only, so that it reports the first error
+            parse([](std::shared_ptr<ast::FuncDecl>) {});
+            return;
+        }
+
+        for (const auto &signature : signatures) {
+            visitor.declareFunction(signature.name, signature.returnType, signature.paramTypes, signature.line);
+        }
+        if (!visitor.hasMain) {
+            output::errorMainMissing();
+        }
+
+        parse([&](std::shared_ptr<ast::FuncDecl> func) {
+            timing::Scope checking(timing::Phase::CHECKING);
+            func->accept(visitor);
+            codeBuffer.flush(STDOUT_FILENO);
+        });
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef STREAMING_HPP
+#define STREAMING_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "lexer.hpp"
+#include "nodes.hpp"
+#include "output.hpp"
+#include "semantic.hpp"
+
+struct yypstate;
+
+namespace streaming {
+
+    /* Signature of a top-level function, as found by the pre-scan */
+    struct Signature {
+        std::string name;
+        ast::BuiltInType returnType;
+        std::vector<ast::BuiltInType> paramTypes;
+        int line;
+        // Token range [begin, end) of the whole declaration, counted from the start of the input
+        size_t begin;
+        size_t end;
+    };
+
+    /* Recognizes "RetType ID ( [Type ID {, Type ID}] ) { ... }" declarations one token at a time,
+     * skipping over brace-balanced bodies without parsing them */
+    class SignatureScanner {
+    public:
+        std::vector<Signature> signatures;
+
+        // Consumes the next token. Returns false if it cannot continue a well formed top level
+        bool step(const lexer::Token &token);
+
+        // True if the tokens so far form a sequence of complete declarations
+        bool atTopLevel() const;
+
+    private:
+        enum State {
+            EXPECT_RET_TYPE, EXPECT_NAME, EXPECT_LPAREN, EXPECT_FIRST_PARAM, EXPECT_PARAM_NAME, EXPECT_PARAM_END,
+            EXPECT_PARAM, EXPECT_BODY, IN_BODY
+        };
+        State state = EXPECT_RET_TYPE;
+        int depth = 0;
+        size_t position = 0;
+        Signature current;
+    };
+
+    /* Bison push parser that hands every function to a handler as soon as it is reduced */
+    class FuncParser {
+    public:
+        explicit FuncParser(const std::function<void(std::shared_ptr<ast::FuncDecl>)> &handler);
+        ~FuncParser();
+
+        // Pushes one token (its value is moved out). Returns false once the parser has stopped
+        bool push(lexer::Token &token);
+
+        // Pushes end of input, reported at the given line
+        void finish(int line);
+
+    private:
+        yypstate *parser;
+        int status;
+    };
+
+    // Stage 1: walks the token stream (without parsing function bodies) and collects the
+    // signatures of all top-level functions. Returns false if the top level is not a sequence of
+    // well formed function headers followed by brace-balanced bodies, or a lexical error was hit
+    bool prescan(std::vector<Signature> &signatures);
+
+    // Stage 2: feeds the token stream to the bison push parser and hands every function to
+    // handler as soon as it is reduced. Syntax and lexical errors are reported as they are reached
+    void parse(const std::function<void(std::shared_ptr<ast::FuncDecl>)> &handler);
+
+    // Compiles the input read by lexer::readInput() one function at a time: the signatures are
+    // declared up front, then each function is checked, emitted and printed as soon as it is
+    // parsed, and freed. Peak memory is the source text (readInput() reads it whole) plus one
+    // function's AST and two lexer chunks.
+    // Unlike the default mode, an error in a later function is reported after the code already
+    // printed for the earlier ones, and signature errors (redefinition, missing main) are reported
+    // before syntax errors inside function bodies
+    void compile(SemanticVisitor &visitor, output::CodeBuffer &codeBuffer);
+}
+
+#endif //STREAMING_HPP
@@ -23,7 +23,7 @@ int Sym::getOffset() const {
     return this->offset;
 }
 
-const std::vector<ast::BuiltInType> Sym::getFormalsTypes() const {
+const std::vector<ast::BuiltInType> &Sym::getFormalsTypes() const {
     return this->formals_types;
 }
 
@@ -52,8 +52,8 @@ Sym* Table::getSymbol(const std::string &name) {
 //--------------------Tables--------------------
 
 Tables::Tables() : functionParamOffset(-1), functionVarOffset(0) {
-    globalFunctions.insertSymbol(Sym("print", ast::BuiltInType::VOID, std::vector<ast::BuiltInType>{ast::BuiltInType::STRING}, 0, "%print"));
-    globalFunctions.insertSymbol(Sym("printi", ast::BuiltInType::VOID, std::vector<ast::BuiltInType>{ast::BuiltInType::INT}, 0, "%printi"));
+    globalFunctions.insertSymbol(Sym("print", ast::BuiltInType::VOID, std::vector<ast::BuiltInType>{ast::BuiltInType::STRING}, 0));
+    globalFunctions.insertSymbol(Sym("printi", ast::BuiltInType::VOID, std::vector<ast::BuiltInType>{ast::BuiltInType::INT}, 0));
 
     scopes.emplace_back();
     scopeOffsets.push_back(0);
@@ -15,7 +15,8 @@ private:
     std::string name;
     ast::BuiltInType type;
     int offset;
-    std::string emittedName;
+    // Stack slot of a variable (unused for functions)
+    output::Value emittedValue;
 
     bool isFunction;
     ast::BuiltInType ret_type;
@@ -24,25 +25,25 @@ private:
     int line;
 
 public:
-    Sym() : name(""), type(ast::BuiltInType::VOID), offset(0), isFunction(false), ret_type(ast::BuiltInType::VOID), emittedName("") {}
+    Sym() : name(""), type(ast::BuiltInType::VOID), offset(0), isFunction(false), ret_type(ast::BuiltInType::VOID) {}
 
-    Sym(const std::string &name, ast::BuiltInType type, int offset, int line, const std::string &emittedName) 
-        : name(name), type(type), offset(offset), isFunction(false), ret_type(ast::BuiltInType::VOID), line(line), emittedName(emittedName) {}
+    Sym(const std::string &name, ast::BuiltInType type, int offset, int line, output::Value emittedValue) 
+        : name(name), type(type), offset(offset), isFunction(false), ret_type(ast::BuiltInType::VOID), line(line), emittedValue(emittedValue) {}
 
-    Sym(const std::string &name, ast::BuiltInType ret_type, const std::vector<ast::BuiltInType> &formals_types, int line, const std::string &emittedName)
-        : name(name), type(ast::BuiltInType::VOID), offset(0), isFunction(true), ret_type(ret_type), formals_types(formals_types), line(line), emittedName(emittedName) {}
+    Sym(const std::string &name, ast::BuiltInType ret_type, const std::vector<ast::BuiltInType> &formals_types, int line)
+        : name(name), type(ast::BuiltInType::VOID), offset(0), isFunction(true), ret_type(ret_type), formals_types(formals_types), line(line) {}
 
     bool isVariable() const;
     std::string getName() const;
     ast::BuiltInType getType() const;
     ast::BuiltInType getReturnType() const;
     int getOffset() const;
-    const std::vector<ast::BuiltInType> getFormalsTypes() const;
+    const std::vector<ast::BuiltInType> &getFormalsTypes() const;
     bool isFunctionSymbol() const;
     int getLine() const { return line; }
     void setOffset(int offset) { this->offset = offset; }
-    std::string getEmittedName() const { return emittedName; }
-    void setEmittedName(const std::string &emittedName) { this->emittedName = emittedName; }
+    output::Value getEmittedValue() const { return emittedValue; }
+    void setEmittedValue(output::Value emittedValue) { this->emittedValue = emittedValue; }
 };
 // A Signle Scope Table
 class Table{
@@ -0,0 +1,164 @@
+#include "timing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace timing {
+
+    using Clock = std::chrono::steady_clock;
+
+    static const char *const PHASE_NAMES[] = {"lexing", "parsing", "semantic checking", "codegen", "output"};
+    static const size_t PHASES = size_t(Phase::PHASES);
+
+    static std::atomic<bool> counting(false);
+    static std::atomic<size_t> allocations(0);
+    static std::atomic<size_t> allocatedBytes(0);
+
+    /* What was charged to a phase */
+    struct Totals {
+        double seconds = 0;
+        size_t allocations = 0;
+        size_t bytes = 0;
+        // Growth of the peak RSS while the phase ran, and the peak when it last ended, in KB
+        long rssGrowth = 0;
+        long peakRss = 0;
+    };
+
+    static size_t slowest = 0;
+    static Totals totals[PHASES];
+    // Time outside every phase (startup, and freeing the AST when main returns)
+    static Totals unaccounted;
+    static std::vector<Phase> phases;
+    static std::unordered_map<std::string, double> functionSeconds;
+
+    // Counters at the last time something was charged
+    static Clock::time_point started;
+    static Clock::time_point last;
+    static size_t lastAllocations = 0;
+    static size_t lastBytes = 0;
+    static long lastRss = 0;
+
+    static long peakRss() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    // Charges everything since the last call to the innermost open phase
+    static void charge() {
+        Clock::time_point now = Clock::now();
+        size_t allocated = allocations.load(std::memory_order_relaxed);
+        size_t bytes = allocatedBytes.load(std::memory_order_relaxed);
+        long rss = peakRss();
+        Totals &phase = phases.empty() ? unaccounted : totals[size_t(phases.back())];
+        phase.seconds += std::chrono::duration<double>(now - last).count();
+        phase.allocations += allocated - lastAllocations;
+        phase.bytes += bytes - lastBytes;
+        phase.rssGrowth += rss - lastRss;
+        phase.peakRss = rss;
+        last = now;
+        lastAllocations = allocated;
+        lastBytes = bytes;
+        lastRss = rss;
+    }
+
+    static void report() {
+        charge();
+        double total = std::chrono::duration<double>(last - started).count();
+        std::fprintf(stderr, "===== Time report =====\n");
+        std::fprintf(stderr, "%-18s %11s %7s %12s %14s %12s %12s\n", "phase", "wall (ms)", "%", "allocations",
+                     "allocated (KB)", "+RSS (KB)", "peak RSS (KB)");
+        auto row = [&](const char *name, const Totals &phase) {
+            std::fprintf(stderr, "%-18s %11.3f %6.1f%% %12zu %14zu %12ld %12ld\n", name, phase.seconds * 1000,
+                         total > 0 ? phase.seconds * 100 / total : 0.0, phase.allocations, phase.bytes / 1024,
+                         phase.rssGrowth, phase.peakRss);
+        };
+        for (size_t i = 0; i < PHASES; ++i) {
+            row(PHASE_NAMES[i], totals[i]);
+        }
+        row("other", unaccounted);
+        std::fprintf(stderr, "%-18s %11.3f %6.1f%% %12zu %14zu %12s %12ld\n", "total", total * 1000, 100.0,
+                     size_t(allocations), size_t(allocatedBytes) / 1024, "", lastRss);
+
+        std::vector<std::pair<std::string, double>> functions(functionSeconds.begin(), functionSeconds.end());
+        size_t shown = std::min(slowest, functions.size());
+        std::partial_sort(functions.begin(), functions.begin() + shown, functions.end(),
+                          [](const auto &a, const auto &b) {
+                              return a.second != b.second ? a.second > b.second : a.first < b.first;
+                          });
+        if (shown) {
+            std::fprintf(stderr, "===== Slowest functions (codegen) =====\n");
+        }
+        for (size_t i = 0; i < shown; ++i) {
+            std::fprintf(stderr, "%11.3f ms  %s\n", functions[i].second * 1000, functions[i].first.c_str());
+        }
+    }
+
+    void enable(size_t slowestFunctions) {
+        slowest = slowestFunctions;
+        started = last = Clock::now();
+        lastRss = peakRss();
+        counting = true;
+        std::atexit(report);
+    }
+
+    bool enabled() {
+        return counting.load(std::memory_order_relaxed);
+    }
+
+    Scope::Scope(Phase phase) : open(enabled()) {
+        if (open) {
+            charge();
+            phases.push_back(phase);
+        }
+    }
+
+    Scope::Scope(Phase phase, const std::string &function) : Scope(phase) {
+        if (open) {
+            this->function = function;
+            start = last;
+        }
+    }
+
+    Scope::~Scope() {
+        if (!open) {
+            return;
+        }
+        charge();
+        phases.pop_back();
+        if (!function.empty()) {
+            functionSeconds[function] += std::chrono::duration<double>(last - start).count();
+        }
+    }
+}
+
+// Counts the allocations for the report. The other forms of new and delete go through these two
+void *operator new(size_t size) {
+    if (timing::enabled()) {
+        timing::allocations.fetch_add(1, std::memory_order_relaxed);
+        timing::allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    void *block = std::malloc(size ? size : 1);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+// GCC takes the free() of a pointer passed to operator delete for a mismatched deallocation
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *block) noexcept {
+    std::free(block);
+}
+#pragma GCC diagnostic pop
+
+void operator delete(void *block, size_t) noexcept {
+    ::operator delete(block);
+}
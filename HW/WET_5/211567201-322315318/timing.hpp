@@ -0,0 +1,49 @@
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace timing {
+
+    /* Phases of a compilation, as --time-report shows them */
+    enum class Phase {
+        LEXING,     // reading the input and tokenizing it
+        PARSING,    // building the AST
+        CHECKING,   // semantic checking, which also builds the IR of each function
+        CODEGEN,    // running the passes over a function and printing it into the code buffer
+        OUTPUT,     // writing the code buffer out
+        PHASES
+    };
+
+    // Turns the instrumentation on. The report is written on stderr when the program exits,
+    // whichever way it does; it ends with the functions whose code generation took longest
+    void enable(size_t slowestFunctions);
+
+    bool enabled();
+
+    /* Charges the wall time, the allocations and the growth of the peak RSS until it is destroyed
+     * to a phase. Scopes nest: while an inner scope is open, its phase is charged instead of the
+     * outer one. Only the main thread opens scopes, but allocations made by other threads (the
+     * parallel lexer) are charged to the phase the main thread is in. Does nothing unless enabled */
+    class Scope {
+    public:
+        explicit Scope(Phase phase);
+
+        // Also adds the time of the scope (nested scopes included) to the function's total
+        Scope(Phase phase, const std::string &function);
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope();
+
+    private:
+        bool open;
+        std::string function;
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif //TIMING_HPP
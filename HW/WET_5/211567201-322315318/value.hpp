@@ -0,0 +1,58 @@
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include <cstdint>
+
+namespace output {
+
+    /* Operand of an emitted instruction. Registers are numbered handles rather than names,
+     * and are only turned into text when the instruction is written out:
+     * TEMP n prints as %tn, ARG n as %argn and CONST n as the immediate n
+     */
+    struct Value {
+        enum class Kind : uint8_t {
+            NONE,
+            TEMP,
+            ARG,
+            CONST
+        };
+
+        Kind kind = Kind::NONE;
+        int id = 0;
+
+        static Value temp(int id) {
+            return {Kind::TEMP, id};
+        }
+
+        static Value arg(int id) {
+            return {Kind::ARG, id};
+        }
+
+        static Value constant(int value) {
+            return {Kind::CONST, value};
+        }
+
+        bool isConst() const {
+            return kind == Kind::CONST;
+        }
+
+        bool operator==(const Value &other) const {
+            return kind == other.kind && id == other.id;
+        }
+
+        bool operator!=(const Value &other) const {
+            return !(*this == other);
+        }
+    };
+
+    /* Basic block label, printed as label_n */
+    struct Label {
+        int id = -1;
+
+        bool operator==(const Label &other) const {
+            return id == other.id;
+        }
+    };
+}
+
+#endif //VALUE_HPP
@@ -0,0 +1,1062 @@
+#include "x86.hpp"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include "dataflow.hpp"
+#include "output.hpp"
+
+namespace x86 {
+
+    const char *const RUNTIME = R"(	.text
+	.globl _start
+_start:
+	call fanc.main
+	call rt.flush
+	movl $231, %eax
+	xorl %edi, %edi
+	syscall
+
+# Appends the byte in %al to the output buffer. Clobbers %rdx and %r11
+rt.putc:
+	movq rt.used(%rip), %rdx
+	leaq rt.buffer(%rip), %r11
+	movb %al, (%r11,%rdx)
+	incq %rdx
+	movq %rdx, rt.used(%rip)
+	cmpq $65536, %rdx
+	je rt.flush
+	ret
+
+# Writes out the output buffer. Clobbers %rdx and %r11
+rt.flush:
+	pushq %rax
+	pushq %rcx
+	pushq %rsi
+	pushq %rdi
+	movl $1, %edi
+	leaq rt.buffer(%rip), %rsi
+	movq rt.used(%rip), %rdx
+1:	testq %rdx, %rdx
+	jle 2f
+	movl $1, %eax
+	syscall
+	testq %rax, %rax
+	jle 2f
+	addq %rax, %rsi
+	subq %rax, %rdx
+	jmp 1b
+2:	movq $0, rt.used(%rip)
+	popq %rdi
+	popq %rsi
+	popq %rcx
+	popq %rax
+	ret
+
+# Prints the %edx bytes at %rax and a newline. Clobbers %rax, %rdx and %r11
+rt.print:
+	pushq %rcx
+	pushq %rsi
+	movq %rax, %rsi
+	movl %edx, %ecx
+1:	testl %ecx, %ecx
+	jz 2f
+	movb (%rsi), %al
+	call rt.putc
+	incq %rsi
+	decl %ecx
+	jmp 1b
+2:	movb $10, %al
+	call rt.putc
+	popq %rsi
+	popq %rcx
+	ret
+
+# Prints the int in %eax and a newline. Clobbers %rax, %rdx and %r11
+rt.printi:
+	pushq %rcx
+	pushq %rsi
+	subq $16, %rsp
+	movl %eax, %ecx
+	testl %ecx, %ecx
+	jns 1f
+	movb $45, %al
+	call rt.putc
+	negl %ecx
+1:	movl %ecx, %eax
+	movl $10, %ecx
+	leaq 16(%rsp), %rsi
+2:	xorl %edx, %edx
+	divl %ecx
+	addb $48, %dl
+	decq %rsi
+	movb %dl, (%rsi)
+	testl %eax, %eax
+	jnz 2b
+	leaq 16(%rsp), %rcx
+3:	movb (%rsi), %al
+	call rt.putc
+	incq %rsi
+	cmpq %rcx, %rsi
+	jne 3b
+	movb $10, %al
+	call rt.putc
+	addq $16, %rsp
+	popq %rsi
+	popq %rcx
+	ret
+
+rt.divzero:
+	leaq rt.divmsg(%rip), %rax
+	movl $22, %edx
+	call rt.print
+	call rt.flush
+	movl $231, %eax
+	movl $1, %edi
+	syscall
+
+	.section .rodata
+rt.divmsg:
+	.ascii "Error division by zero"
+	.data
+	.p2align 3
+rt.used:
+	.quad 0
+	.bss
+rt.buffer:
+	.zero 65536
+	.text
+)";
+
+    std::string stringConstant(int index, const std::string &bytes) {
+        std::string text = "\t.section .rodata\n.Lstr" + std::to_string(index) + ":\n\t.ascii \"";
+        for (unsigned char c : bytes) {
+            if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+                text += char(c);
+            } else {
+                text += '\\';
+                text += char('0' + (c >> 6));
+                text += char('0' + ((c >> 3) & 7));
+                text += char('0' + (c & 7));
+            }
+        }
+        return text + "\"\n\t.text\n";
+    }
+
+    namespace {
+
+        enum Register {
+            RAX, RCX, RDX, RBX, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15, REGISTERS
+        };
+
+        const char *const NAMES64[] = {"%rax", "%rcx", "%rdx", "%rbx", "%rsi", "%rdi", "%r8", "%r9",
+                                       "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"};
+        const char *const NAMES32[] = {"%eax", "%ecx", "%edx", "%ebx", "%esi", "%edi", "%r8d", "%r9d",
+                                       "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"};
+        const char *const NAMES8[] = {"%al", "%cl", "%dl", "%bl", "%sil", "%dil", "%r8b", "%r9b",
+                                      "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b"};
+
+        const Register ARGUMENT_REGISTERS[] = {RDI, RSI, RDX, RCX, R8, R9};
+        const size_t REGISTER_ARGUMENTS = 6;
+        // %rax, %rdx and %r11 are never allocated: instructions use them as scratch registers and
+        // the runtime clobbers them
+        const Register CALLER_SAVED[] = {RCX, RSI, RDI, R8, R9, R10};
+        const Register CALLEE_SAVED[] = {RBX, R12, R13, R14, R15};
+
+        /* Where a value is: a register, a slot of the frame (offset from %rbp) or an immediate */
+        struct Location {
+            enum class Kind {
+                NONE,
+                REGISTER,
+                STACK,
+                IMMEDIATE
+            };
+
+            Kind kind = Kind::NONE;
+            int value = 0;
+
+            static Location reg(int r) {
+                return {Kind::REGISTER, r};
+            }
+
+            static Location stack(int offset) {
+                return {Kind::STACK, offset};
+            }
+
+            static Location immediate(int value) {
+                return {Kind::IMMEDIATE, value};
+            }
+
+            bool isRegister() const {
+                return kind == Kind::REGISTER;
+            }
+
+            bool operator==(const Location &other) const {
+                return kind == other.kind && value == other.value;
+            }
+
+            bool operator!=(const Location &other) const {
+                return !(*this == other);
+            }
+        };
+
+        // Width is 8, 32 or 64 bits
+        std::string operand(Location location, int width = 32) {
+            switch (location.kind) {
+                case Location::Kind::REGISTER:
+                    return width == 8 ? NAMES8[location.value] : width == 64 ? NAMES64[location.value]
+                                                                             : NAMES32[location.value];
+                case Location::Kind::STACK:
+                    return std::to_string(location.value) + "(%rbp)";
+                case Location::Kind::IMMEDIATE:
+                    return "$" + std::to_string(width == 8 ? int(int8_t(location.value)) : location.value);
+                default:
+                    return "?";
+            }
+        }
+
+        const char *conditionCode(ir::Condition condition) {
+            switch (condition) {
+                case ir::Condition::EQ:
+                    return "e";
+                case ir::Condition::NE:
+                    return "ne";
+                case ir::Condition::SLT:
+                    return "l";
+                case ir::Condition::SLE:
+                    return "le";
+                case ir::Condition::SGT:
+                    return "g";
+                default:
+                    return "ge";
+            }
+        }
+
+        const char *inverse(const std::string &code) {
+            static const std::unordered_map<std::string, const char *> inverses = {
+                    {"e", "ne"}, {"ne", "e"}, {"l", "ge"}, {"ge", "l"}, {"le", "g"}, {"g", "le"}};
+            return inverses.at(code);
+        }
+
+        // The constant as a register of the type holds it
+        int normalize(int value, ast::BuiltInType type) {
+            switch (type) {
+                case ast::BuiltInType::BOOL:
+                    return value & 1;
+                case ast::BuiltInType::BYTE:
+                    return value & 0xff;
+                default:
+                    return value;
+            }
+        }
+
+        /* Liveness of the values at block boundaries, where a PHI reads its argument at the end of
+         * the predecessor it comes from (not in the block of the PHI) and defines its result at the
+         * start of its block. Only the values used outside the block that defines them are tracked */
+        class LiveValues {
+        public:
+            using Fact = dataflow::BitSet;
+            static const dataflow::Direction direction = dataflow::Direction::BACKWARD;
+
+            size_t size = 0;
+            size_t blocks = 0;
+            std::vector<dataflow::BitSet> uses;
+            std::vector<dataflow::BitSet> defs;
+            // PHI arguments read on each edge, keyed by from * blocks + to
+            std::unordered_map<size_t, dataflow::BitSet> edgeUses;
+
+            Fact bottom() const {
+                return dataflow::BitSet(size);
+            }
+
+            Fact boundary() const {
+                return bottom();
+            }
+
+            bool join(Fact &into, const Fact &from) const {
+                return into.unite(from);
+            }
+
+            void transfer(size_t block, Fact &fact) const {
+                fact.apply(uses[block], defs[block]);
+            }
+
+            void edge(size_t from, size_t to, Fact &fact) const {
+                auto found = edgeUses.find(from * blocks + to);
+                if (found != edgeUses.end()) {
+                    fact.unite(found->second);
+                }
+            }
+        };
+
+        /* Allocates registers for one function and writes its code.
+         *
+         * Every instruction gets a position in layout order: it reads its operands at the position
+         * and writes its result right after. The live range of a value is approximated by a single
+         * interval from its first to its last live position, and the intervals are allocated by
+         * linear scan. Values live across a call only get callee-saved registers. When the
+         * registers run out the interval that ends last goes to a stack slot.
+         *
+         * Values are kept as 32-bit numbers of their type (bytes 0..255, bools 0 or 1). PHIs become
+         * parallel moves on the edges into their block */
+        class FunctionWriter {
+        public:
+            FunctionWriter(const ir::Function &function) : function(function), cfg(function) {}
+
+            std::string write();
+
+        private:
+            /* Live interval of a value */
+            struct Interval {
+                int start = INT_MAX;
+                int end = -1;
+                bool crossesCall = false;
+                Location location;
+            };
+
+            const ir::Function &function;
+            dataflow::CFG cfg;
+            std::string code;
+
+            // Reachable blocks in layout order, and the position of each block in it (-1 if unreachable)
+            std::vector<size_t> layout;
+            std::vector<int> place;
+            std::unordered_map<int, size_t> blockOfLabel;
+
+            // Values are numbered densely: the parameters first, then the temporaries
+            std::unordered_map<int, int> temps;
+            std::vector<Interval> intervals;
+            std::vector<int> useCounts;
+            // Frame slots of the allocas, by temporary number
+            std::unordered_map<int, int> allocaSlots;
+            int frameSize = 0;
+            std::vector<Register> savedRegisters;
+
+            // Moves into the blocks with PHIs from the middle of a block, written after the body
+            std::string trampolines;
+            int trampolineCount = 0;
+
+            int number(output::Value value) const {
+                if (value.kind == output::Value::Kind::ARG) {
+                    return value.id;
+                }
+                if (value.kind == output::Value::Kind::TEMP) {
+                    auto found = temps.find(value.id);
+                    return found == temps.end() ? -1 : found->second;
+                }
+                return -1;
+            }
+
+            static bool defines(const ir::Instruction &inst) {
+                return inst.dst.kind == output::Value::Kind::TEMP && inst.opcode != ir::Opcode::ALLOCA
+                       && inst.opcode != ir::Opcode::STORE
+                       && (inst.opcode != ir::Opcode::CALL || inst.type != ast::BuiltInType::VOID);
+            }
+
+            int newSlot() {
+                frameSize += 8;
+                return -frameSize;
+            }
+
+            void numberValues();
+
+            void buildIntervals();
+
+            void allocate();
+
+            Location locate(output::Value value, ast::BuiltInType type) const;
+
+            void emit(const std::string &line) {
+                code += '\t';
+                code += line;
+                code += '\n';
+            }
+
+            std::string label(size_t block) const {
+                return ".L" + function.name + "." + std::to_string(function.blocks[block].label.id);
+            }
+
+            void move(Location dst, Location src, std::string &out);
+
+            void move(Location dst, Location src) {
+                move(dst, src, code);
+            }
+
+            void parallelMove(std::vector<std::pair<Location, Location>> moves, std::string &out);
+
+            std::vector<std::pair<Location, Location>> edgeMoves(size_t from, size_t to) const;
+
+            // Jumps from the end of block from to block to, through the moves of its PHIs
+            void jump(size_t from, size_t to, bool fallthrough);
+
+            // Branches to the first target if the flags satisfy the condition code, else to the second
+            void branch(size_t from, const std::string &condition, size_t ifTrue, size_t ifFalse);
+
+            void writeBlock(size_t block);
+
+            void writeBinary(const ir::Instruction &inst);
+
+            // Compares the operands of a COMPARE into the flags
+            void writeCompare(const ir::Instruction &inst);
+
+            void writeCast(const ir::Instruction &inst);
+
+            void writeCall(const ir::Instruction &inst, bool tail);
+
+            void writeEpilogue();
+
+            bool isNext(size_t block, size_t target) const {
+                size_t at = place[block] + 1;
+                return at < layout.size() && layout[at] == target;
+            }
+        };
+
+        void FunctionWriter::numberValues() {
+            int count = int(function.paramTypes.size());
+            for (const auto &block : function.blocks) {
+                for (const auto &inst : block.instructions) {
+                    if (inst.opcode == ir::Opcode::ALLOCA) {
+                        allocaSlots.emplace(inst.dst.id, 0);
+                    } else if (defines(inst)) {
+                        temps.emplace(inst.dst.id, count++);
+                    }
+                }
+            }
+            intervals.resize(count);
+            useCounts.assign(count, 0);
+            for (const auto &block : function.blocks) {
+                for (const auto &inst : block.instructions) {
+                    ir::forEachUse(inst, [&](output::Value value) {
+                        int v = number(value);
+                        if (v >= 0) {
+                            ++useCounts[v];
+                        }
+                    });
+                }
+            }
+        }
+
+        void FunctionWriter::buildIntervals() {
+            size_t n = function.blocks.size();
+            place.assign(n, -1);
+            std::vector<bool> reachable(n, false);
+            for (size_t block : cfg.order) {
+                reachable[block] = true;
+            }
+            for (size_t block = 0; block < n; ++block) {
+                if (reachable[block]) {
+                    place[block] = int(layout.size());
+                    layout.push_back(block);
+                }
+                blockOfLabel.emplace(function.blocks[block].label.id, block);
+            }
+
+            // Positions: instruction k of the layout reads at 4k + 4 and writes at 4k + 5. A block
+            // starts (its PHIs are defined) 2 before its first instruction, and what is live out of
+            // it lives until 1 after its terminator. The parameters are defined at 0
+            std::vector<int> blockStart(n, 0), blockEnd(n, 0);
+            std::vector<int> callPositions;
+            int position = 4;
+            for (size_t block : layout) {
+                blockStart[block] = position - 2;
+                for (const auto &inst : function.blocks[block].instructions) {
+                    if (inst.opcode == ir::Opcode::CALL) {
+                        callPositions.push_back(position);
+                    }
+                    position += 4;
+                }
+                blockEnd[block] = position - 4 + 1;
+            }
+
+            auto extend = [&](int v, int at) {
+                if (v >= 0) {
+                    intervals[v].start = std::min(intervals[v].start, at);
+                    intervals[v].end = std::max(intervals[v].end, at);
+                }
+            };
+
+            // The block each value is defined in, and whether it is used in another one
+            std::vector<size_t> defBlock(intervals.size(), 0);
+            std::vector<bool> tracked(intervals.size(), false);
+            for (size_t v = 0; v < function.paramTypes.size(); ++v) {
+                extend(int(v), 0);
+            }
+            for (size_t block : layout) {
+                int at = blockStart[block] + 2;
+                for (const auto &inst : function.blocks[block].instructions) {
+                    if (inst.opcode == ir::Opcode::PHI) {
+                        int v = number(inst.dst);
+                        extend(v, blockStart[block]);
+                        defBlock[v] = block;
+                        for (size_t i = 0; i < inst.args.size(); ++i) {
+                            auto found = blockOfLabel.find(inst.incoming[i].id);
+                            if (found == blockOfLabel.end() || place[found->second] < 0) {
+                                continue;
+                            }
+                            extend(number(inst.args[i].value), blockEnd[found->second]);
+                        }
+                    } else {
+                        ir::forEachUse(inst, [&](output::Value value) { extend(number(value), at); });
+                        if (defines(inst)) {
+                            int v = number(inst.dst);
+                            extend(v, at + 1);
+                            defBlock[v] = block;
+                        }
+                    }
+                    at += 4;
+                }
+            }
+            for (size_t block : layout) {
+                for (const auto &inst : function.blocks[block].instructions) {
+                    if (inst.opcode == ir::Opcode::PHI) {
+                        for (size_t i = 0; i < inst.args.size(); ++i) {
+                            auto found = blockOfLabel.find(inst.incoming[i].id);
+                            int v = number(inst.args[i].value);
+                            if (v >= 0 && found != blockOfLabel.end() && defBlock[v] != found->second) {
+                                tracked[v] = true;
+                            }
+                        }
+                    } else {
+                        ir::forEachUse(inst, [&](output::Value value) {
+                            int v = number(value);
+                            if (v >= 0 && defBlock[v] != block) {
+                                tracked[v] = true;
+                            }
+                        });
+                    }
+                }
+            }
+
+            // Extend the tracked values over the block boundaries they are live across
+            std::vector<int> values;
+            std::vector<int> index(intervals.size(), -1);
+            for (size_t v = 0; v < intervals.size(); ++v) {
+                if (tracked[v]) {
+                    index[v] = int(values.size());
+                    values.push_back(int(v));
+                }
+            }
+            if (!values.empty()) {
+                LiveValues live;
+                live.size = values.size();
+                live.blocks = n;
+                live.uses.assign(n, live.bottom());
+                live.defs.assign(n, live.bottom());
+                for (size_t v = 0; v < function.paramTypes.size(); ++v) {
+                    if (index[v] >= 0) {
+                        live.defs[0].set(index[v]);
+                    }
+                }
+                for (size_t block : layout) {
+                    for (const auto &inst : function.blocks[block].instructions) {
+                        if (inst.opcode == ir::Opcode::PHI) {
+                            for (size_t i = 0; i < inst.args.size(); ++i) {
+                                auto found = blockOfLabel.find(inst.incoming[i].id);
+                                int v = number(inst.args[i].value);
+                                if (v < 0 || index[v] < 0 || found == blockOfLabel.end()) {
+                                    continue;
+                                }
+                                auto edge = live.edgeUses.emplace(found->second * n + block, live.bottom()).first;
+                                edge->second.set(index[v]);
+                            }
+                        } else {
+                            ir::forEachUse(inst, [&](output::Value value) {
+                                int v = number(value);
+                                if (v >= 0 && index[v] >= 0 && defBlock[v] != block) {
+                                    live.uses[block].set(index[v]);
+                                }
+                            });
+                        }
+                        if (defines(inst) && index[number(inst.dst)] >= 0) {
+                            live.defs[block].set(index[number(inst.dst)]);
+                        }
+                    }
+                }
+                auto solution = dataflow::solve(cfg, live);
+                for (size_t block : layout) {
+                    for (size_t i = 0; i < values.size(); ++i) {
+                        if (solution.in[block].test(i)) {
+                            extend(values[i], blockStart[block]);
+                        }
+                        if (solution.out[block].test(i)) {
+                            extend(values[i], blockEnd[block]);
+                        }
+                    }
+                }
+            }
+
+            for (auto &interval : intervals) {
+                auto call = std::lower_bound(callPositions.begin(), callPositions.end(), interval.start);
+                interval.crossesCall = call != callPositions.end() && *call < interval.end;
+            }
+        }
+
+        void FunctionWriter::allocate() {
+            for (auto &slot : allocaSlots) {
+                slot.second = newSlot();
+            }
+
+            std::vector<int> order;
+            for (size_t v = 0; v < intervals.size(); ++v) {
+                if (intervals[v].start != INT_MAX) {
+                    order.push_back(int(v));
+                }
+            }
+            std::sort(order.begin(), order.end(), [&](int a, int b) {
+                return intervals[a].start != intervals[b].start ? intervals[a].start < intervals[b].start : a < b;
+            });
+
+            bool free[REGISTERS];
+            std::fill(free, free + REGISTERS, false);
+            for (Register r : CALLER_SAVED) {
+                free[r] = true;
+            }
+            for (Register r : CALLEE_SAVED) {
+                free[r] = true;
+            }
+            bool used[REGISTERS] = {};
+            std::vector<int> active;
+
+            for (int v : order) {
+                Interval &current = intervals[v];
+                active.erase(std::remove_if(active.begin(), active.end(), [&](int a) {
+                    if (intervals[a].end < current.start) {
+                        free[intervals[a].location.value] = true;
+                        return true;
+                    }
+                    return false;
+                }), active.end());
+
+                int chosen = -1;
+                if (!current.crossesCall) {
+                    for (Register r : CALLER_SAVED) {
+                        if (free[r]) {
+                            chosen = r;
+                            break;
+                        }
+                    }
+                }
+                if (chosen < 0) {
+                    for (Register r : CALLEE_SAVED) {
+                        if (free[r]) {
+                            chosen = r;
+                            break;
+                        }
+                    }
+                }
+                if (chosen < 0) {
+                    // Spill whichever ends last: the current interval, or an active one holding a
+                    // register the current one may take
+                    int victim = -1;
+                    for (int a : active) {
+                        int r = intervals[a].location.value;
+                        bool calleeSaved = std::find(std::begin(CALLEE_SAVED), std::end(CALLEE_SAVED), r)
+                                           != std::end(CALLEE_SAVED);
+                        if ((calleeSaved || !current.crossesCall)
+                            && (victim < 0 || intervals[a].end > intervals[victim].end)) {
+                            victim = a;
+                        }
+                    }
+                    if (victim >= 0 && intervals[victim].end > current.end) {
+                        current.location = intervals[victim].location;
+                        intervals[victim].location = Location::stack(newSlot());
+                        active.erase(std::find(active.begin(), active.end(), victim));
+                        active.push_back(v);
+                    } else {
+                        current.location = Location::stack(newSlot());
+                    }
+                    continue;
+                }
+                free[chosen] = false;
+                used[chosen] = true;
+                current.location = Location::reg(chosen);
+                active.push_back(v);
+            }
+
+            for (Register r : CALLEE_SAVED) {
+                if (used[r]) {
+                    savedRegisters.push_back(r);
+                }
+            }
+        }
+
+        Location FunctionWriter::locate(output::Value value, ast::BuiltInType type) const {
+            if (value.isConst()) {
+                return Location::immediate(normalize(value.id, type));
+            }
+            int v = number(value);
+            return v < 0 ? Location() : intervals[v].location;
+        }
+
+        void FunctionWriter::move(Location dst, Location src, std::string &out) {
+            if (dst == src || dst.kind == Location::Kind::NONE || src.kind == Location::Kind::NONE) {
+                return;
+            }
+            if (dst.kind == Location::Kind::STACK && src.kind == Location::Kind::STACK) {
+                out += "\tmovl " + operand(src) + ", %eax\n";
+                src = Location::reg(RAX);
+            }
+            out += "\tmovl " + operand(src) + ", " + operand(dst) + "\n";
+        }
+
+        void FunctionWriter::parallelMove(std::vector<std::pair<Location, Location>> moves, std::string &out) {
+            moves.erase(std::remove_if(moves.begin(), moves.end(), [](const std::pair<Location, Location> &m) {
+                return m.first == m.second || m.first.kind == Location::Kind::NONE
+                       || m.second.kind == Location::Kind::NONE;
+            }), moves.end());
+            auto isSource = [&](Location location) {
+                for (const auto &m : moves) {
+                    if (m.second == location) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            while (!moves.empty()) {
+                bool progress = false;
+                for (size_t i = 0; i < moves.size(); ++i) {
+                    if (!isSource(moves[i].first)) {
+                        move(moves[i].first, moves[i].second, out);
+                        moves.erase(moves.begin() + i);
+                        progress = true;
+                        break;
+                    }
+                }
+                if (!progress) {
+                    // Only cycles are left: save one destination in %r11 and read it from there
+                    Location saved = moves.front().first;
+                    move(Location::reg(R11), saved, out);
+                    for (auto &m : moves) {
+                        if (m.second == saved) {
+                            m.second = Location::reg(R11);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<Location, Location>> FunctionWriter::edgeMoves(size_t from, size_t to) const {
+            std::vector<std::pair<Location, Location>> moves;
+            for (const auto &inst : function.blocks[to].instructions) {
+                if (inst.opcode != ir::Opcode::PHI) {
+                    break;
+                }
+                for (size_t i = 0; i < inst.args.size(); ++i) {
+                    if (inst.incoming[i] == function.blocks[from].label) {
+                        moves.emplace_back(locate(inst.dst, inst.type), locate(inst.args[i].value, inst.type));
+                        break;
+                    }
+                }
+            }
+            return moves;
+        }
+
+        void FunctionWriter::jump(size_t from, size_t to, bool fallthrough) {
+            parallelMove(edgeMoves(from, to), code);
+            if (!fallthrough) {
+                emit("jmp " + label(to));
+            }
+        }
+
+        void FunctionWriter::branch(size_t from, const std::string &condition, size_t ifTrue, size_t ifFalse) {
+            std::string taken = condition;
+            if (isNext(from, ifTrue)) {
+                std::swap(ifTrue, ifFalse);
+                taken = inverse(condition);
+            }
+            auto moves = edgeMoves(from, ifTrue);
+            moves.erase(std::remove_if(moves.begin(), moves.end(), [](const std::pair<Location, Location> &m) {
+                return m.first == m.second;
+            }), moves.end());
+            if (moves.empty()) {
+                emit("j" + taken + " " + label(ifTrue));
+            } else {
+                std::string trampoline = ".L" + function.name + ".e" + std::to_string(trampolineCount++);
+                emit("j" + taken + " " + trampoline);
+                trampolines += trampoline + ":\n";
+                parallelMove(moves, trampolines);
+                trampolines += "\tjmp " + label(ifTrue) + "\n";
+            }
+            jump(from, ifFalse, isNext(from, ifFalse));
+        }
+
+        void FunctionWriter::writeBinary(const ir::Instruction &inst) {
+            Location dst = locate(inst.dst, inst.type);
+            Location lhs = locate(inst.lhs, inst.type);
+            Location rhs = locate(inst.rhs, inst.type);
+            if (inst.binaryOp == ir::BinaryOp::SDIV || inst.binaryOp == ir::BinaryOp::UDIV) {
+                // The division by zero check comes before, in the IR
+                move(Location::reg(RAX), lhs);
+                if (rhs.kind == Location::Kind::IMMEDIATE) {
+                    move(Location::reg(R11), rhs);
+                    rhs = Location::reg(R11);
+                }
+                if (inst.binaryOp == ir::BinaryOp::SDIV) {
+                    emit("cltd");
+                    emit("idivl " + operand(rhs));
+                    if (inst.type == ast::BuiltInType::BYTE) {
+                        emit("movzbl %al, %eax");
+                    }
+                } else {
+                    emit("xorl %edx, %edx");
+                    emit("divl " + operand(rhs));
+                }
+                move(dst, Location::reg(RAX));
+                return;
+            }
+
+            bool commutative = inst.binaryOp != ir::BinaryOp::SUB;
+            if (commutative && dst.isRegister() && dst == rhs) {
+                std::swap(lhs, rhs);
+            }
+            Location work = dst.isRegister() && dst != rhs ? dst : Location::reg(RAX);
+            move(work, lhs);
+            const char *mnemonic = "addl";
+            switch (inst.binaryOp) {
+                case ir::BinaryOp::SUB:
+                    mnemonic = "subl";
+                    break;
+                case ir::BinaryOp::MUL:
+                    mnemonic = "imull";
+                    break;
+                case ir::BinaryOp::AND:
+                    mnemonic = "andl";
+                    break;
+                case ir::BinaryOp::OR:
+                    mnemonic = "orl";
+                    break;
+                case ir::BinaryOp::XOR:
+                    mnemonic = "xorl";
+                    break;
+                default:
+                    break;
+            }
+            emit(std::string(mnemonic) + " " + operand(rhs) + ", " + operand(work));
+            if (inst.type == ast::BuiltInType::BYTE) {
+                emit("movzbl " + operand(work, 8) + ", " + operand(work));
+            }
+            move(dst, work);
+        }
+
+        void FunctionWriter::writeCompare(const ir::Instruction &inst) {
+            Location lhs = locate(inst.lhs, inst.type);
+            Location rhs = locate(inst.rhs, inst.type);
+            if (lhs.kind == Location::Kind::IMMEDIATE
+                || (lhs.kind == Location::Kind::STACK && rhs.kind == Location::Kind::STACK)) {
+                move(Location::reg(RAX), lhs);
+                lhs = Location::reg(RAX);
+            }
+            // Bytes are compared as signed i8, like icmp does
+            if (inst.type == ast::BuiltInType::BYTE) {
+                emit("cmpb " + operand(rhs, 8) + ", " + operand(lhs, 8));
+            } else {
+                emit("cmpl " + operand(rhs) + ", " + operand(lhs));
+            }
+        }
+
+        void FunctionWriter::writeCast(const ir::Instruction &inst) {
+            Location dst = locate(inst.dst, inst.resultType);
+            Location src = locate(inst.lhs, inst.type);
+            Location work = dst.isRegister() ? dst : Location::reg(RAX);
+            move(work, src);
+            if (inst.castOp == ir::CastOp::TRUNC) {
+                if (inst.resultType == ast::BuiltInType::BYTE) {
+                    emit("movzbl " + operand(work, 8) + ", " + operand(work));
+                } else if (inst.resultType == ast::BuiltInType::BOOL) {
+                    emit("andl $1, " + operand(work));
+                }
+            } else if (inst.castOp == ir::CastOp::SEXT) {
+                if (inst.type == ast::BuiltInType::BYTE) {
+                    emit("movsbl " + operand(work, 8) + ", " + operand(work));
+                } else if (inst.type == ast::BuiltInType::BOOL) {
+                    emit("negl " + operand(work));
+                }
+                if (inst.resultType == ast::BuiltInType::BYTE) {
+                    emit("movzbl " + operand(work, 8) + ", " + operand(work));
+                }
+            }
+            move(dst, work);
+        }
+
+        void FunctionWriter::writeCall(const ir::Instruction &inst, bool tail) {
+            std::vector<std::pair<Location, Location>> moves;
+            size_t stackArguments = inst.args.size() > REGISTER_ARGUMENTS ? inst.args.size() - REGISTER_ARGUMENTS : 0;
+            // The stack stays 16-byte aligned at the call
+            size_t padding = stackArguments % 2 ? 8 : 0;
+            if (padding) {
+                emit("subq $8, %rsp");
+            }
+            for (size_t i = inst.args.size(); i-- > REGISTER_ARGUMENTS;) {
+                emit("pushq " + operand(locate(inst.args[i].value, inst.args[i].type), 64));
+            }
+            for (size_t i = 0; i < inst.args.size() && i < REGISTER_ARGUMENTS; ++i) {
+                moves.emplace_back(Location::reg(ARGUMENT_REGISTERS[i]), locate(inst.args[i].value, inst.args[i].type));
+            }
+            parallelMove(moves, code);
+            if (tail) {
+                for (size_t i = 0; i < savedRegisters.size(); ++i) {
+                    emit("movq " + std::to_string(-frameSize + 8 * int(i)) + "(%rbp), " + NAMES64[savedRegisters[i]]);
+                }
+                emit("leave");
+                emit("jmp fanc." + ir::functionName(inst.callee));
+                return;
+            }
+            emit("call fanc." + ir::functionName(inst.callee));
+            if (stackArguments || padding) {
+                emit("addq $" + std::to_string(8 * stackArguments + padding) + ", %rsp");
+            }
+            if (defines(inst)) {
+                move(locate(inst.dst, inst.type), Location::reg(RAX));
+            }
+        }
+
+        void FunctionWriter::writeEpilogue() {
+            for (size_t i = 0; i < savedRegisters.size(); ++i) {
+                emit("movq " + std::to_string(-frameSize + 8 * int(i)) + "(%rbp), " + NAMES64[savedRegisters[i]]);
+            }
+            emit("leave");
+            emit("ret");
+        }
+
+        void FunctionWriter::writeBlock(size_t block) {
+            const auto &instructions = function.blocks[block].instructions;
+            for (size_t k = 0; k < instructions.size(); ++k) {
+                const ir::Instruction &inst = instructions[k];
+                switch (inst.opcode) {
+                    case ir::Opcode::BINARY:
+                        writeBinary(inst);
+                        break;
+                    case ir::Opcode::COMPARE: {
+                        writeCompare(inst);
+                        // A compare only read by the branch right after it branches on the flags
+                        const ir::Instruction *next = k + 1 < instructions.size() ? &instructions[k + 1] : nullptr;
+                        int v = number(inst.dst);
+                        if (next && next->opcode == ir::Opcode::COND_BR && next->lhs == inst.dst
+                            && useCounts[v] == 1) {
+                            branch(block, conditionCode(inst.condition), blockOfLabel.at(next->target.id),
+                                   blockOfLabel.at(next->otherTarget.id));
+                            return;
+                        }
+                        Location dst = intervals[v].location;
+                        emit(std::string("set") + conditionCode(inst.condition) + " %al");
+                        emit("movzbl %al, " + operand(dst.isRegister() ? dst : Location::reg(RAX)));
+                        if (!dst.isRegister()) {
+                            move(dst, Location::reg(RAX));
+                        }
+                        break;
+                    }
+                    case ir::Opcode::CAST:
+                        writeCast(inst);
+                        break;
+                    case ir::Opcode::PHI:
+                    case ir::Opcode::ALLOCA:
+                        break;
+                    case ir::Opcode::LOAD: {
+                        auto slot = allocaSlots.find(inst.lhs.id);
+                        if (slot != allocaSlots.end()) {
+                            move(locate(inst.dst, inst.type), Location::stack(slot->second));
+                        }
+                        break;
+                    }
+                    case ir::Opcode::STORE: {
+                        auto slot = allocaSlots.find(inst.rhs.id);
+                        if (slot != allocaSlots.end()) {
+                            move(Location::stack(slot->second), locate(inst.lhs, inst.type));
+                        }
+                        break;
+                    }
+                    case ir::Opcode::CALL: {
+                        // A call right before the return of its result jumps to the callee instead
+                        bool tail = inst.tailCall != ir::TailCall::NONE && inst.args.size() <= REGISTER_ARGUMENTS
+                                    && k + 1 < instructions.size() && instructions[k + 1].opcode == ir::Opcode::RET;
+                        writeCall(inst, tail);
+                        if (tail) {
+                            return;
+                        }
+                        break;
+                    }
+                    case ir::Opcode::PRINT_STRING:
+                        emit("leaq .Lstr" + std::to_string(inst.index) + "(%rip), %rax");
+                        emit("movl $" + std::to_string(inst.size - 1) + ", %edx");
+                        emit("call rt.print");
+                        break;
+                    case ir::Opcode::PRINT_INT:
+                        move(Location::reg(RAX), locate(inst.lhs, ast::BuiltInType::INT));
+                        emit("call rt.printi");
+                        break;
+                    case ir::Opcode::DIV_ZERO_ERROR:
+                        emit("call rt.divzero");
+                        break;
+                    case ir::Opcode::BR: {
+                        size_t target = blockOfLabel.at(inst.target.id);
+                        jump(block, target, isNext(block, target));
+                        break;
+                    }
+                    case ir::Opcode::COND_BR: {
+                        size_t ifTrue = blockOfLabel.at(inst.target.id);
+                        size_t ifFalse = blockOfLabel.at(inst.otherTarget.id);
+                        Location condition = locate(inst.lhs, ast::BuiltInType::BOOL);
+                        if (ifTrue == ifFalse || condition.kind == Location::Kind::IMMEDIATE) {
+                            size_t target = ifTrue == ifFalse || condition.value ? ifTrue : ifFalse;
+                            jump(block, target, isNext(block, target));
+                            break;
+                        }
+                        if (condition.isRegister()) {
+                            emit("testl " + operand(condition) + ", " + operand(condition));
+                        } else {
+                            emit("cmpl $0, " + operand(condition));
+                        }
+                        branch(block, "ne", ifTrue, ifFalse);
+                        break;
+                    }
+                    case ir::Opcode::RET:
+                        if (inst.type != ast::BuiltInType::VOID) {
+                            move(Location::reg(RAX), locate(inst.lhs, inst.type));
+                        }
+                        writeEpilogue();
+                        break;
+                }
+            }
+        }
+
+        std::string FunctionWriter::write() {
+            numberValues();
+            buildIntervals();
+            allocate();
+            for (size_t i = 0; i < savedRegisters.size(); ++i) {
+                newSlot();
+            }
+            frameSize = (frameSize + 15) / 16 * 16;
+
+            code = "\t.text\n\t.p2align 4\nfanc." + function.name + ":\n";
+            emit("pushq %rbp");
+            emit("movq %rsp, %rbp");
+            if (frameSize) {
+                emit("subq $" + std::to_string(frameSize) + ", %rsp");
+            }
+            // The callee-saved registers are saved at the bottom of the frame
+            for (size_t i = 0; i < savedRegisters.size(); ++i) {
+                emit(std::string("movq ") + NAMES64[savedRegisters[i]] + ", " + std::to_string(-frameSize + 8 * int(i))
+                     + "(%rbp)");
+            }
+            std::vector<std::pair<Location, Location>> parameters;
+            for (size_t i = 0; i < function.paramTypes.size(); ++i) {
+                Location from = i < REGISTER_ARGUMENTS ? Location::reg(ARGUMENT_REGISTERS[i])
+                                                       : Location::stack(16 + 8 * int(i - REGISTER_ARGUMENTS));
+                parameters.emplace_back(intervals[i].location, from);
+            }
+            parallelMove(parameters, code);
+
+            for (size_t block : layout) {
+                if (function.blocks[block].label.id >= 0) {
+                    code += label(block) + ":\n";
+                }
+                writeBlock(block);
+            }
+            return code + trampolines;
+        }
+    }
+
+    void print(const ir::Function &function, output::CodeBuffer &out) {
+        out << FunctionWriter(function).write();
+    }
+}
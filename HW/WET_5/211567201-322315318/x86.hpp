@@ -0,0 +1,28 @@
+#ifndef X86_HPP
+#define X86_HPP
+
+#include <string>
+#include "ir.hpp"
+
+namespace x86 {
+
+    /* x86-64 assembly (GNU as, AT&T syntax) for Linux, written from the same ir::Function the LLVM
+     * printer writes. Values live in 32-bit registers or stack slots assigned by linear scan
+     * register allocation; FanC functions call each other with the System V calling convention
+     * and are named fanc.<name>. Link with:
+     *      as -o program.o program.s && ld -o program program.o
+     * No C library is needed: the runtime below provides _start, print, printi and the division
+     * by zero error on top of the write and exit_group system calls */
+
+    // The runtime, written once at the start of the output. Output goes through a buffer that is
+    // flushed when it fills up and when the program ends
+    extern const char *const RUNTIME;
+
+    // The string constant PRINT_STRING index refers to
+    std::string stringConstant(int index, const std::string &bytes);
+
+    // Writes the function as assembly
+    void print(const ir::Function &function, output::CodeBuffer &out);
+}
+
+#endif //X86_HPP
@@ -0,0 +1,68 @@
+#!/bin/bash
+# Compile-time benchmark: generates a program of each shape with fanc_gen, compiles it with
+# hw5 --time-report and prints the time of each phase (lexing, parsing, semantic checking, codegen
+# and output) and the throughput in MB of source per second.
+#
+# Build fanc_gen first (see fanc_gen.cpp), then run from this directory:
+#      ./compile_bench.sh [hw5] [scale] [results.csv]
+# The sizes are multiplied by scale, except the nesting depth (the parser stack holds 10000
+# symbols, about 2000 levels). Each program is compiled REPEAT times (3 by default) and the
+# fastest run is kept. Compiler flags go in FLAGS, e.g.
+#      FLAGS=-O ./compile_bench.sh ../211567201-322315318/hw5
+# With results.csv, a line per shape is appended (date, commit, flags, shape, size, bytes, the
+# milliseconds of each phase, total and peak RSS), for comparing versions of the compiler.
+
+HW5=${1:-../211567201-322315318/hw5}
+SCALE=${2:-1}
+RESULTS=$3
+REPEAT=${REPEAT:-3}
+GEN=./fanc_gen
+
+SHAPES="functions:$((5000 * SCALE)) nesting:1500 expressions:$((300 * SCALE)) strings:$((20000 * SCALE))
+        loops:$((3000 * SCALE)) mixed:$((2000 * SCALE))"
+
+if [ ! -x "$GEN" ] || [ ! -x "$HW5" ]; then
+    echo "usage: $0 [hw5] [scale] [results.csv] (build $GEN and $HW5 first)" >&2
+    exit 1
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+printf "%-12s %7s %9s %9s %9s %9s %9s %9s %9s %8s %10s\n" shape size "KB" "lex ms" "parse ms" "check ms" \
+       "gen ms" "out ms" "total ms" "MB/s" "RSS KB"
+for entry in $SHAPES; do
+    shape=${entry%%:*}
+    size=${entry##*:}
+    "$GEN" "$shape" "$size" > "$work/program.in"
+    bytes=$(wc -c < "$work/program.in")
+
+    best=
+    for ((run = 0; run < REPEAT; ++run)); do
+        "$HW5" --time-report=1 $FLAGS < "$work/program.in" > "$work/out" 2> "$work/report"
+        if head -c 5 "$work/out" | grep -q "^line"; then
+            echo "$shape: $(head -1 "$work/out")" >&2
+            exit 1
+        fi
+        # lexing parsing checking codegen output total peak-rss, from the report's table
+        times=$(awk '$1 == "lexing" || $1 == "parsing" || $1 == "codegen" || $1 == "output" { t[$1] = $2 }
+                     $1 == "semantic" { t["checking"] = $3 }
+                     $1 == "total" { t["total"] = $2; rss = $NF }
+                     END { print t["lexing"], t["parsing"], t["checking"], t["codegen"], t["output"], t["total"], rss }' \
+                "$work/report")
+        total=$(echo "$times" | cut -d' ' -f6)
+        if [ -z "$best" ] || awk -v a="$total" -v b="$bestTotal" 'BEGIN { exit !(a < b) }'; then
+            best=$times
+            bestTotal=$total
+        fi
+    done
+
+    read -r lex parse check gen out total rss <<< "$best"
+    throughput=$(awk -v b="$bytes" -v t="$total" 'BEGIN { printf "%.2f", (t > 0 ? b / 1e3 / t : 0) }')
+    printf "%-12s %7d %9d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8s %10d\n" "$shape" "$size" $((bytes / 1024)) \
+           "$lex" "$parse" "$check" "$gen" "$out" "$total" "$throughput" "$rss"
+    if [ -n "$RESULTS" ]; then
+        echo "$(date +%F),$commit,$FLAGS,$shape,$size,$bytes,$lex,$parse,$check,$gen,$out,$total,$rss" >> "$RESULTS"
+    fi
+done
@@ -0,0 +1,210 @@
+// Benchmark of the dataflow solver on large synthetic CFGs.
+//
+// Builds structured functions (sequences of straight-line blocks, if/else diamonds and nested
+// while loops, with loads, stores and arithmetic over a set of variables), solves liveness and
+// reaching definitions on them and checks that the results are fixed points.
+//
+// Build and run from this directory:
+//      g++ -std=c++17 -O2 -I../211567201-322315318 dataflow_bench.cpp ../211567201-322315318/dataflow.cpp -o dataflow_bench
+//      ./dataflow_bench [blocks] [variables] [seed]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "dataflow.hpp"
+
+using output::Label;
+using output::Value;
+
+/* Builds a random structured function of about the requested number of blocks */
+class Generator {
+public:
+    Generator(size_t blocks, int variables, unsigned seed) : budget(blocks), variables(variables), random(seed) {}
+
+    ir::Function generate() {
+        function.name = "bench";
+        function.blocks.emplace_back();
+        for (int v = 0; v < variables; ++v) {
+            ir::Instruction slot(ir::Opcode::ALLOCA);
+            slot.type = ast::BuiltInType::INT;
+            slot.dst = Value::temp(v);
+            current().instructions.push_back(slot);
+            store(Value::constant(0), v);
+        }
+        nextTemp = variables;
+        while (budget > 0) {
+            region(0);
+        }
+        ir::Instruction ret(ir::Opcode::RET);
+        ret.type = ast::BuiltInType::INT;
+        ret.lhs = load(pick());
+        current().instructions.push_back(ret);
+        return std::move(function);
+    }
+
+private:
+    size_t budget;
+    int variables;
+    std::mt19937 random;
+    ir::Function function;
+    int nextTemp = 0;
+    int nextLabel = 0;
+
+    ir::BasicBlock &current() {
+        return function.blocks.back();
+    }
+
+    int pick() {
+        return std::uniform_int_distribution<int>(0, variables - 1)(random);
+    }
+
+    Value load(int variable) {
+        ir::Instruction inst(ir::Opcode::LOAD);
+        inst.type = ast::BuiltInType::INT;
+        inst.dst = Value::temp(nextTemp++);
+        inst.lhs = Value::temp(variable);
+        current().instructions.push_back(inst);
+        return inst.dst;
+    }
+
+    void store(Value value, int variable) {
+        ir::Instruction inst(ir::Opcode::STORE);
+        inst.type = ast::BuiltInType::INT;
+        inst.lhs = value;
+        inst.rhs = Value::temp(variable);
+        current().instructions.push_back(inst);
+    }
+
+    Value compute() {
+        ir::Instruction inst(ir::Opcode::BINARY);
+        inst.type = ast::BuiltInType::INT;
+        inst.dst = Value::temp(nextTemp++);
+        inst.lhs = load(pick());
+        inst.rhs = random() % 2 ? load(pick()) : Value::constant(random() % 100);
+        current().instructions.push_back(inst);
+        return inst.dst;
+    }
+
+    Value condition() {
+        ir::Instruction inst(ir::Opcode::COMPARE);
+        inst.condition = ir::Condition::SLT;
+        inst.type = ast::BuiltInType::INT;
+        inst.dst = Value::temp(nextTemp++);
+        inst.lhs = compute();
+        inst.rhs = Value::constant(random() % 100);
+        current().instructions.push_back(inst);
+        return inst.dst;
+    }
+
+    void branch(Label target) {
+        ir::Instruction inst(ir::Opcode::BR);
+        inst.target = target;
+        current().instructions.push_back(inst);
+    }
+
+    void condBranch(Value cond, Label ifTrue, Label ifFalse) {
+        ir::Instruction inst(ir::Opcode::COND_BR);
+        inst.lhs = cond;
+        inst.target = ifTrue;
+        inst.otherTarget = ifFalse;
+        current().instructions.push_back(inst);
+    }
+
+    void startBlock(Label label) {
+        if (!current().terminated()) {
+            branch(label);
+        }
+        function.blocks.emplace_back();
+        current().label = label;
+        budget = budget > 0 ? budget - 1 : 0;
+    }
+
+    void statements() {
+        for (int i = random() % 4; i >= 0; --i) {
+            store(compute(), pick());
+        }
+    }
+
+    void region(int depth) {
+        int kind = depth > 6 || budget < 4 ? 0 : random() % 3;
+        if (kind == 0) {
+            statements();
+            startBlock(Label{nextLabel++});
+        } else if (kind == 1) {
+            Label thenLabel{nextLabel++}, elseLabel{nextLabel++}, endLabel{nextLabel++};
+            condBranch(condition(), thenLabel, elseLabel);
+            startBlock(thenLabel);
+            region(depth + 1);
+            branch(endLabel);
+            startBlock(elseLabel);
+            region(depth + 1);
+            startBlock(endLabel);
+        } else {
+            Label headerLabel{nextLabel++}, bodyLabel{nextLabel++}, endLabel{nextLabel++};
+            startBlock(headerLabel);
+            condBranch(condition(), bodyLabel, endLabel);
+            startBlock(bodyLabel);
+            for (int i = random() % 3; i >= 0 && budget > 0; --i) {
+                region(depth + 1);
+            }
+            branch(headerLabel);
+            startBlock(endLabel);
+        }
+    }
+};
+
+// Checks that applying every transfer function to the solution changes nothing
+template<typename Analysis>
+static bool isFixedPoint(const dataflow::CFG &cfg, const Analysis &analysis,
+                         const dataflow::Solution<typename Analysis::Fact> &solution) {
+    bool forward = Analysis::direction == dataflow::Direction::FORWARD;
+    for (size_t block : cfg.order) {
+        auto fact = forward ? solution.in[block] : solution.out[block];
+        analysis.transfer(block, fact);
+        if (fact != (forward ? solution.out[block] : solution.in[block])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    size_t blocks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    int variables = argc > 2 ? std::atoi(argv[2]) : 64;
+    unsigned seed = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1;
+
+    ir::Function function = Generator(blocks, variables, seed).generate();
+    size_t instructions = 0;
+    for (const auto &block : function.blocks) {
+        instructions += block.instructions.size();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    dataflow::CFG cfg(function);
+    double cfgTime = millisecondsSince(start);
+
+    dataflow::Liveness liveness(function);
+    start = std::chrono::steady_clock::now();
+    auto live = dataflow::solve(cfg, liveness);
+    double liveTime = millisecondsSince(start);
+
+    dataflow::ReachingDefinitions reaching(function);
+    start = std::chrono::steady_clock::now();
+    auto defs = dataflow::solve(cfg, reaching);
+    double defsTime = millisecondsSince(start);
+
+    std::printf("%zu blocks, %zu instructions, %d variables\n", function.blocks.size(), instructions, variables);
+    std::printf("cfg:                  %7.2f ms\n", cfgTime);
+    std::printf("liveness:             %7.2f ms  %zu visits (%.2f per block)  fixed point: %s\n", liveTime,
+                live.visits, (double) live.visits / cfg.order.size(),
+                isFixedPoint(cfg, liveness, live) ? "yes" : "NO");
+    std::printf("reaching definitions: %7.2f ms  %zu visits (%.2f per block)  fixed point: %s\n", defsTime,
+                defs.visits, (double) defs.visits / cfg.order.size(),
+                isFixedPoint(cfg, reaching, defs) ? "yes" : "NO");
+    return 0;
+}
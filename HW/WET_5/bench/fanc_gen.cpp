@@ -0,0 +1,364 @@
+// Generator of large synthetic FanC programs, the inputs of the compiler benchmarks.
+//
+// The output only depends on the arguments (the random numbers come from a fixed splitmix64, not
+// from the standard library distributions). Programs compile without errors and run to completion:
+// every divisor has the form x * x + 1, which is odd and so neither 0 nor -1, loops count up to a
+// fixed bound, and functions only call earlier functions that call nothing themselves.
+//
+// Build and run from this directory:
+//      g++ -std=c++17 -O2 fanc_gen.cpp -o fanc_gen
+//      ./fanc_gen <shape> [size] [seed] > program.in
+//
+// Shapes, and what size is for each:
+//      functions    many small functions, each called from main (size: number of functions)
+//      nesting      ifs and loops nested deep inside each other (size: nesting depth)
+//      expressions  long arithmetic and boolean expressions (size: operands per expression)
+//      strings      a long table of distinct string literals, printed (size: number of strings)
+//      loops        functions made of loop nests, each loop running 100 times (size: number of functions)
+//      mixed        some of each (size: number of functions)
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* What a program looks like */
+struct Shape {
+    int functions = 8;
+    // Statements per block at the top of a function (nested blocks get fewer)
+    int statements = 8;
+    // Maximum nesting of ifs and loops, and of loops alone
+    int depth = 2;
+    int loopDepth = 2;
+    // Operands per expression
+    int expression = 4;
+    // Percentage of the statements printing a string literal
+    int strings = 2;
+    // Percentage of the nested statements that are loops (the others are ifs)
+    int loopPercent = 40;
+    // Times each loop runs
+    int iterations = 4;
+    // Whether every function nests all the way to depth
+    bool spine = false;
+};
+
+static bool makeShape(const std::string &name, int size, Shape &shape) {
+    if (name == "functions") {
+        shape.functions = size;
+        shape.statements = 6;
+    } else if (name == "nesting") {
+        shape.functions = 4;
+        shape.statements = 3;
+        shape.depth = size;
+        shape.iterations = 2;
+        shape.spine = true;
+    } else if (name == "expressions") {
+        shape.functions = 16;
+        shape.statements = 24;
+        shape.depth = 1;
+        shape.expression = size;
+    } else if (name == "strings") {
+        shape.functions = 4;
+        shape.statements = size / 4 + 1;
+        shape.depth = 0;
+        shape.strings = 100;
+    } else if (name == "loops") {
+        shape.functions = size;
+        shape.statements = 6;
+        shape.depth = 3;
+        shape.loopDepth = 3;
+        shape.loopPercent = 90;
+        shape.iterations = 100;
+        shape.spine = true;
+    } else if (name == "mixed") {
+        shape.functions = size;
+        shape.statements = 10;
+        shape.depth = 4;
+        shape.expression = 8;
+        shape.strings = 10;
+        shape.iterations = 6;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+enum class Type {
+    INT,
+    BYTE,
+    BOOL
+};
+
+static const char *typeName(Type type) {
+    return type == Type::INT ? "int" : type == Type::BYTE ? "byte" : "bool";
+}
+
+class Generator {
+public:
+    Generator(const Shape &shape, uint64_t seed) : shape(shape), state(seed) {}
+
+    std::string generate() {
+        for (int f = 0; f < shape.functions; ++f) {
+            function(f);
+        }
+        out += "void main() {\n";
+        scope.clear();
+        names = 0;
+        for (const auto &callee : functions) {
+            out += "    printi(" + call(callee) + ");\n";
+        }
+        block(1, 0, shape.statements, shape.spine);
+        out += "}\n";
+        return std::move(out);
+    }
+
+private:
+    struct Variable {
+        std::string name;
+        Type type;
+    };
+
+    struct Function {
+        std::string name;
+        std::vector<Type> params;
+        // Whether it calls other functions (only functions that do not may be called)
+        bool leaf;
+    };
+
+    const Shape shape;
+    uint64_t state;
+    std::string out;
+    std::vector<Function> functions;
+    std::vector<Variable> scope;
+    int names = 0;
+    int stringCount = 0;
+    bool inLeaf = false;
+    // Loops around the statement being generated
+    int loops = 0;
+    // Open calls and divisors: their operands call nothing, or expressions would grow exponentially
+    int noCalls = 0;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n)
+    int below(int n) {
+        return int(next() % uint64_t(n));
+    }
+
+    bool chance(int percent) {
+        return below(100) < percent;
+    }
+
+    // Deep levels are indented like level 8, or the size would grow with the square of the depth
+    static void indent(std::string &text, int level) {
+        text.append(4 * std::min(level, 8), ' ');
+    }
+
+    std::string fresh(const char *prefix) {
+        return prefix + std::to_string(names++);
+    }
+
+    const Variable *pickVariable(Type type) {
+        std::vector<const Variable *> candidates;
+        for (const auto &variable : scope) {
+            if (variable.type == type) {
+                candidates.push_back(&variable);
+            }
+        }
+        return candidates.empty() ? nullptr : candidates[below(int(candidates.size()))];
+    }
+
+    void function(int index) {
+        Function callee{"f" + std::to_string(index), {}, index % 4 == 0};
+        int params = below(4);
+        for (int i = 0; i < params; ++i) {
+            callee.params.push_back(chance(70) ? Type::INT : Type::BYTE);
+        }
+        scope.clear();
+        names = 0;
+        inLeaf = callee.leaf;
+        out += "int " + callee.name + "(";
+        for (size_t i = 0; i < callee.params.size(); ++i) {
+            Variable param{"p" + std::to_string(i), callee.params[i]};
+            out += std::string(i ? ", " : "") + typeName(param.type) + " " + param.name;
+            scope.push_back(param);
+        }
+        out += ") {\n";
+        block(1, 0, shape.statements, shape.spine);
+        indent(out, 1);
+        out += "return " + expression(Type::INT, shape.expression) + ";\n}\n";
+        inLeaf = false;
+        functions.push_back(callee);
+    }
+
+    // On the spine, the first statement of every block opens another level until the maximum depth
+    void block(int level, int depth, int statements, bool spine) {
+        size_t scopeSize = scope.size();
+        for (int i = 0; i < statements; ++i) {
+            statement(level, depth, statements, spine && i == 0);
+        }
+        scope.resize(scopeSize);
+    }
+
+    void statement(int level, int depth, int statements, bool spine) {
+        indent(out, level);
+        // Nested blocks get a third of the statements, so that the size stays linear in the number
+        // of statements (random nesting dies out after a few levels; only the spine goes deeper)
+        int nested = std::max(spine ? 2 : 1, statements / 3);
+        bool deeper = depth < shape.depth && (spine || chance(30));
+        // Nothing is printed inside loops, so that the output stays about as long as the program
+        if (!spine && loops == 0 && chance(shape.strings)) {
+            out += "print(\"" + stringLiteral() + "\");\n";
+        } else if (deeper && loops < shape.loopDepth && chance(shape.loopPercent)) {
+            // Loop counters are incremented first, so that continue cannot skip them
+            std::string counter = fresh("i");
+            out += "int " + counter + " = 0;\n";
+            indent(out, level);
+            out += "while (" + counter + " < " + std::to_string(shape.iterations) + ") {\n";
+            indent(out, level + 1);
+            out += counter + " = " + counter + " + 1;\n";
+            ++loops;
+            if (chance(20)) {
+                indent(out, level + 1);
+                out += "if (" + expression(Type::BOOL, 3) + ") " + (chance(50) ? "break" : "continue") + ";\n";
+            }
+            block(level + 1, depth + 1, nested, spine);
+            --loops;
+            indent(out, level);
+            out += "}\n";
+            scope.push_back({counter, Type::INT});
+        } else if (deeper) {
+            out += "if (" + expression(Type::BOOL, std::max(2, shape.expression / 2)) + ") {\n";
+            block(level + 1, depth + 1, nested, spine);
+            indent(out, level);
+            if (chance(50)) {
+                out += "} else {\n";
+                block(level + 1, depth + 1, nested, false);
+                indent(out, level);
+            }
+            out += "}\n";
+        } else if (!scope.empty() && chance(40)) {
+            const Variable &variable = scope[below(int(scope.size()))];
+            out += variable.name + " = " + expression(variable.type, shape.expression) + ";\n";
+        } else if (loops == 0 && chance(15)) {
+            out += "printi(" + expression(Type::INT, shape.expression) + ");\n";
+        } else {
+            Type type = chance(60) ? Type::INT : chance(50) ? Type::BYTE : Type::BOOL;
+            Variable variable{fresh("v"), type};
+            out += std::string(typeName(type)) + " " + variable.name + " = " + expression(type, shape.expression)
+                   + ";\n";
+            scope.push_back(variable);
+        }
+    }
+
+    std::string stringLiteral() {
+        static const char *const words[] = {"alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta",
+                                            "theta", "iota", "kappa", "lambda", "mu", "\\t", "\\\"", "\\\\"};
+        std::string text = "s" + std::to_string(stringCount++);
+        int length = 4 + below(12);
+        for (int i = 0; i < length; ++i) {
+            text += ' ';
+            text += words[below(int(sizeof(words) / sizeof(words[0])))];
+        }
+        return text;
+    }
+
+    std::string call(const Function &callee) {
+        std::string text = callee.name + "(";
+        ++noCalls;
+        for (size_t i = 0; i < callee.params.size(); ++i) {
+            text += std::string(i ? ", " : "") + expression(callee.params[i], 2);
+        }
+        --noCalls;
+        return text + ")";
+    }
+
+    std::string atom(Type type) {
+        const Variable *variable = pickVariable(type);
+        switch (type) {
+            case Type::INT:
+                if (variable && chance(70)) {
+                    return variable->name;
+                }
+                if (!inLeaf && loops == 0 && noCalls == 0 && !functions.empty() && chance(20)) {
+                    // Only leaves are called, and not from loops, so that the running time stays
+                    // about linear in the size of the program
+                    const Function &callee = functions[below(int(functions.size())) / 4 * 4];
+                    return call(callee);
+                }
+                if (chance(30)) {
+                    return atom(Type::BYTE);
+                }
+                return std::to_string(below(1000));
+            case Type::BYTE:
+                if (variable && chance(70)) {
+                    return variable->name;
+                }
+                return std::to_string(below(256)) + "b";
+            default:
+                if (variable && chance(60)) {
+                    return variable->name;
+                }
+                return chance(50) ? "true" : "false";
+        }
+    }
+
+    // An expression of the type with about the given number of operands
+    std::string expression(Type type, int operands) {
+        if (operands <= 1) {
+            return atom(type);
+        }
+        int left = 1 + below(operands - 1);
+        int right = operands - left;
+        if (type == Type::BOOL) {
+            int kind = below(10);
+            if (kind < 5) {
+                static const char *const relations[] = {"==", "!=", "<", ">", "<=", ">="};
+                Type compared = chance(80) ? Type::INT : Type::BYTE;
+                return "(" + expression(compared, left) + " " + relations[below(6)] + " "
+                       + expression(compared, right) + ")";
+            }
+            if (kind < 6) {
+                return "(not " + expression(Type::BOOL, operands - 1) + ")";
+            }
+            return "(" + expression(Type::BOOL, left) + (kind < 8 ? " and " : " or ") + expression(Type::BOOL, right)
+                   + ")";
+        }
+        if (type == Type::BYTE && chance(10)) {
+            return "((byte) " + expression(Type::INT, operands) + ")";
+        }
+        static const char *const operators[] = {" + ", " - ", " * ", " / "};
+        int op = below(4);
+        if (op == 3) {
+            // x * x + 1 is odd: never zero, and never -1
+            ++noCalls;
+            std::string x = atom(type);
+            --noCalls;
+            return "(" + expression(type, left) + " / (" + x + " * " + x + " + 1" + (type == Type::BYTE ? "b" : "")
+                   + "))";
+        }
+        return "(" + expression(type, left) + operators[op] + expression(type, right) + ")";
+    }
+};
+
+int main(int argc, char *argv[]) {
+    Shape shape;
+    std::string name = argc > 1 ? argv[1] : "";
+    int size = argc > 2 ? std::atoi(argv[2]) : 100;
+    uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+    if (size < 1 || !makeShape(name, size, shape)) {
+        std::fprintf(stderr, "usage: %s functions|nesting|expressions|strings|loops|mixed [size] [seed]\n", argv[0]);
+        return 1;
+    }
+    std::string program = "// fanc_gen " + name + " " + std::to_string(size) + " " + std::to_string(seed) + "\n"
+                          + Generator(shape, seed).generate();
+    std::fwrite(program.data(), 1, program.size(), stdout);
+    return 0;
+}
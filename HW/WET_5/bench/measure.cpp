@@ -0,0 +1,99 @@
+// Runs a command and measures it, for the runtime benchmark.
+//
+// Writes a line "<wall ms> <cpu ms> <instructions>" to the result file: the wall clock time, the
+// user and system time of the command and of the processes it waited for, and the number of user
+// space instructions it retired (its threads and children included). The instructions come from
+// the hardware counter of perf_event_open; where there is none (in most virtual machines, or with
+// perf_event_paranoid above 2) they are written as "-". The command's own output is left alone.
+// The exit status is the command's.
+//
+// Build and run from this directory:
+//      g++ -std=c++17 -O2 measure.cpp -o measure
+//      ./measure <result file> <command> [arguments...]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Opens a counter of the instructions of a process, enabled when it calls exec; -1 if there is none */
+static int openInstructionCounter(pid_t pid) {
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attributes.disabled = 1;
+    attributes.enable_on_exec = 1;
+    attributes.inherit = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return int(syscall(SYS_perf_event_open, &attributes, pid, -1, -1, 0));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <result file> <command> [arguments...]\n", argv[0]);
+        return 2;
+    }
+    FILE *result = std::fopen(argv[1], "w");
+    if (!result) {
+        std::perror(argv[1]);
+        return 2;
+    }
+
+    // The child waits on the pipe until the counter is attached to it, so that it counts from exec on
+    int start[2];
+    if (pipe(start) != 0) {
+        std::perror("pipe");
+        return 2;
+    }
+    auto began = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        return 2;
+    }
+    if (child == 0) {
+        char go;
+        close(start[1]);
+        if (read(start[0], &go, 1) != 1) {
+            _exit(127);
+        }
+        close(start[0]);
+        execvp(argv[2], argv + 2);
+        std::perror(argv[2]);
+        _exit(127);
+    }
+    close(start[0]);
+    int counter = openInstructionCounter(child);
+    if (write(start[1], "x", 1) != 1) {
+        std::perror("write");
+    }
+    close(start[1]);
+
+    int status;
+    struct rusage usage;
+    while (wait4(child, &status, 0, &usage) < 0) {
+    }
+    double wall = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - began).count();
+    double cpu = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+                 (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+
+    uint64_t instructions;
+    if (counter >= 0 && read(counter, &instructions, sizeof(instructions)) == sizeof(instructions)) {
+        std::fprintf(result, "%.3f %.3f %llu\n", wall, cpu, (unsigned long long)instructions);
+    } else {
+        std::fprintf(result, "%.3f %.3f -\n", wall, cpu);
+    }
+    std::fclose(result);
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
@@ -0,0 +1,106 @@
+#!/bin/bash
+# Runtime benchmark: compiles each kernel in kernels/ with hw5 and runs the program it generates
+# three ways: the LLVM IR under lli (JIT), the LLVM IR through llc and a native link, and the
+# assembly of --target=x86-64 through as and ld. Prints the wall and CPU time of each run, the
+# instructions it retired and the size of the code of the native executables, and checks that
+# every runner and every compiler prints the same output for a kernel.
+#
+# Build measure first (see measure.cpp), then run from this directory:
+#      ./runtime_bench.sh [hw5...]
+# Giving several compilers (e.g. the hw5 of two commits) puts their rows next to each other.
+# Each program runs REPEAT times (3 by default) and the fastest run is kept. Compiler flags go in
+# FLAGS, the runners to use in RUNNERS (lli, llc and x86 by default) and the llc flags in LLC_FLAGS
+# (-O2 by default), e.g.
+#      FLAGS=-O RUNNERS="llc x86" ./runtime_bench.sh ../211567201-322315318/hw5
+# The instructions are only counted where perf_event_open has a hardware counter, and are "-"
+# elsewhere. With RESULTS=results.csv, a line per run is appended (date, commit, compiler, flags,
+# kernel, runner, wall ms, CPU ms, instructions and code bytes), for comparing versions.
+
+REPEAT=${REPEAT:-3}
+RUNNERS=${RUNNERS:-lli llc x86}
+LLC_FLAGS=${LLC_FLAGS:--O2}
+MEASURE=./measure
+COMPILERS=("$@")
+if [ ${#COMPILERS[@]} -eq 0 ]; then
+    COMPILERS=(../211567201-322315318/hw5)
+fi
+
+for hw5 in "${COMPILERS[@]}"; do
+    if [ ! -x "$hw5" ]; then
+        echo "usage: $0 [hw5...] ($hw5 is not built)" >&2
+        exit 1
+    fi
+done
+if [ ! -x "$MEASURE" ]; then
+    echo "build $MEASURE first (see measure.cpp)" >&2
+    exit 1
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+# Compiles a kernel for a runner into $work/program (or program.ll for lli); fails on errors
+build() {
+    local hw5=$1 runner=$2 kernel=$3
+    local target=llvm
+    if [ "$runner" = x86 ]; then
+        target=x86-64
+    fi
+    "$hw5" --target=$target $FLAGS < "$kernel" > "$work/program.src"
+    if head -c 5 "$work/program.src" | grep -q "^line"; then
+        echo "$kernel: $(head -1 "$work/program.src")" >&2
+        return 1
+    fi
+    case $runner in
+        lli) mv "$work/program.src" "$work/program.ll" ;;
+        llc) mv "$work/program.src" "$work/program.ll" &&
+             llc $LLC_FLAGS -filetype=obj "$work/program.ll" -o "$work/program.o" &&
+             gcc -no-pie "$work/program.o" -o "$work/program" ;;
+        x86) as "$work/program.src" -o "$work/program.o" && ld "$work/program.o" -o "$work/program" ;;
+        *) echo "unknown runner $runner" >&2; return 1 ;;
+    esac
+}
+
+printf "%-10s %-32s %-4s %10s %10s %14s %10s\n" kernel compiler run "wall ms" "cpu ms" instructions "code B"
+for kernel in kernels/*.in; do
+    name=$(basename "$kernel" .in)
+    expected=
+    for hw5 in "${COMPILERS[@]}"; do
+        for runner in $RUNNERS; do
+            build "$hw5" "$runner" "$kernel" || exit 1
+            if [ "$runner" = lli ]; then
+                command=(lli "$work/program.ll")
+                code=-
+            else
+                command=("$work/program")
+                code=$(size "$work/program" | awk 'NR == 2 { print $1 }')
+            fi
+
+            best=
+            for ((run = 0; run < REPEAT; ++run)); do
+                "$MEASURE" "$work/measured" "${command[@]}" > "$work/out"
+                read -r wall cpu instructions < "$work/measured"
+                if [ -z "$best" ] || awk -v a="$wall" -v b="$bestWall" 'BEGIN { exit !(a < b) }'; then
+                    best="$wall $cpu $instructions"
+                    bestWall=$wall
+                fi
+            done
+
+            sum=$(md5sum < "$work/out")
+            if [ -z "$expected" ]; then
+                expected=$sum
+            elif [ "$sum" != "$expected" ]; then
+                echo "$name: $hw5 prints something else under $runner" >&2
+                exit 1
+            fi
+
+            read -r wall cpu instructions <<< "$best"
+            printf "%-10s %-32s %-4s %10.1f %10.1f %14s %10s\n" "$name" "$hw5" "$runner" "$wall" "$cpu" \
+                   "$instructions" "$code"
+            if [ -n "$RESULTS" ]; then
+                echo "$(date +%F),$commit,$hw5,$FLAGS,$name,$runner,$wall,$cpu,$instructions,$code" >> "$RESULTS"
+            fi
+        done
+    done
+done
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Regression tests: compiles each .in of this directory with hw5, once without and once with -O,
+# runs the program and compares what it prints with the .out next to it.
+#
+# Build hw5 first, then run from this directory:
+#      ./run_tests.sh [hw5]
+# Extra compiler flags go in FLAGS. The programs run under lli, or through as and ld with
+# FLAGS=--target=x86-64, e.g.
+#      FLAGS="--target=x86-64" ./run_tests.sh ../211567201-322315318/hw5
+
+HW5=${1:-../211567201-322315318/hw5}
+
+if [ ! -x "$HW5" ]; then
+    echo "usage: $0 [hw5] (build $HW5 first)" >&2
+    exit 1
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+for test in *.in; do
+    for optimize in "" -O; do
+        "$HW5" $optimize $FLAGS < "$test" > "$work/program" 2> "$work/errors"
+        case " $FLAGS " in
+            *" --target=x86-64 "*)
+                as "$work/program" -o "$work/program.o" && ld "$work/program.o" -o "$work/program.exe" &&
+                    "$work/program.exe" > "$work/got" 2>&1 ;;
+            *)
+                lli "$work/program" > "$work/got" 2>&1 ;;
+        esac
+        if ! cmp -s "$work/got" "${test%.in}.out"; then
+            echo "FAIL $test ${optimize:-(no -O)}"
+            failed=1
+        fi
+    done
+done
+if [ $failed = 0 ]; then
+    echo "all tests passed"
+fi
+exit $failed